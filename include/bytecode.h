@@ -0,0 +1,93 @@
+/**
+ * @file bytecode.h
+ * @brief Instruction encoding of compiled programs.
+ *
+ * A compiled program is postfix code for an operand stack machine. This
+ * header exposes its encoding read-only, for evaluators built outside the
+ * library such as the templated one in reactionparser.hpp; the library's
+ * own evaluators use the same definitions. Instruction semantics are those
+ * of rp_eval(): every evaluating opcode pops its operands and pushes one
+ * result.
+ *
+ * @date 2025
+ */
+#ifndef REACTIONPARSER_BYTECODE_H
+#define REACTIONPARSER_BYTECODE_H
+
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -- Program opcodes, one per evaluating operator plus operand loads
+enum Opcode {
+    OPC_CONST = 0, // push consts[arg]
+    OPC_VAR, // push vars[arg]
+    OPC_NEG,
+    OPC_POW,
+    OPC_MUL,
+    OPC_DIV,
+    OPC_MOD,
+    OPC_ADD,
+    OPC_SUB,
+    OPC_MIN,
+    OPC_MAX,
+    OPC_EXP,
+    OPC_LOG,
+    OPC_SQRT,
+    OPC_ABS,
+    OPC_TANH,
+    OPC_MONOMIAL, // push the product of monomials.terms[arg]'s factors
+    OPC_MICHAELIS, // V S K -> V*S/(K+S)
+    OPC_HILL, // V S K n -> V*S^n/(K^n+S^n); arg is 2n for powers done like monomials, else 0
+    OPC_REVERSIBLE_MM, // Vf S Ks Vr P Kp -> (Vf*S/Ks - Vr*P/Kp)/(1 + S/Ks + P/Kp)
+    OPC_STORE, // temps[arg] = top of stack, left in place
+    OPC_LOAD, // push temps[arg]
+    OPC_OUTPUT, // pop into out[arg]
+    OPC_NONE, // parenthesis; never emitted
+};
+
+typedef struct {
+    int opcode; // enum Opcode
+    int arg; // constant pool index for OPC_CONST, variable slot for OPC_VAR,
+             // temporary for OPC_STORE/OPC_LOAD, output index for OPC_OUTPUT,
+             // monomial for OPC_MONOMIAL
+} Instruction;
+
+// one factor of a monomial, operand^(half_power / 2)
+typedef struct {
+    int operand; // variable slot, or ~index of a constant
+    int half_power; // twice the exponent: 1 is sqrt, 2 the operand itself, 4 its square
+} Factor;
+
+typedef struct {
+    int first; // index of the first factor in MonomialTable.factors
+    int nfactors;
+} Monomial;
+
+/**
+ * @brief Read-only view of a compiled program, see rp_program_bytecode()
+ */
+typedef struct {
+    const Instruction *code;
+    int ncode;
+    const double *consts;
+    const Monomial *terms; // indexed by the arg of OPC_MONOMIAL
+    const Factor *factors;
+    int nvars; // one past the highest variable slot read
+    int maxdepth; // deepest operand stack reached
+    int ntemps; // temporaries used by OPC_STORE and OPC_LOAD
+    int noutputs; // 1 for single expressions, which leave their result on the stack
+} rp_bytecode;
+
+/**
+ * @brief Describe a program's code; the view is valid until the program is freed
+ */
+void rp_program_bytecode(const rp_program *program, rp_bytecode *bytecode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REACTIONPARSER_BYTECODE_H
@@ -2,26 +2,693 @@
  * @file parser.h
  * @brief Header file declaring methods used in parser.c
  *
+ * Thread safety: the parser keeps no global mutable state. Any number of
+ * threads may parse, compile and evaluate at the same time. A program or
+ * symbol table is read-only during evaluation and compilation respectively,
+ * so one may be shared by all threads, as long as nothing modifies it
+ * concurrently: rp_symtab_add(), rp_jit_compile(), rp_native_compile() and
+ * rp_program_free() need exclusive access to their argument.
+ *
  * @date 2025
  */
+#ifndef PARSER_H
+#define PARSER_H
+
 // --- library import --- //
 #include <stdio.h> 
 #include <stdlib.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdint.h>
 #include <omp.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Outcome of parsing an expression.
+ *
+ * The library never prints or exits on malformed input; every entry point
+ * that parses reports one of these, with its position, through an rp_error.
+ */
+typedef enum {
+    RP_OK = 0,
+    RP_ERR_SYNTAX, // character that cannot start or continue a token
+    RP_ERR_BINARY_OPERATOR, // binary operator where an operand was expected
+    RP_ERR_MISSING_OPERAND, // operator without enough operands
+    RP_ERR_MISSING_OPERATOR, // two operands with no operator between them
+    RP_ERR_UNMATCHED_OPEN, // '(' without a matching ')'
+    RP_ERR_UNMATCHED_CLOSE, // ')' without a matching '('
+    RP_ERR_UNKNOWN_IDENTIFIER, // identifier not in the symbol table
+    RP_ERR_EMPTY, // nothing to evaluate
+    RP_ERR_TOO_LONG, // expression longer than INT_MAX / 2 bytes
+    RP_ERR_NO_MEMORY, // allocation failed
+    RP_ERR_ARGUMENT_COUNT, // built-in function called with the wrong number of arguments
+    RP_ERR_STOICHIOMETRY, // stoichiometry matrix row offsets or reaction indices out of range
+} rp_status;
+
+/**
+ * @brief Error details filled in by the parsing entry points
+ */
+typedef struct {
+    rp_status status;
+    int position; // byte offset of the offending token in the expression
+    int expression; // index of the failing expression in parser_compile_many()
+} rp_error;
+
+/**
+ * @brief Human-readable description of a status
+ */
+const char *rp_strerror(rp_status status);
+
 /**
  * @brief Evaluate an expression string (argv[1..argc-1])
  * @param expression the string expression to be evaluated
- * @return result float expression result
+ * @return result float expression result, NaN if the expression is malformed
+ *         (see parser_eval() for the reason)
  */
 double parser(const char *expression);
 
+/**
+ * @brief Evaluate an expression string, reporting why it failed
+ * @param expression the string expression to be evaluated
+ * @param result receives the value, NaN on error
+ * @param error receives status and position, may be NULL
+ * @return RP_OK, or the error status
+ */
+rp_status parser_eval(const char *expression, double *result, rp_error *error);
+
+/**
+ * @brief Table of variable names, each bound to a dense integer slot.
+ *
+ * Identifiers in an expression are resolved against the table when it is
+ * compiled; evaluation then reads the value of slot i from vars[i].
+ */
+typedef struct rp_symtab rp_symtab;
+
+/**
+ * @brief Create an empty symbol table
+ * @return table handle, or NULL if out of memory
+ */
+rp_symtab *rp_symtab_create(void);
+
+/**
+ * @brief Bind a name to the next free slot
+ * @param symbols table to add to
+ * @param name identifier ([A-Za-z_][A-Za-z0-9_]*)
+ * @return slot of the name (its existing slot if already present), or -1 if
+ *         the name is not a valid identifier or memory runs out
+ */
+int rp_symtab_add(rp_symtab *symbols, const char *name);
+
+/**
+ * @brief Look up the slot bound to a name
+ * @return slot, or -1 if the name is not in the table
+ */
+int rp_symtab_find(const rp_symtab *symbols, const char *name);
+
+/**
+ * @brief Number of slots in the table; vars[] passed to rp_eval() must be at least this long
+ */
+int rp_symtab_size(const rp_symtab *symbols);
+
+/**
+ * @brief Name bound to a slot, or NULL if the slot is out of range
+ */
+const char *rp_symtab_name(const rp_symtab *symbols, int slot);
+
+/**
+ * @brief Release a symbol table; programs compiled against it stay valid
+ */
+void rp_symtab_free(rp_symtab *symbols);
+
+/**
+ * @brief Compiled postfix program for one expression.
+ *
+ * Produced once by parser_compile() and evaluated any number of times by
+ * rp_eval() without re-reading the expression string.
+ */
+typedef struct rp_program rp_program;
+
+/**
+ * @brief What the compiler did to a program, see rp_program_stats()
+ */
+typedef struct {
+    int instructions; // program length after optimization
+    int eliminated; // instructions removed by simplification
+    int folded; // constant subexpressions evaluated at compile time
+    int identities; // identity operations removed (x*1, 0+x, x^1, ...)
+    int negations; // double negations collapsed
+    int shared; // uses of a common subexpression served from a stored value
+    int monomials; // products of variables and their powers fused into one instruction
+    int michaelis_menten; // V*S/(K+S) evaluated by a fused kernel
+    int hill; // V*S^n/(K^n+S^n) evaluated by a fused kernel
+    int reversible_mm; // (Vf*S/Ks - Vr*P/Kp)/(1+S/Ks+P/Kp) evaluated by a fused kernel
+    int superinstructions; // loads fused with the operator consuming them by the threaded interpreter
+} rp_compile_stats;
+
+/**
+ * @brief Parse an expression into a reusable program
+ * @param expression the string expression to be compiled
+ * @return program handle, or NULL on a syntax error
+ */
+rp_program *parser_compile(const char *expression);
+
+/**
+ * @brief Parse an expression containing named variables into a reusable program
+ * @param expression the string expression to be compiled
+ * @param symbols table identifiers are resolved against, may be NULL
+ * @param error receives status and position, may be NULL
+ * @return program handle, or NULL on error
+ */
+rp_program *parser_compile_symbols(const char *expression, const rp_symtab *symbols, rp_error *error);
+
+/**
+ * @brief Validate an expression without building a program
+ *
+ * Performs the same checks as parser_compile_symbols() but builds no program:
+ * expressions up to 256 bytes are checked without allocating, longer ones
+ * use one temporary buffer, so large sets of user expressions can be
+ * screened cheaply in-process.
+ *
+ * @param expression the string expression to be checked
+ * @param symbols table identifiers are resolved against, may be NULL
+ * @param error receives status and position, may be NULL
+ * @return RP_OK, or the error status
+ */
+rp_status parser_check(const char *expression, const rp_symtab *symbols, rp_error *error);
+
+/**
+ * @brief Compile several expressions into one program sharing common subexpressions
+ *
+ * Identical subterms across all expressions (and within one) are computed
+ * once per evaluation and reused. Evaluate the result with rp_eval_many().
+ *
+ * @param expressions the string expressions to be compiled
+ * @param count number of expressions
+ * @param symbols table identifiers are resolved against, may be NULL
+ * @param error receives status, position and the index of the failing
+ *        expression, may be NULL
+ * @return program handle with count outputs, or NULL on error
+ */
+rp_program *parser_compile_many(const char *const *expressions, int count, const rp_symtab *symbols,
+                                rp_error *error);
+
+/**
+ * @brief Report how a program was optimized when it was compiled
+ * @param program handle returned by parser_compile()
+ * @param stats receives the counters
+ */
+void rp_program_stats(const rp_program *program, rp_compile_stats *stats);
+
+/**
+ * @brief Evaluate a compiled program
+ * @param program single-output handle returned by parser_compile()
+ * @param vars variable values indexed by symbol table slot, may be NULL if
+ *        the expression has no variables
+ * @return result float expression result, NAN for a program with several
+ *         outputs (evaluate those with rp_eval_many())
+ */
+double rp_eval(const rp_program *program, const double *vars);
+
+/**
+ * @brief Evaluate every output of a program in one pass
+ * @param program handle returned by parser_compile_many() or parser_compile()
+ * @param vars variable values indexed by symbol table slot, may be NULL
+ * @param out receives rp_program_outputs() results, in expression order
+ */
+void rp_eval_many(const rp_program *program, const double *vars, double *out);
+
+/**
+ * @brief Number of results a program produces (1 unless from parser_compile_many())
+ */
+int rp_program_outputs(const rp_program *program);
+
+/**
+ * @brief Evaluate a compiled program over many variable bindings at once
+ *
+ * Variables are given in structure-of-arrays layout: the value of slot i in
+ * row r is columns[i][r]. Rows are processed in blocks so each opcode runs as
+ * one vectorized loop, which is much faster than n calls to rp_eval().
+ *
+ * @param program single-output handle returned by parser_compile()
+ * @param columns one array of n values per variable slot, may be NULL if the
+ *        expression has no variables
+ * @param n number of rows
+ * @param out receives the n results
+ */
+void rp_eval_batch(const rp_program *program, const double *const *columns, size_t n, double *out);
+
+/**
+ * @brief rp_eval_batch() split across OpenMP threads
+ *
+ * Each thread evaluates one contiguous chunk of rows, a whole number of
+ * blocks long, with its own cache-line-aligned scratch space, so threads
+ * share no written memory except at chunk boundaries of out. Small batches
+ * run on the calling thread. Without OpenMP this is rp_eval_batch().
+ *
+ * @param program single-output handle returned by parser_compile()
+ * @param columns one array of n values per variable slot, may be NULL
+ * @param n number of rows
+ * @param out receives the n results
+ */
+void rp_eval_batch_parallel(const rp_program *program, const double *const *columns, size_t n, double *out);
+
+/**
+ * @brief Evaluate a program and its gradient in one pass
+ *
+ * Uses forward-mode automatic differentiation, so the derivatives are exact
+ * up to rounding rather than finite-difference estimates. The value equals
+ * rp_eval(). Where a function is not differentiable, the derivative of the
+ * branch taken is used: min and max follow the selected argument, and abs
+ * has slope 1 at zero.
+ *
+ * @param program single-output handle returned by parser_compile_symbols()
+ * @param vars value of each slot
+ * @param slots distinct variable slots to differentiate with respect to
+ * @param nslots number of slots
+ * @param gradient receives d program / d vars[slots[k]] for each k
+ * @return the program's value, NaN if out of memory or not single-output
+ */
+double rp_eval_gradient(const rp_program *program, const double *vars, const int *slots, int nslots,
+                        double *gradient);
+
+/**
+ * @brief Reusable workspace for rp_eval_adjoint()
+ *
+ * Holds the tape and adjoint stacks of the last evaluation; its memory is
+ * kept and reused by the next one. A tape is not thread safe; use one per
+ * thread.
+ */
+typedef struct rp_tape rp_tape;
+
+/**
+ * @brief Create an empty tape
+ * @return tape handle, or NULL if out of memory
+ */
+rp_tape *rp_tape_create(void);
+
+/**
+ * @brief Evaluate a program and its gradient with respect to every variable
+ *        by reverse-mode automatic differentiation
+ *
+ * Records the partial derivatives of each instruction on the tape while
+ * evaluating, then sweeps backwards. The cost is a small multiple of one
+ * evaluation however many variables there are, unlike rp_eval_gradient()
+ * whose cost grows with the number of slots. Values and derivative
+ * conventions are those of rp_eval_gradient().
+ *
+ * @param tape workspace from rp_tape_create()
+ * @param program single-output handle returned by parser_compile_symbols()
+ * @param vars value of each slot
+ * @param nslots length of gradient; slots at or past it are not reported
+ * @param gradient receives d program / d vars[k] for k < nslots
+ * @return the program's value, NaN if out of memory or not single-output
+ */
+double rp_eval_adjoint(rp_tape *tape, const rp_program *program, const double *vars, int nslots,
+                       double *gradient);
+
+/**
+ * @brief Release a tape
+ * @param tape handle to release, may be NULL
+ */
+void rp_tape_free(rp_tape *tape);
+
+/**
+ * @brief Cached outputs of a program, updated when some variables change,
+ *        see rp_update()
+ */
+typedef struct rp_incremental rp_incremental;
+
+/**
+ * @brief Prepare incremental evaluation of a program
+ *
+ * Works out which outputs and shared subexpressions read which variables.
+ * The program must outlive the state and not be changed meanwhile; a state
+ * is not thread safe.
+ *
+ * @param program handle returned by parser_compile_many() or parser_compile()
+ * @return state, or NULL if out of memory
+ */
+rp_incremental *rp_incremental_create(const rp_program *program);
+
+/**
+ * @brief Evaluate every output from scratch into the cache
+ */
+void rp_incremental_eval(rp_incremental *state, const double *vars);
+
+/**
+ * @brief Re-evaluate only the outputs that depend on changed variables
+ *
+ * Outputs reading a changed slot, directly or through a shared
+ * subexpression, are recomputed on the interpreter; the rest keep their
+ * cached values. The first call evaluates everything.
+ *
+ * @param vars all variables, with the changed ones already updated
+ * @param changed slots changed since the last update or evaluation
+ * @param nchanged number of slots in changed
+ * @return number of outputs recomputed
+ */
+int rp_update(rp_incremental *state, const double *vars, const int *changed, int nchanged);
+
+/**
+ * @brief Cached outputs, indexed like rp_eval_many()'s
+ */
+const double *rp_incremental_outputs(const rp_incremental *state);
+
+/**
+ * @brief Release an incremental state
+ * @param state handle to release, may be NULL
+ */
+void rp_incremental_free(rp_incremental *state);
+
+/**
+ * @brief Native function evaluating one program, see rp_jit_compile()
+ */
+typedef double (*rp_jit_fn)(const double *vars);
+
+/**
+ * @brief Lower a compiled program to native x86-64 machine code
+ *
+ * Generates scalar SSE2 code, plus a packed AVX kernel when the CPU supports
+ * it, into an executable page owned by the program. Afterwards rp_eval() and
+ * rp_eval_batch() run the native code automatically; the returned pointer
+ * can also be called directly. The code is released by rp_program_free().
+ *
+ * @param program handle returned by parser_compile()
+ * @return native function, or NULL if the program cannot be compiled (not
+ *         x86-64, multiple outputs, shared subexpressions, operand stack
+ *         deeper than 16, or no executable memory), in
+ *         which case the interpreter keeps being used
+ */
+rp_jit_fn rp_jit_compile(rp_program *program);
+
+/**
+ * @brief Function evaluating every output of a program, see rp_native_compile()
+ */
+typedef void (*rp_native_fn)(const double *vars, double *out);
+
+/**
+ * @brief Write a compiled program as a C translation unit of straight-line code
+ *
+ * Defines void name(const double *vars, double *out), which writes each
+ * output like rp_eval_many(). A single expression also gets
+ * double name_scalar(const double *vars) and
+ * void name_batch(const double *const *columns, size_t start, size_t end, double *out),
+ * evaluating rows [start, end) like rp_eval_batch(). The source is
+ * standalone: it carries copies of the library's inline eval functions,
+ * needs only libm, and gives the interpreter's results when compiled with
+ * -ffp-contract=off.
+ *
+ * @param name C identifier of the entry point
+ * @param out stream the source is written to
+ * @return 0, or -1 if writing failed
+ */
+int rp_native_source(const rp_program *program, const char *name, FILE *out);
+
+/**
+ * @brief Compile a program to native code with the system C compiler
+ *
+ * Writes the program with rp_native_source() into a temporary directory,
+ * builds it as a shared object with -O3 -march=native and loads it with
+ * dlopen(). Afterwards rp_eval(), rp_eval_many() and rp_eval_batch() run
+ * it automatically, ahead of rp_jit_compile()'s code. Compiling takes as
+ * long as the compiler does, so it pays for large models evaluated many
+ * times. The object is unloaded by rp_program_free().
+ *
+ * @param program handle returned by parser_compile() or parser_compile_many()
+ * @param compiler compiler command, or NULL for $CC, falling back to cc
+ * @return entry point, or NULL if no compiler could be run or the build
+ *         failed, in which case the program keeps its current evaluator
+ */
+rp_native_fn rp_native_compile(rp_program *program, const char *compiler);
+
+/**
+ * @brief Release a program returned by parser_compile()
+ * @param program handle to release, may be NULL
+ */
+void rp_program_free(rp_program *program);
+
+/**
+ * @brief Cache of compiled programs keyed by expression text, see rp_cache_eval()
+ *
+ * A cache is not thread safe; use one per thread or lock around it.
+ */
+typedef struct rp_cache rp_cache;
+
+/**
+ * @brief Counters of a cache, see rp_cache_statistics()
+ */
+typedef struct {
+    size_t hits; // lookups served without parsing
+    size_t misses; // lookups that compiled the expression
+    size_t evictions; // entries dropped to stay under max_bytes
+    size_t entries; // expressions currently cached
+    size_t bytes; // memory held by the entries
+    size_t max_bytes; // cap passed to rp_cache_create()
+} rp_cache_stats;
+
+/**
+ * @brief Create an empty least-recently-used program cache
+ *
+ * Because symbol table slots never change once added, entries stay valid
+ * while names are added to symbols.
+ *
+ * @param symbols table cached expressions are compiled against, may be NULL
+ * @param max_bytes memory the cached programs may use; the most recent entry
+ *        is always kept, even if it alone is larger
+ * @return cache handle, or NULL if out of memory
+ */
+rp_cache *rp_cache_create(const rp_symtab *symbols, size_t max_bytes);
+
+/**
+ * @brief Evaluate an expression, compiling it only if it is not cached
+ *
+ * Lookups hash the expression bytes. Expressions without variables are
+ * stored as their value. Expressions that fail to compile are not cached.
+ *
+ * @param cache cache to look in and add to
+ * @param expression the string expression to be evaluated
+ * @param vars value of each slot, may be NULL for expressions without variables
+ * @param result receives the value, NaN on error
+ * @param error receives the status and error position, may be NULL
+ * @return RP_OK or the parse error
+ */
+rp_status rp_cache_eval(rp_cache *cache, const char *expression, const double *vars,
+                        double *result, rp_error *error);
+
+/**
+ * @brief Read the hit/miss and memory counters of a cache
+ */
+void rp_cache_statistics(const rp_cache *cache, rp_cache_stats *stats);
+
+/**
+ * @brief Drop every entry; counters other than entries and bytes are kept
+ */
+void rp_cache_clear(rp_cache *cache);
+
+/**
+ * @brief Release a cache and all programs in it
+ * @param cache handle to release, may be NULL
+ */
+void rp_cache_free(rp_cache *cache);
+
+/**
+ * @brief Reaction network: rate expressions and a sparse stoichiometry
+ *        matrix, evaluated as the right-hand side of dX/dt = S v(X, p).
+ *
+ * A network holds its own workspace, so it is not thread safe; use one per
+ * thread.
+ */
+typedef struct rp_network rp_network;
+
+/**
+ * @brief Compile a reaction network
+ *
+ * The rates are compiled together with parser_compile_many(), so
+ * subexpressions shared between reactions are computed once per call. The
+ * stoichiometry matrix S (species by reaction) is given in compressed sparse
+ * row form and copied:
+ * the coefficients of species i are values[row_start[i] .. row_start[i+1]-1],
+ * for the reactions in reactions[] at the same positions.
+ *
+ * @param rates one rate expression per reaction
+ * @param nreactions number of reactions (columns of S)
+ * @param symbols table binding species and parameters to slots, may be NULL
+ * @param nspecies number of species (rows of S)
+ * @param row_start nspecies + 1 nondecreasing offsets, starting at 0
+ * @param reactions reaction index of each nonzero coefficient
+ * @param values each nonzero coefficient
+ * @param error receives the status; for RP_ERR_STOICHIOMETRY, position is
+ *        the offending species row. May be NULL
+ * @return network handle, or NULL on error
+ */
+rp_network *rp_network_create(const char *const *rates, int nreactions, const rp_symtab *symbols,
+                              int nspecies, const int *row_start, const int *reactions, const double *values,
+                              rp_error *error);
+
+/**
+ * @brief Evaluate dX/dt = S v(X, p) without allocating
+ *
+ * @param network handle returned by rp_network_create()
+ * @param vars value of each slot of the network's symbol table
+ * @param dxdt receives one derivative per species
+ */
+void rp_network_rhs(rp_network *network, const double *vars, double *dxdt);
+
+/**
+ * @brief Prepare evaluation of the Jacobian d(dX/dt)/dX
+ *
+ * Finds which species each rate reads and from that the sparsity pattern of
+ * the Jacobian, see rp_network_jacobian_pattern(). May be called again to
+ * change the slots.
+ *
+ * @param network handle returned by rp_network_create()
+ * @param species_slots variable slot holding each species, -1 for species
+ *        that are not variables of the rates
+ * @return RP_OK or RP_ERR_NO_MEMORY
+ */
+rp_status rp_network_jacobian_init(rp_network *network, const int *species_slots);
+
+/**
+ * @brief Sparsity pattern of the Jacobian in compressed sparse row form
+ *
+ * Row i holds the species whose concentration the derivative of species i
+ * depends on: columns[row_start[i] .. row_start[i+1]-1], in no particular
+ * order. The arrays belong to the network and are valid until the next
+ * rp_network_jacobian_init() or rp_network_free().
+ *
+ * @return number of structural nonzeros, or -1 before rp_network_jacobian_init()
+ */
+int rp_network_jacobian_pattern(const rp_network *network, const int **row_start, const int **columns);
+
+/**
+ * @brief Evaluate the Jacobian exactly, without allocating
+ *
+ * Each rate is differentiated by forward-mode automatic differentiation with
+ * respect to the species it reads, in one pass per reaction, and the
+ * partials are multiplied into the stoichiometry.
+ *
+ * @param network handle prepared with rp_network_jacobian_init()
+ * @param vars value of each slot
+ * @param values receives the nonzeros in the order of rp_network_jacobian_pattern()
+ */
+void rp_network_jacobian(rp_network *network, const double *vars, double *values);
+
+/**
+ * @brief Reaction rates computed by the last rp_network_rhs() or
+ *        rp_network_jacobian() call, one per reaction
+ */
+const double *rp_network_rates(const rp_network *network);
+
+/**
+ * @brief Number of species (rows of the stoichiometry matrix)
+ */
+int rp_network_species(const rp_network *network);
+
+/**
+ * @brief Number of reactions (columns of the stoichiometry matrix)
+ */
+int rp_network_reactions(const rp_network *network);
+
+/**
+ * @brief Release a network
+ * @param network handle to release, may be NULL
+ */
+void rp_network_free(rp_network *network);
+
+/**
+ * @brief Compile a network's rates to native code, see rp_native_compile()
+ *
+ * rp_network_rhs() then evaluates the rates with the generated function.
+ *
+ * @return 0 on success, -1 if the network keeps using the interpreter
+ */
+int rp_network_native_compile(rp_network *network, const char *compiler);
+
+/**
+ * @brief Stochastic simulation of a reaction network with Gillespie's
+ *        algorithm
+ *
+ * Each rate expression of the network is taken as its reaction's
+ * propensity, and species are molecule counts stored in the state vector.
+ * After a reaction fires, only the propensities that read a species it
+ * changed are evaluated again. A simulator reads the network, which must
+ * outlive it; it is not thread safe, so use one per thread.
+ */
+typedef struct rp_ssa rp_ssa;
+
+/**
+ * @brief How the next reaction is chosen
+ */
+typedef enum {
+    RP_SSA_DIRECT, // direct method, selection in a sum tree of propensities
+    RP_SSA_NEXT_REACTION, // Gibson-Bruck next reaction method, firing times in an indexed heap
+} rp_ssa_method;
+
+/**
+ * @brief Create a simulator for a network
+ *
+ * Builds the dependency graph from the species each rate reads and the
+ * species each reaction changes.
+ *
+ * @param species_slots variable slot holding the count of each species;
+ *        unlike rp_network_jacobian_init(), every species needs a slot
+ *        (>= 0), as firing a reaction updates the counts it changes
+ * @param seed random seed; equal seeds give equal trajectories
+ * @return simulator, or NULL if a slot is negative or out of memory
+ */
+rp_ssa *rp_ssa_create(const rp_network *network, const int *species_slots, rp_ssa_method method,
+                      uint64_t seed);
+
+/**
+ * @brief Start a trajectory from a state
+ *
+ * Evaluates every propensity. The simulator keeps vars and changes the
+ * species counts in it as reactions fire; call this again after changing
+ * vars from outside.
+ *
+ * @param vars state indexed by slot: species counts and parameters
+ * @param time starting time
+ */
+void rp_ssa_init(rp_ssa *ssa, double *vars, double time);
+
+/**
+ * @brief Fire the next reaction
+ *
+ * Propensities that are negative or NaN count as zero.
+ *
+ * @return index of the reaction that fired, or -1 if none can fire, in
+ *         which case the time becomes infinite
+ */
+int rp_ssa_step(rp_ssa *ssa);
+
+/**
+ * @brief Fire every reaction that happens up to a time, then set the clock
+ *        to it
+ * @return number of reactions fired
+ */
+long rp_ssa_advance(rp_ssa *ssa, double until);
+
+/**
+ * @brief Time of the last reaction fired, or the time last advanced to
+ */
+double rp_ssa_time(const rp_ssa *ssa);
+
+/**
+ * @brief Current propensity of each reaction
+ */
+const double *rp_ssa_propensities(const rp_ssa *ssa);
+
+/**
+ * @brief Release a simulator
+ * @param ssa handle to release, may be NULL
+ */
+void rp_ssa_free(rp_ssa *ssa);
+
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
+
+#endif // PARSER_H
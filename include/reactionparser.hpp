@@ -0,0 +1,375 @@
+/**
+ * @file reactionparser.hpp
+ * @brief C++ layer over the parser: programs as RAII objects, evaluated for
+ *        any scalar type by a templated opcode loop.
+ *
+ * rp::program::eval<T>() runs a compiled program's bytecode (bytecode.h)
+ * with an operand stack of T, so the loop is instantiated per type at
+ * compile time and every operation inlines:
+ *   - float, which doubles the lanes of vectorized parameter screens
+ *   - double
+ *   - rp::vec<T, N>, N lanes in a GCC vector register; rp::vec4d has the
+ *     layout of __m256d and rp::vec8f that of __m256
+ *   - rp::dual<T, N>, a value with N forward-mode derivatives
+ *
+ * Operations happen in the interpreter's order. On double, exp, log and tanh
+ * are the library's own kernels (vecmath.h), so results equal rp_eval() bit
+ * for bit; float uses <cmath>. A type only needs arithmetic operators, a
+ * constructor from double, and the functions below found by overload
+ * resolution in namespace rp. The double overloads are constexpr, for the
+ * compile-time folding of reactionparser_expr.hpp.
+ *
+ * @date 2025
+ */
+#ifndef REACTIONPARSER_HPP
+#define REACTIONPARSER_HPP
+
+// --- library import --- //
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "parser.h"
+#include "bytecode.h"
+#include "vecmath.h"
+
+namespace rp {
+
+// -- math on plain floating point; the C library's % works in float precision
+inline float pow(float a, float b) { return std::pow(a, b); }
+constexpr double pow(double a, double b) { return __builtin_pow(a, b); }
+inline float mod(float a, float b) { return std::fmod(a, b); }
+constexpr double mod(double a, double b) { return __builtin_fmodf(static_cast<float>(a), static_cast<float>(b)); }
+inline float exp(float x) { return std::exp(x); }
+constexpr double exp(double x) { return vm_exp(x); }
+inline float log(float x) { return std::log(x); }
+constexpr double log(double x) { return vm_log(x); }
+inline float sqrt(float x) { return std::sqrt(x); }
+constexpr double sqrt(double x) { return __builtin_sqrt(x); }
+inline float abs(float x) { return std::fabs(x); }
+constexpr double abs(double x) { return __builtin_fabs(x); }
+inline float tanh(float x) { return std::tanh(x); }
+constexpr double tanh(double x) { return vm_tanh(x); }
+inline float min(float a, float b) { return a < b ? a : b; }
+constexpr double min(double a, double b) { return a < b ? a : b; }
+inline float max(float a, float b) { return a > b ? a : b; }
+constexpr double max(double a, double b) { return a > b ? a : b; }
+
+/**
+ * @brief N lanes of T in one GCC vector register, evaluated lane by lane
+ *
+ * Arithmetic, min and max are vector instructions; the other functions
+ * loop over the lanes, which the compiler unrolls.
+ */
+template <class T, int N>
+struct vec {
+    typedef T native __attribute__((vector_size(N * sizeof(T))));
+    native v;
+
+    vec() = default;
+    vec(double x) { for (int i = 0; i < N; ++i) v[i] = static_cast<T>(x); }
+    static vec of(native x) { vec r; r.v = x; return r; }
+    T operator[](int i) const { return v[i]; }
+    T &operator[](int i) { return reinterpret_cast<T *>(&v)[i]; }
+
+    friend vec operator-(vec a) { return of(-a.v); }
+    friend vec operator+(vec a, vec b) { return of(a.v + b.v); }
+    friend vec operator-(vec a, vec b) { return of(a.v - b.v); }
+    friend vec operator*(vec a, vec b) { return of(a.v * b.v); }
+    friend vec operator/(vec a, vec b) { return of(a.v / b.v); }
+};
+
+typedef vec<double, 4> vec4d; // __m256d
+typedef vec<float, 8> vec8f; // __m256
+
+template <class T, int N, class F>
+inline vec<T, N> lanes(vec<T, N> a, vec<T, N> b, F f) {
+    vec<T, N> r;
+    for (int i = 0; i < N; ++i) r.v[i] = f(a.v[i], b.v[i]);
+    return r;
+}
+
+template <class T, int N> inline vec<T, N> pow(vec<T, N> a, vec<T, N> b) {
+    return lanes(a, b, [](T x, T y) { return rp::pow(x, y); });
+}
+template <class T, int N> inline vec<T, N> mod(vec<T, N> a, vec<T, N> b) {
+    return lanes(a, b, [](T x, T y) { return rp::mod(x, y); });
+}
+template <class T, int N> inline vec<T, N> exp(vec<T, N> a) {
+    return lanes(a, a, [](T x, T) { return rp::exp(x); });
+}
+template <class T, int N> inline vec<T, N> log(vec<T, N> a) {
+    return lanes(a, a, [](T x, T) { return rp::log(x); });
+}
+template <class T, int N> inline vec<T, N> sqrt(vec<T, N> a) {
+    return lanes(a, a, [](T x, T) { return rp::sqrt(x); });
+}
+template <class T, int N> inline vec<T, N> abs(vec<T, N> a) {
+    return lanes(a, a, [](T x, T) { return rp::abs(x); });
+}
+template <class T, int N> inline vec<T, N> tanh(vec<T, N> a) {
+    return lanes(a, a, [](T x, T) { return rp::tanh(x); });
+}
+template <class T, int N> inline vec<T, N> min(vec<T, N> a, vec<T, N> b) {
+    return vec<T, N>::of(a.v < b.v ? a.v : b.v);
+}
+template <class T, int N> inline vec<T, N> max(vec<T, N> a, vec<T, N> b) {
+    return vec<T, N>::of(a.v > b.v ? a.v : b.v);
+}
+
+/**
+ * @brief A value of T with N forward-mode derivatives
+ *
+ * Seed input k with dual::variable(x, k); the result then carries its
+ * derivative with respect to each seeded input. Derivatives follow the same
+ * conventions as rp_eval_gradient(): min and max take the derivative of the
+ * operand they pick, and pow has no derivative in the exponent at a
+ * non-positive base.
+ */
+template <class T, int N = 1>
+struct dual {
+    T v;
+    T d[N];
+
+    dual() = default;
+    dual(double x) : v(static_cast<T>(x)) { for (int k = 0; k < N; ++k) d[k] = T(0); }
+    static dual variable(T x, int k) { dual r(0.0); r.v = x; r.d[k] = T(1); return r; }
+
+    // f(a) with f'(a) = da
+    static dual chain(T value, const dual &a, T da) {
+        dual r;
+        r.v = value;
+        for (int k = 0; k < N; ++k) r.d[k] = da * a.d[k];
+        return r;
+    }
+    // f(a, b) with partials da and db
+    static dual chain(T value, const dual &a, T da, const dual &b, T db) {
+        dual r;
+        r.v = value;
+        for (int k = 0; k < N; ++k) r.d[k] = da * a.d[k] + db * b.d[k];
+        return r;
+    }
+
+    friend dual operator-(const dual &a) { return chain(-a.v, a, T(-1)); }
+    friend dual operator+(const dual &a, const dual &b) { return chain(a.v + b.v, a, T(1), b, T(1)); }
+    friend dual operator-(const dual &a, const dual &b) { return chain(a.v - b.v, a, T(1), b, T(-1)); }
+    friend dual operator*(const dual &a, const dual &b) { return chain(a.v * b.v, a, b.v, b, a.v); }
+    friend dual operator/(const dual &a, const dual &b) {
+        T value = a.v / b.v;
+        return chain(value, a, T(1) / b.v, b, -value / b.v);
+    }
+};
+
+template <class T, int N> inline dual<T, N> pow(const dual<T, N> &a, const dual<T, N> &b) {
+    T value = rp::pow(a.v, b.v);
+    T da = b.v == T(0) ? T(0) : b.v * rp::pow(a.v, b.v - T(1));
+    T db = a.v > T(0) ? value * rp::log(a.v) : T(0);
+    return dual<T, N>::chain(value, a, da, b, db);
+}
+template <class T, int N> inline dual<T, N> mod(const dual<T, N> &a, const dual<T, N> &b) {
+    return dual<T, N>::chain(rp::mod(a.v, b.v), a, T(1), b, -std::trunc(a.v / b.v));
+}
+template <class T, int N> inline dual<T, N> exp(const dual<T, N> &a) {
+    T value = rp::exp(a.v);
+    return dual<T, N>::chain(value, a, value);
+}
+template <class T, int N> inline dual<T, N> log(const dual<T, N> &a) {
+    return dual<T, N>::chain(rp::log(a.v), a, T(1) / a.v);
+}
+template <class T, int N> inline dual<T, N> sqrt(const dual<T, N> &a) {
+    T value = rp::sqrt(a.v);
+    return dual<T, N>::chain(value, a, T(0.5) / value);
+}
+template <class T, int N> inline dual<T, N> abs(const dual<T, N> &a) {
+    return dual<T, N>::chain(rp::abs(a.v), a, a.v < T(0) ? T(-1) : T(1));
+}
+template <class T, int N> inline dual<T, N> tanh(const dual<T, N> &a) {
+    T value = rp::tanh(a.v);
+    return dual<T, N>::chain(value, a, T(1) - value * value);
+}
+template <class T, int N> inline dual<T, N> min(const dual<T, N> &a, const dual<T, N> &b) {
+    return a.v < b.v ? a : b;
+}
+template <class T, int N> inline dual<T, N> max(const dual<T, N> &a, const dual<T, N> &b) {
+    return a.v > b.v ? a : b;
+}
+
+// x^(half_power / 2) by square-and-multiply, rounding like eval_power()
+template <class T>
+inline T power(const T &x, int half_power) {
+    T result = half_power & 1 ? rp::sqrt(x) : T(1.0);
+    T base = x;
+    for (int p = half_power >> 1; p; p >>= 1) {
+        if (p & 1) result = result * base;
+        base = base * base;
+    }
+    return result;
+}
+
+/**
+ * @brief Run bytecode on a stack of T
+ *
+ * @param stack maxdepth values
+ * @param temps ntemps values
+ * @param out one value per output, or NULL for single expressions
+ * @return the value left at the bottom of the stack
+ */
+template <class T>
+T run(const rp_bytecode &b, const T *vars, T *stack, T *temps, T *out) {
+    int n = 0;
+    for (int i = 0; i < b.ncode; ++i) {
+        const Instruction &in = b.code[i];
+        switch (in.opcode) {
+            case OPC_CONST: stack[n++] = T(b.consts[in.arg]); break;
+            case OPC_VAR: stack[n++] = vars[in.arg]; break;
+            case OPC_NEG: stack[n-1] = -stack[n-1]; break;
+            case OPC_POW: n--; stack[n-1] = rp::pow(stack[n-1], stack[n]); break;
+            case OPC_MUL: n--; stack[n-1] = stack[n-1] * stack[n]; break;
+            case OPC_DIV: n--; stack[n-1] = stack[n-1] / stack[n]; break;
+            case OPC_MOD: n--; stack[n-1] = rp::mod(stack[n-1], stack[n]); break;
+            case OPC_ADD: n--; stack[n-1] = stack[n-1] + stack[n]; break;
+            case OPC_SUB: n--; stack[n-1] = stack[n-1] - stack[n]; break;
+            case OPC_MIN: n--; stack[n-1] = rp::min(stack[n-1], stack[n]); break;
+            case OPC_MAX: n--; stack[n-1] = rp::max(stack[n-1], stack[n]); break;
+            case OPC_EXP: stack[n-1] = rp::exp(stack[n-1]); break;
+            case OPC_LOG: stack[n-1] = rp::log(stack[n-1]); break;
+            case OPC_SQRT: stack[n-1] = rp::sqrt(stack[n-1]); break;
+            case OPC_ABS: stack[n-1] = rp::abs(stack[n-1]); break;
+            case OPC_TANH: stack[n-1] = rp::tanh(stack[n-1]); break;
+            case OPC_MONOMIAL: {
+                const Monomial &term = b.terms[in.arg];
+                T result(1.0);
+                for (int k = 0; k < term.nfactors; ++k) {
+                    const Factor &f = b.factors[term.first + k];
+                    result = result * power(f.operand >= 0 ? vars[f.operand] : T(b.consts[~f.operand]),
+                                            f.half_power);
+                }
+                stack[n++] = result;
+                break;
+            }
+            case OPC_MICHAELIS: {
+                n -= 2;
+                const T *x = stack + n - 1;
+                stack[n-1] = x[0] * x[1] / (x[2] + x[1]);
+                break;
+            }
+            case OPC_HILL: {
+                n -= 3;
+                const T *x = stack + n - 1;
+                T sn = in.arg ? power(x[1], in.arg) : rp::pow(x[1], x[3]);
+                T kn = in.arg ? power(x[2], in.arg) : rp::pow(x[2], x[3]);
+                stack[n-1] = x[0] * sn / (kn + sn);
+                break;
+            }
+            case OPC_REVERSIBLE_MM: {
+                n -= 5;
+                const T *x = stack + n - 1;
+                stack[n-1] = (x[0] * x[1] / x[2] - x[3] * x[4] / x[5]) / (T(1.0) + x[1] / x[2] + x[4] / x[5]);
+                break;
+            }
+            case OPC_STORE: temps[in.arg] = stack[n-1]; break;
+            case OPC_LOAD: stack[n++] = temps[in.arg]; break;
+            case OPC_OUTPUT: out[in.arg] = stack[--n]; break;
+        }
+    }
+    return stack[0];
+}
+
+/**
+ * @brief Parsing failure, carrying the C library's rp_error
+ */
+class error : public std::runtime_error {
+public:
+    explicit error(const rp_error &detail)
+        : std::runtime_error(std::string(rp_strerror(detail.status)) + " at "
+                             + std::to_string(detail.position)),
+          detail_(detail) {}
+    const rp_error &detail() const { return detail_; }
+
+private:
+    rp_error detail_;
+};
+
+/**
+ * @brief A compiled program, released with the object
+ */
+class program {
+public:
+    /**
+     * @brief Compile one expression
+     * @throw rp::error if it does not parse
+     */
+    program(const char *expression, const rp_symtab *symbols) {
+        rp_error e;
+        adopt(parser_compile_symbols(expression, symbols, &e), e);
+    }
+
+    /**
+     * @brief Compile expressions into one program with an output each,
+     *        sharing common subexpressions
+     * @throw rp::error if one does not parse
+     */
+    program(const std::vector<const char *> &expressions, const rp_symtab *symbols) {
+        rp_error e;
+        adopt(parser_compile_many(expressions.data(), static_cast<int>(expressions.size()), symbols, &e), e);
+    }
+
+    program(const program &) = delete;
+    program &operator=(const program &) = delete;
+    program(program &&other) noexcept : handle_(other.handle_), code_(other.code_) { other.handle_ = nullptr; }
+    program &operator=(program &&other) noexcept {
+        std::swap(handle_, other.handle_);
+        std::swap(code_, other.code_);
+        return *this;
+    }
+    ~program() { rp_program_free(handle_); }
+
+    /**
+     * @brief Evaluate a single expression on values of T, indexed by slot
+     * @return NAN for a program with several outputs, like rp_eval();
+     *         evaluate those with eval_many()
+     */
+    template <class T>
+    T eval(const T *vars) const {
+        if (code_.noutputs != 1) return T(NAN);
+        T local[STACK_LOCAL];
+        if (code_.maxdepth + code_.ntemps <= STACK_LOCAL) {
+            return run<T>(code_, vars, local, local + code_.maxdepth, nullptr);
+        }
+        std::vector<T> stack(code_.maxdepth + code_.ntemps);
+        return run<T>(code_, vars, stack.data(), stack.data() + code_.maxdepth, nullptr);
+    }
+
+    /**
+     * @brief Evaluate every output on values of T, like rp_eval_many()
+     */
+    template <class T>
+    void eval_many(const T *vars, T *out) const {
+        std::vector<T> stack(code_.maxdepth + code_.ntemps);
+        T result = run<T>(code_, vars, stack.data(), stack.data() + code_.maxdepth, out);
+        if (code_.noutputs == 1) out[0] = result;
+    }
+
+    int outputs() const { return code_.noutputs; }
+    const rp_bytecode &bytecode() const { return code_; }
+    rp_program *get() const { return handle_; }
+
+private:
+    static constexpr int STACK_LOCAL = 64; // stack and temporaries kept on the C++ stack
+
+    void adopt(rp_program *handle, const rp_error &e) {
+        if (!handle) throw error(e);
+        handle_ = handle;
+        rp_program_bytecode(handle_, &code_);
+    }
+
+    rp_program *handle_ = nullptr;
+    rp_bytecode code_;
+};
+
+} // namespace rp
+
+#endif // REACTIONPARSER_HPP
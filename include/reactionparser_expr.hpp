@@ -0,0 +1,1077 @@
+/**
+ * @file reactionparser_expr.hpp
+ * @brief Compile-time parsing of expressions written as string literals
+ *        (C++20).
+ *
+ * rp::expr<"k1*A*B - k2*C"> runs the parser at compile time and turns the
+ * expression into a tree of templates, one per node, so evaluating it is
+ * straight-line code the compiler inlines and optimizes like hand-written
+ * arithmetic, with no parsing or dispatch left at run time.
+ *
+ * The parser is the runtime shunting-yard algorithm of parser.c written as
+ * constexpr functions, with the same operator table and the same checks:
+ * precedence and associativity, unary minus binding tighter than ^, built-in
+ * functions, min and max over two or more arguments, and numeric literals
+ * rounded correctly to the nearest double. Malformed expressions fail to
+ * compile, and rp::detail::parse() reports the status and byte position that
+ * parser_check() would.
+ *
+ * Before it is evaluated, the tree goes through the runtime compiler's passes:
+ * constants are folded with the library's own kernels, identities dropped,
+ * operands ordered, rate laws recognised and products fused into monomials.
+ * For double the result is then rp_eval()'s bit for bit, provided the code is
+ * built without -ffast-math and with -ffp-contract=off, which would reorder
+ * or fuse the arithmetic. Other scalar types T use the math functions
+ * reactionparser.hpp provides for them.
+ *
+ * @date 2025
+ */
+#ifndef REACTIONPARSER_EXPR_HPP
+#define REACTIONPARSER_EXPR_HPP
+
+// --- library import --- //
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+
+#include "reactionparser.hpp"
+
+namespace rp {
+
+/**
+ * @brief A string literal usable as a template argument
+ */
+template <std::size_t N>
+struct fixed_string {
+    char chars[N] = {};
+    static constexpr int capacity = static_cast<int>(N); // including the terminating '\0'
+
+    constexpr fixed_string(const char (&s)[N]) {
+        for (std::size_t i = 0; i < N; ++i) chars[i] = s[i];
+    }
+};
+
+namespace detail {
+
+// -- decimal literals, rounded like decimal_to_double() and strtod()
+
+/* halfway points between doubles have at most 768 significant digits; past
+   this many, the remaining digits only matter as being zero or not */
+constexpr int EXACT_DIGITS = 800;
+constexpr int MAX_EXPONENT = 100000; // clamped like the runtime scanner
+
+// unsigned integer of up to 4096 bits, enough for any literal that scales to a finite double
+struct bignum {
+    static constexpr int LIMBS = 128;
+    std::uint32_t limb[LIMBS] = {};
+    int n = 0; // limbs in use, the highest nonzero
+
+    constexpr bool zero() const { return n == 0; }
+
+    // *this = *this * m + a
+    constexpr void mul_add(std::uint32_t m, std::uint32_t a) {
+        std::uint64_t carry = a;
+        for (int i = 0; i < n; ++i) {
+            std::uint64_t t = static_cast<std::uint64_t>(limb[i]) * m + carry;
+            limb[i] = static_cast<std::uint32_t>(t);
+            carry = t >> 32;
+        }
+        if (carry) limb[n++] = static_cast<std::uint32_t>(carry);
+    }
+
+    constexpr int bits() const {
+        return n ? 32 * (n - 1) + 32 - std::countl_zero(limb[n-1]) : 0;
+    }
+
+    constexpr bool bit(int i) const {
+        return i >= 0 && i / 32 < n && (limb[i / 32] >> (i % 32)) & 1;
+    }
+
+    // whether any bit below bit i is set
+    constexpr bool any_below(int i) const {
+        for (int k = 0; k < i / 32 && k < n; ++k) {
+            if (limb[k]) return true;
+        }
+        return i % 32 && i / 32 < n && limb[i / 32] & ((1u << (i % 32)) - 1);
+    }
+
+    // bits [from, from + 64)
+    constexpr std::uint64_t extract(int from) const {
+        std::uint64_t r = 0;
+        for (int i = 63; i >= 0; --i) r = r << 1 | bit(from + i);
+        return r;
+    }
+
+    constexpr void shift_left(int s) {
+        int words = s / 32, rest = s % 32;
+        if (!n) return;
+        limb[n + words] = 0;
+        for (int i = n - 1; i >= 0; --i) {
+            limb[i + words + 1] |= rest ? limb[i] >> (32 - rest) : 0;
+            limb[i + words] = limb[i] << rest;
+        }
+        for (int i = 0; i < words; ++i) limb[i] = 0;
+        n += words + 1;
+        while (n && !limb[n-1]) --n;
+    }
+
+    constexpr void shift_right1() {
+        for (int i = 0; i < n; ++i) limb[i] = limb[i] >> 1 | (i + 1 < n ? limb[i+1] << 31 : 0);
+        while (n && !limb[n-1]) --n;
+    }
+
+    constexpr int compare(const bignum &o) const {
+        if (n != o.n) return n < o.n ? -1 : 1;
+        for (int i = n - 1; i >= 0; --i) {
+            if (limb[i] != o.limb[i]) return limb[i] < o.limb[i] ? -1 : 1;
+        }
+        return 0;
+    }
+
+    // *this -= o, for o <= *this
+    constexpr void subtract(const bignum &o) {
+        std::int64_t borrow = 0;
+        for (int i = 0; i < n; ++i) {
+            std::int64_t t = static_cast<std::int64_t>(limb[i]) - (i < o.n ? o.limb[i] : 0) - borrow;
+            borrow = t < 0;
+            limb[i] = static_cast<std::uint32_t>(t + (borrow << 32));
+        }
+        while (n && !limb[n-1]) --n;
+    }
+};
+
+/**
+ * @brief (m + a nonzero fraction when sticky) * 2^e2, rounded to the nearest
+ *        double, ties to even
+ */
+constexpr double round_binary(const bignum &m, int e2, bool sticky) {
+    int lsb = m.bits() - 1 + e2 - 52; // weight of the last mantissa bit
+    if (lsb < -1074) lsb = -1074; // subnormal
+    int shift = lsb - e2;
+    std::uint64_t kept;
+    if (shift <= 0) {
+        kept = m.extract(0) << -shift;
+    } else {
+        kept = m.extract(shift);
+        bool half = m.bit(shift - 1);
+        if (half && (sticky || m.any_below(shift - 1) || kept & 1)) kept++;
+    }
+    if (kept >> 53) {
+        kept >>= 1;
+        lsb++;
+    }
+    if (!(kept >> 52)) return std::bit_cast<double>(kept); // subnormal or zero
+    int biased = lsb + 52 + 1023;
+    if (biased >= 2047) return std::numeric_limits<double>::infinity();
+    return std::bit_cast<double>(static_cast<std::uint64_t>(biased) << 52 | (kept & ((std::uint64_t(1) << 52) - 1)));
+}
+
+/**
+ * @brief w * 10^q correctly rounded, w having digits significant digits
+ */
+constexpr double decimal_value(bignum w, int digits, int q) {
+    if (w.zero()) return 0.0;
+    if (q + digits > 310) return std::numeric_limits<double>::infinity();
+    if (q + digits < -324) return 0.0; // below half the smallest subnormal
+    if (q >= 0) {
+        for (int k = 0; k < q; ++k) w.mul_add(10, 0);
+        return round_binary(w, 0, false);
+    }
+
+    // floor(w * 2^k / 10^-q) with 56 or 57 bits, and whether it was exact
+    bignum divisor;
+    divisor.mul_add(1, 1);
+    for (int k = 0; k < -q; ++k) divisor.mul_add(10, 0);
+    int k = divisor.bits() - w.bits() + 56;
+    if (k >= 0) w.shift_left(k);
+    else divisor.shift_left(-k);
+    int top = w.bits() - divisor.bits() + 1;
+    divisor.shift_left(top);
+    std::uint64_t quotient = 0;
+    for (int j = top; j >= 0; --j) {
+        if (w.compare(divisor) >= 0) {
+            w.subtract(divisor);
+            quotient |= std::uint64_t(1) << j;
+        }
+        divisor.shift_right1();
+    }
+    bignum m;
+    m.limb[0] = static_cast<std::uint32_t>(quotient);
+    m.limb[1] = static_cast<std::uint32_t>(quotient >> 32);
+    m.n = 2;
+    return round_binary(m, -k, !w.zero());
+}
+
+constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+constexpr bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+constexpr bool is_ident_start(char c) { return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+constexpr bool continues_ident(char c) { return is_ident_start(c) || is_digit(c); }
+
+/**
+ * @brief Scan a decimal literal starting at s[i], like scan_number()
+ * @return the index after the literal, or -1 if it has no digits
+ */
+constexpr int scan_number(const char *s, int i, double &value) {
+    bignum w;
+    int digits = 0, q = 0;
+    bool seen = false, truncated = false;
+    for (; is_digit(s[i]); ++i, seen = true) {
+        if (digits < EXACT_DIGITS) {
+            w.mul_add(10, s[i] - '0');
+            digits += !w.zero();
+        } else {
+            q++;
+            truncated |= s[i] != '0';
+        }
+    }
+    if (s[i] == '.') {
+        for (++i; is_digit(s[i]); ++i, seen = true) {
+            if (digits < EXACT_DIGITS) {
+                w.mul_add(10, s[i] - '0');
+                digits += !w.zero();
+                q--;
+            } else {
+                truncated |= s[i] != '0';
+            }
+        }
+    }
+    if (!seen) return -1;
+
+    if (s[i] == 'e' || s[i] == 'E') {
+        int e = i + 1;
+        bool negative = s[e] == '-';
+        if (s[e] == '-' || s[e] == '+') e++;
+        if (is_digit(s[e])) {
+            int exponent = 0;
+            for (; is_digit(s[e]); ++e) {
+                if (exponent < MAX_EXPONENT) exponent = 10 * exponent + (s[e] - '0');
+            }
+            q += negative ? -exponent : exponent;
+            i = e;
+        }
+    }
+    // dropped digits only say the value lies above w * 10^q: a trailing 1 keeps that
+    if (truncated) {
+        w.mul_add(10, 1);
+        digits++;
+        q--;
+    }
+    value = decimal_value(w, digits, q);
+    return i;
+}
+
+// -- the runtime parser's operator table
+enum { ASSOC_NONE = 0, ASSOC_LEFT, ASSOC_RIGHT };
+
+struct operator_info {
+    char symbol;
+    int precedence;
+    int association;
+    bool unary;
+    int opcode;
+    const char *name = nullptr; // built-in functions only
+    int arity = 0; // arguments a function takes, -1 for two or more
+};
+
+enum { OPI_UMINUS = 0, OPI_LPAREN = 7, OPI_FUNCTIONS = 10, NOPERATORS = 17 };
+inline constexpr operator_info operators[NOPERATORS] = {
+    {'_', 10, ASSOC_RIGHT, true, OPC_NEG},
+    {'^', 9, ASSOC_RIGHT, false, OPC_POW},
+    {'*', 8, ASSOC_LEFT, false, OPC_MUL},
+    {'/', 8, ASSOC_LEFT, false, OPC_DIV},
+    {'%', 8, ASSOC_LEFT, false, OPC_MOD},
+    {'+', 5, ASSOC_LEFT, false, OPC_ADD},
+    {'-', 5, ASSOC_LEFT, false, OPC_SUB},
+    {'(', 0, ASSOC_NONE, false, OPC_NONE},
+    {')', 0, ASSOC_NONE, false, OPC_NONE},
+    {',', 0, ASSOC_NONE, false, OPC_NONE},
+    // OPI_FUNCTIONS onwards
+    {'f', 11, ASSOC_RIGHT, true, OPC_EXP, "exp", 1},
+    {'f', 11, ASSOC_RIGHT, true, OPC_LOG, "log", 1},
+    {'f', 11, ASSOC_RIGHT, true, OPC_SQRT, "sqrt", 1},
+    {'f', 11, ASSOC_RIGHT, true, OPC_ABS, "abs", 1},
+    {'f', 11, ASSOC_RIGHT, true, OPC_TANH, "tanh", 1},
+    {'f', 11, ASSOC_RIGHT, false, OPC_MIN, "min", -1},
+    {'f', 11, ASSOC_RIGHT, false, OPC_MAX, "max", -1},
+};
+/* operators are passed around as indices into operators[]: constant
+   evaluation under -fsanitize=undefined rejects comparing their addresses */
+enum { OPI_NOT_FOUND = -1, OPI_OPERAND = -2, OPI_START = -3 };
+
+constexpr int find_operator(char c) {
+    for (int i = 0; i < OPI_FUNCTIONS; ++i) {
+        if (operators[i].symbol == c && c != '_') return i;
+    }
+    return OPI_NOT_FOUND;
+}
+
+constexpr int find_function(const char *name, int length) {
+    for (int i = OPI_FUNCTIONS; i < NOPERATORS; ++i) {
+        const char *f = operators[i].name;
+        int k = 0;
+        while (k < length && f[k] == name[k]) ++k;
+        if (k == length && f[k] == '\0') return i;
+    }
+    return OPI_NOT_FOUND;
+}
+
+/**
+ * @brief An expression as a tree, the form the runtime optimizer rebuilds
+ *        from postfix; N bounds the nodes, one per byte at most
+ */
+template <int N>
+struct syntax_tree {
+    struct node {
+        int opcode = OPC_NONE;
+        int arg = 0; // index into the names for OPC_VAR
+        double value = 0; // OPC_CONST
+        int left = -1; // operand node, -1 for loads
+        int right = -1; // right operand of binary operators, -1 otherwise
+    };
+    node nodes[N] = {};
+    int nnodes = 0;
+    int root = -1;
+    // identifiers in order of first use, as offsets into the expression
+    int name_start[N] = {};
+    int name_length[N] = {};
+    int nnames = 0;
+    rp_status status = RP_OK;
+    int position = 0; // byte offset of the error
+};
+
+// compile_expression() of parser.c, building a tree instead of postfix
+template <int N>
+struct parser {
+    syntax_tree<N> tree;
+    const char *s = nullptr;
+    int opstack[N] = {}; // indices into operators[]
+    int oppos[N] = {}; // where each stacked operator appeared, for errors
+    int opdepth[N] = {}; // operand depth when each operator was stacked; counts function arguments
+    int nopstack = 0;
+    int operands[N] = {}; // nodes computing the pending operands
+    int depth = 0;
+
+    constexpr bool fail(rp_status status, int at) {
+        tree.status = status;
+        tree.position = at;
+        return false;
+    }
+
+    constexpr void push(int opcode, int arg, double value) {
+        tree.nodes[tree.nnodes] = { opcode, arg, value, -1, -1 };
+        operands[depth++] = tree.nnodes++;
+    }
+
+    // replace the top arity operands with opcode applied to them
+    constexpr void apply(int opcode, int arity) {
+        int right = arity == 2 ? operands[--depth] : -1;
+        tree.nodes[tree.nnodes] = { opcode, 0, 0, operands[depth-1], right };
+        operands[depth-1] = tree.nnodes++;
+    }
+
+    // slot among the names, added on first use
+    constexpr int name(int start, int length) {
+        for (int k = 0; k < tree.nnames; ++k) {
+            if (tree.name_length[k] != length) continue;
+            int c = 0;
+            while (c < length && s[tree.name_start[k] + c] == s[start + c]) ++c;
+            if (c == length) return k;
+        }
+        tree.name_start[tree.nnames] = start;
+        tree.name_length[tree.nnames] = length;
+        return tree.nnames++;
+    }
+
+    constexpr bool push_operator(int op, int at) {
+        oppos[nopstack] = at;
+        opdepth[nopstack] = depth;
+        opstack[nopstack++] = op;
+        return true;
+    }
+
+    constexpr bool reduce_operator() {
+        const operator_info &op = operators[opstack[--nopstack]];
+        int at = oppos[nopstack];
+        int arity = op.unary ? 1 : 2;
+        if (op.opcode == OPC_NONE) return fail(RP_ERR_UNMATCHED_OPEN, at);
+        if (depth < arity) return fail(RP_ERR_MISSING_OPERAND, at);
+        apply(op.opcode, arity);
+        return true;
+    }
+
+    // min(a, b, c) emits its opcode twice after the arguments: min(a, min(b, c))
+    constexpr bool reduce_function() {
+        const operator_info &function = operators[opstack[--nopstack]];
+        int at = oppos[nopstack];
+        int nargs = depth - opdepth[nopstack];
+        if (function.arity < 0 ? nargs < 2 : nargs != function.arity) {
+            return fail(RP_ERR_ARGUMENT_COUNT, at);
+        }
+        for (int k = function.unary ? 0 : 1; k < nargs; ++k) apply(function.opcode, function.unary ? 1 : 2);
+        return true;
+    }
+
+    constexpr bool shunt(int index, int at) {
+        const operator_info &op = operators[index];
+        if (op.symbol == '(') return push_operator(index, at);
+        if (op.symbol == ')' || op.symbol == ',') {
+            while (nopstack > 0 && operators[opstack[nopstack-1]].symbol != '(') {
+                if (!reduce_operator()) return false;
+            }
+            if (!nopstack) return fail(op.symbol == ')' ? RP_ERR_UNMATCHED_CLOSE : RP_ERR_SYNTAX, at);
+            bool call = nopstack > 1 && opstack[nopstack-2] >= OPI_FUNCTIONS;
+            if (op.symbol == ',') return call || fail(RP_ERR_SYNTAX, at);
+            nopstack--;
+            return !call || reduce_function();
+        }
+        if (op.association == ASSOC_RIGHT) {
+            while (nopstack && op.precedence < operators[opstack[nopstack-1]].precedence) {
+                if (!reduce_operator()) return false;
+            }
+        } else {
+            while (nopstack && op.precedence <= operators[opstack[nopstack-1]].precedence) {
+                if (!reduce_operator()) return false;
+            }
+        }
+        return push_operator(index, at);
+    }
+
+    // whether the last token closed an operand: a value, or ')'
+    static constexpr bool after_operand(int last) {
+        return last == OPI_OPERAND || (last >= 0 && operators[last].symbol == ')');
+    }
+
+    constexpr bool run() {
+        int last = OPI_START; // operator index, or OPI_OPERAND after a value
+        int i = 0;
+        for (;;) {
+            int start = i;
+            char c = s[i];
+            if (c == '\0') break;
+            if (is_space(c)) {
+                i++;
+                continue;
+            }
+            if (int op = find_operator(c); op != OPI_NOT_FOUND) {
+                if (!after_operand(last)) {
+                    if (operators[op].symbol == '-') op = OPI_UMINUS;
+                    else if (operators[op].symbol != '(') return fail(RP_ERR_BINARY_OPERATOR, i);
+                }
+                if (!shunt(op, i)) return false;
+                last = op;
+                i++;
+                continue;
+            }
+            if (!is_digit(c) && c != '.' && !is_ident_start(c)) return fail(RP_ERR_SYNTAX, i);
+
+            if (after_operand(last)) return fail(RP_ERR_MISSING_OPERATOR, i);
+            if (is_digit(c) || c == '.') {
+                double value = 0;
+                i = scan_number(s, i, value);
+                if (i < 0) return fail(RP_ERR_SYNTAX, start);
+                push(OPC_CONST, 0, value);
+            } else {
+                do {
+                    i++;
+                } while (continues_ident(s[i]));
+                int next = i;
+                while (is_space(s[next])) next++;
+                int function = s[next] == '(' ? find_function(s + start, i - start) : OPI_NOT_FOUND;
+                if (function != OPI_NOT_FOUND) {
+                    if (!shunt(function, start)) return false;
+                    last = function;
+                    continue;
+                }
+                push(OPC_VAR, name(start, i - start), 0);
+            }
+            if (continues_ident(s[i]) || s[i] == '.') return fail(RP_ERR_SYNTAX, i);
+            last = OPI_OPERAND;
+        }
+
+        while (nopstack > 0) {
+            if (!reduce_operator()) return false;
+        }
+        if (depth == 0) return fail(RP_ERR_EMPTY, i);
+        if (depth != 1) return fail(RP_ERR_MISSING_OPERATOR, i);
+        tree.root = operands[0];
+        return true;
+    }
+};
+
+/**
+ * @brief Parse an expression of fewer than N bytes; usable at run time too
+ *
+ * Every identifier is a variable, named in order of first use; the runtime
+ * parser would look each one up in its symbol table at that point.
+ */
+template <int N>
+constexpr syntax_tree<N> parse(const char *expression) {
+    parser<N> p;
+    p.s = expression;
+    p.run();
+    return p.tree;
+}
+
+// a failed assertion here names the status and position of the parse error
+template <rp_status Status, int Position>
+constexpr bool parsed() {
+    static_assert(Status == RP_OK, "rp::expr: malformed expression (see Status and Position)");
+    return true;
+}
+
+// exponents eval_power() expands, as fusable_exponent() in program.h
+constexpr bool fusable_exponent(double exponent) {
+    return exponent > 0 && exponent <= 16 && 2 * exponent == static_cast<int>(2 * exponent);
+}
+
+// -- constant folding: eval_opcode() of program.h in a constant expression
+
+constexpr double infinity = std::numeric_limits<double>::infinity();
+constexpr double not_a_number = std::numeric_limits<double>::quiet_NaN();
+constexpr long double overflow_threshold = 0x1.fffffffffffffcp1023L; // DBL_MAX plus half an ulp
+
+constexpr bool is_nan(double x) { return x != x; }
+constexpr bool is_inf(double x) { return x == infinity || x == -infinity; }
+
+/* + - * / rounded once, as at run time. Unless trapping math is off, a
+   constant expression may not raise an IEEE exception, so invalid operations
+   and division by zero get their results explicitly, and results past the
+   double range are rounded from long double, where they are finite */
+constexpr double arithmetic(int opcode, double a, double b) {
+    long double wide = 0;
+    switch (opcode) {
+        case OPC_ADD:
+            if (is_inf(a) && is_inf(b) && a != b) return not_a_number;
+            wide = static_cast<long double>(a) + b;
+            break;
+        case OPC_SUB:
+            if (is_inf(a) && is_inf(b) && a == b) return not_a_number;
+            wide = static_cast<long double>(a) - b;
+            break;
+        case OPC_MUL:
+            if ((is_inf(a) && b == 0) || (is_inf(b) && a == 0)) return not_a_number;
+            wide = static_cast<long double>(a) * b;
+            break;
+        default:
+            if ((a == 0 && b == 0) || (is_inf(a) && is_inf(b))) return not_a_number;
+            if (b == 0) return __builtin_signbit(a) == __builtin_signbit(b) ? infinity : -infinity;
+            wide = static_cast<long double>(a) / b;
+            break;
+    }
+    if (wide > overflow_threshold || wide < -overflow_threshold) return static_cast<double>(wide);
+    switch (opcode) {
+        case OPC_ADD: return a + b;
+        case OPC_SUB: return a - b;
+        case OPC_MUL: return a * b;
+    }
+    return a / b;
+}
+
+// pow(), with the cases that would raise an exception spelled out
+constexpr double power_of(double a, double b) {
+    if (a == 1 || b == 0) return 1;
+    if (is_nan(a) || is_nan(b)) return not_a_number;
+    bool integral = __builtin_trunc(b) == b;
+    bool odd = integral && !is_inf(b) && __builtin_fmod(b, 2.0) != 0;
+    if (a == 0) {
+        double magnitude = b < 0 ? infinity : 0.0;
+        return odd && __builtin_signbit(a) ? -magnitude : magnitude;
+    }
+    if (a < 0 && !integral) return not_a_number;
+    if (is_inf(a) || is_inf(b)) return __builtin_pow(a, b);
+    long double wide = __builtin_powl(a, b);
+    if (wide > overflow_threshold || wide < -overflow_threshold) return static_cast<double>(wide);
+    return rp::pow(a, b);
+}
+
+// eval_opcode(), folding with the kernels the interpreter calls
+constexpr double fold(int opcode, double a, double b) {
+    switch (opcode) {
+        case OPC_POW: return power_of(a, b);
+        case OPC_MIN: return rp::min(a, b);
+        case OPC_MAX: return rp::max(a, b);
+    }
+    if (is_nan(a) || is_nan(b)) return not_a_number;
+    switch (opcode) {
+        case OPC_NEG: return -a;
+        case OPC_MUL: case OPC_DIV: case OPC_ADD: case OPC_SUB: return arithmetic(opcode, a, b);
+        case OPC_MOD:
+            if (is_inf(a) || b == 0) return not_a_number;
+            return is_inf(b) ? static_cast<float>(a) : rp::mod(a, b);
+        case OPC_EXP: return a > 709.79 ? infinity : rp::exp(a); // exp overflows from 709.7827
+        case OPC_LOG: return rp::log(a);
+        case OPC_SQRT: return a < 0 ? not_a_number : is_inf(a) ? a : rp::sqrt(a);
+        case OPC_ABS: return rp::abs(a);
+        case OPC_TANH: return rp::tanh(a);
+    }
+    return not_a_number;
+}
+
+constexpr int arity(int opcode) {
+    switch (opcode) {
+        case OPC_CONST: case OPC_VAR: case OPC_MONOMIAL: return 0;
+        case OPC_NEG: case OPC_EXP: case OPC_LOG: case OPC_SQRT: case OPC_ABS: case OPC_TANH: return 1;
+        case OPC_MICHAELIS: return 3;
+        case OPC_HILL: return 4;
+        case OPC_REVERSIBLE_MM: return 6;
+    }
+    return 2;
+}
+
+/**
+ * @brief A parsed expression after the runtime compiler's passes, which
+ *        decide how it rounds
+ *
+ * lower() repeats on the tree what parser_compile_symbols() does to postfix:
+ *   - optimize_code(): constants folded, identities and double negation
+ *     removed, operands of + and * emitted deeper subtree first
+ *   - match_rate_laws(): written-out rate laws become kernels
+ *   - fuse_monomials(): products of variables, constants and their small
+ *     powers become monomials, multiplied left to right in emission order
+ * Kernels list their parameters and monomials their factors, each a node,
+ * in the operand list. A factor's half power is 2 unless it is a power.
+ */
+template <int N>
+struct program_tree {
+    static constexpr int CAPACITY = 2 * N; // simplifying adds at most one node per node (0-x becomes -x)
+    struct node {
+        int opcode = OPC_NONE;
+        int arg = 0; // name for OPC_VAR, half power for OPC_HILL
+        double value = 0; // OPC_CONST
+        int left = -1;
+        int right = -1;
+        int first = 0; // parameters or factors in the operand list
+        int count = 0;
+    };
+    node nodes[CAPACITY] = {};
+    int nnodes = 0;
+    int root = -1;
+    int operand[CAPACITY] = {};
+    int half_power[CAPACITY] = {};
+    int noperands = 0;
+    int need[CAPACITY] = {}; // stack depth each node takes, before rate laws and fusion
+
+    constexpr int add(int opcode, int arg, double value, int left, int right) {
+        nodes[nnodes] = { opcode, arg, value, left, right, 0, 0 };
+        return nnodes++;
+    }
+
+    constexpr bool is_const(int i, double value) const {
+        return nodes[i].opcode == OPC_CONST && nodes[i].value == value;
+    }
+
+    // simplify_node() of optimize.c
+    constexpr int simplify(int opcode, int left, int right) {
+        const node l = nodes[left];
+        if (l.opcode == OPC_CONST && (right < 0 || nodes[right].opcode == OPC_CONST)) {
+            return add(OPC_CONST, 0, fold(opcode, l.value, right < 0 ? 0 : nodes[right].value), -1, -1);
+        }
+        switch (opcode) {
+            case OPC_NEG:
+                if (l.opcode == OPC_NEG) return l.left;
+                break;
+            case OPC_ADD:
+                if (is_const(left, 0)) return right;
+                if (is_const(right, 0)) return left;
+                break;
+            case OPC_SUB:
+                if (is_const(right, 0)) return left;
+                if (is_const(left, 0)) return simplify(OPC_NEG, right, -1);
+                break;
+            case OPC_MUL:
+                if (is_const(left, 1)) return right;
+                if (is_const(right, 1)) return left;
+                if (is_const(left, -1)) return simplify(OPC_NEG, right, -1);
+                if (is_const(right, -1)) return simplify(OPC_NEG, left, -1);
+                break;
+            case OPC_DIV:
+                if (is_const(right, 1)) return left;
+                break;
+            case OPC_POW:
+                if (is_const(right, 1)) return left;
+                if (is_const(right, 0)) return add(OPC_CONST, 0, 1.0, -1, -1);
+                break;
+        }
+        return add(opcode, 0, 0, left, right);
+    }
+
+    // operand k of node i in emission order
+    constexpr int child(int i, int k) const {
+        const node &n = nodes[i];
+        if (n.count) return operand[n.first + k];
+        bool swap = (n.opcode == OPC_ADD || n.opcode == OPC_MUL) && need[n.right] > need[n.left];
+        return (k == 0) != swap ? n.left : n.right;
+    }
+
+    // whether two subexpressions emit identical code, same() of ratelaw.c
+    constexpr bool same(int a, int b) const {
+        const node &x = nodes[a], &y = nodes[b];
+        if (x.opcode != y.opcode || x.arg != y.arg) return false;
+        if (x.opcode == OPC_CONST) return std::bit_cast<std::uint64_t>(x.value) == std::bit_cast<std::uint64_t>(y.value);
+        for (int k = 0; k < arity(x.opcode); ++k) {
+            if (!same(child(a, k), child(b, k))) return false;
+        }
+        return true;
+    }
+
+    constexpr bool is_op(int i, int opcode) const { return nodes[i].opcode == opcode; }
+
+    // V*S^n/(K^n+S^n) over fraction = (numerator, denominator): fills V S K n
+    constexpr bool match_hill(int numerator, int denominator, int *params) const {
+        if (!is_op(numerator, OPC_MUL) || !is_op(denominator, OPC_ADD)) return false;
+        for (int x = 0; x < 2; ++x) {
+            int power = child(numerator, x);
+            if (!is_op(power, OPC_POW)) continue;
+            for (int y = 0; y < 2; ++y) {
+                int spower = child(denominator, y), kpower = child(denominator, 1 - y);
+                if (!is_op(spower, OPC_POW) || !is_op(kpower, OPC_POW)) continue;
+                if (!same(child(spower, 0), child(power, 0)) || !same(child(spower, 1), child(power, 1))
+                    || !same(child(kpower, 1), child(power, 1))) {
+                    continue;
+                }
+                params[0] = child(numerator, 1 - x);
+                params[1] = child(power, 0);
+                params[2] = child(kpower, 0);
+                params[3] = child(power, 1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // V*S/(K+S): fills V S K
+    constexpr bool match_michaelis(int numerator, int denominator, int *params) const {
+        if (!is_op(numerator, OPC_MUL) || !is_op(denominator, OPC_ADD)) return false;
+        for (int x = 0; x < 2; ++x) {
+            for (int y = 0; y < 2; ++y) {
+                if (!same(child(numerator, x), child(denominator, y))) continue;
+                params[0] = child(numerator, 1 - x);
+                params[1] = child(numerator, x);
+                params[2] = child(denominator, 1 - y);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // V*S/K given the node of S/K: fills V
+    constexpr bool match_scaled(int root, int ratio, int *v) const {
+        if (!is_op(root, OPC_DIV)) return false;
+        int product = child(root, 0);
+        if (!is_op(product, OPC_MUL) || !same(child(root, 1), child(ratio, 1))) return false;
+        for (int x = 0; x < 2; ++x) {
+            if (!same(child(product, x), child(ratio, 0))) continue;
+            *v = child(product, 1 - x);
+            return true;
+        }
+        return false;
+    }
+
+    // (Vf*S/Ks - Vr*P/Kp)/(1 + S/Ks + P/Kp): fills Vf S Ks Vr P Kp
+    constexpr bool match_reversible(int numerator, int denominator, int *params) const {
+        if (!is_op(numerator, OPC_SUB) || !is_op(denominator, OPC_ADD)) return false;
+        int x = is_op(child(denominator, 0), OPC_ADD) ? 0 : 1;
+        int inner = child(denominator, x), reverse = child(denominator, 1 - x);
+        if (!is_op(inner, OPC_ADD) || !is_op(reverse, OPC_DIV)) return false;
+        int y = is_op(child(inner, 0), OPC_CONST) ? 0 : 1;
+        int one = child(inner, y), forward = child(inner, 1 - y);
+        if (!is_op(one, OPC_CONST) || nodes[one].value != 1.0 || !is_op(forward, OPC_DIV)) return false;
+        if (!match_scaled(child(numerator, 0), forward, &params[0])
+            || !match_scaled(child(numerator, 1), reverse, &params[3])) {
+            return false;
+        }
+        params[1] = child(forward, 0);
+        params[2] = child(forward, 1);
+        params[4] = child(reverse, 0);
+        params[5] = child(reverse, 1);
+        return true;
+    }
+
+    // rewrite() of ratelaw.c: the division at i becomes a kernel if it is a rate law
+    constexpr void match_rate_law(int i) {
+        int numerator = child(i, 0), denominator = child(i, 1);
+        int params[6] = {};
+        int opcode = OPC_NONE, arg = 0;
+        if (match_hill(numerator, denominator, params)) {
+            opcode = OPC_HILL;
+            if (is_op(params[3], OPC_CONST) && fusable_exponent(nodes[params[3]].value)) {
+                arg = static_cast<int>(2 * nodes[params[3]].value);
+            }
+        } else if (match_michaelis(numerator, denominator, params)) {
+            opcode = OPC_MICHAELIS;
+        } else if (match_reversible(numerator, denominator, params)) {
+            opcode = OPC_REVERSIBLE_MM;
+        } else {
+            return;
+        }
+        node &n = nodes[i];
+        n = { opcode, arg, 0, -1, -1, noperands, arity(opcode) };
+        for (int k = 0; k < n.count; ++k) operand[noperands++] = params[k];
+    }
+
+    // the factors of the product at i, in emission order
+    constexpr void add_factors(int i) {
+        const node &n = nodes[i];
+        if (n.opcode == OPC_MUL) {
+            add_factors(child(i, 0));
+            add_factors(child(i, 1));
+        } else if (n.opcode == OPC_POW) {
+            operand[noperands] = n.left;
+            half_power[noperands++] = static_cast<int>(2 * nodes[n.right].value);
+        } else {
+            operand[noperands] = i;
+            half_power[noperands++] = 2;
+        }
+    }
+
+    constexpr void close(int i, const int *kind) {
+        if (kind[i] != PRODUCT) return;
+        int first = noperands;
+        add_factors(i);
+        nodes[i] = { OPC_MONOMIAL, 0, 0, -1, -1, first, noperands - first };
+    }
+
+    enum { OTHER = 0, VARIABLE, CONSTANT, PRODUCT };
+
+    // nodes still in the program: simplifying and rewriting leave some behind
+    constexpr void mark(int i, bool *live) const {
+        live[i] = true;
+        for (int k = 0; k < arity(nodes[i].opcode); ++k) mark(child(i, k), live);
+    }
+
+    // fuse_monomials(): kinds are settled children first, which node order guarantees
+    constexpr void fuse() {
+        bool live[CAPACITY] = {};
+        mark(root, live);
+        int kind[CAPACITY] = {};
+        for (int i = 0; i < nnodes; ++i) {
+            if (!live[i]) continue;
+            const node &n = nodes[i];
+            if (n.opcode == OPC_VAR) {
+                kind[i] = VARIABLE;
+            } else if (n.opcode == OPC_CONST) {
+                kind[i] = CONSTANT;
+            } else if (n.opcode == OPC_MUL && kind[n.left] != OTHER && kind[n.right] != OTHER) {
+                kind[i] = PRODUCT;
+            } else if (n.opcode == OPC_POW && kind[n.left] == VARIABLE && kind[n.right] == CONSTANT
+                       && fusable_exponent(nodes[n.right].value)) {
+                kind[i] = PRODUCT;
+            } else {
+                for (int k = 0; k < arity(n.opcode); ++k) close(child(i, k), kind);
+            }
+        }
+        close(root, kind);
+    }
+};
+
+/**
+ * @brief Compile a parsed expression the way parser_compile_symbols() does
+ */
+template <int N>
+constexpr program_tree<N> lower(const syntax_tree<N> &tree) {
+    program_tree<N> p;
+    if (tree.status != RP_OK) return p;
+
+    // rebuild bottom up, as optimize_code() does; operands precede their nodes
+    int map[N] = {};
+    for (int i = 0; i < tree.nnodes; ++i) {
+        const auto &n = tree.nodes[i];
+        if (n.opcode == OPC_CONST || n.opcode == OPC_VAR) {
+            map[i] = p.add(n.opcode, n.arg, n.value, -1, -1);
+        } else {
+            map[i] = p.simplify(n.opcode, map[n.left], n.right >= 0 ? map[n.right] : -1);
+        }
+    }
+    p.root = map[tree.root];
+
+    for (int i = 0; i < p.nnodes; ++i) {
+        const auto &n = p.nodes[i];
+        if (n.left < 0) {
+            p.need[i] = 1;
+        } else if (n.right < 0) {
+            p.need[i] = p.need[n.left];
+        } else {
+            int first = p.need[n.left], second = p.need[n.right];
+            if ((n.opcode == OPC_ADD || n.opcode == OPC_MUL) && second > first) {
+                first = p.need[n.right];
+                second = p.need[n.left];
+            }
+            p.need[i] = first > second ? first : second + 1;
+        }
+    }
+
+    // divisions are matched innermost first, as the runtime scans postfix
+    for (int i = 0; i < p.nnodes; ++i) {
+        if (p.nodes[i].opcode == OPC_DIV) p.match_rate_law(i);
+    }
+    p.fuse();
+    return p;
+}
+
+/**
+ * @brief Node I of a compiled tree as a type; eval() is the arithmetic of
+ *        its subtree, operands indexed by name
+ */
+template <const auto &Tree, int I>
+struct term {
+    static constexpr auto node = Tree.nodes[I];
+
+    template <class T, int J, class Values>
+    static T operand(const Values &v) {
+        return term<Tree, J>::template eval<T>(v);
+    }
+
+    // parameter or factor K of the node
+    template <class T, int K, class Values>
+    static T listed(const Values &v) {
+        return operand<T, Tree.operand[node.first + K]>(v);
+    }
+
+    template <class T, class Values>
+    static T eval(const Values &v) {
+        constexpr int op = node.opcode;
+        if constexpr (op == OPC_CONST) {
+            return T(node.value);
+        } else if constexpr (op == OPC_VAR) {
+            return v[node.arg];
+        } else if constexpr (op == OPC_MONOMIAL) {
+            // factors multiplied left to right, as eval_monomial() does
+            return [&]<int... K>(std::integer_sequence<int, K...>) {
+                T result(1.0);
+                ((result = result * power(listed<T, K>(v), Tree.half_power[node.first + K])), ...);
+                return result;
+            }(std::make_integer_sequence<int, node.count>{});
+        } else if constexpr (op == OPC_MICHAELIS) {
+            T s = listed<T, 1>(v);
+            return listed<T, 0>(v) * s / (listed<T, 2>(v) + s);
+        } else if constexpr (op == OPC_HILL) {
+            T s = listed<T, 1>(v), k = listed<T, 2>(v);
+            T sn, kn;
+            if constexpr (node.arg) {
+                sn = power(s, node.arg);
+                kn = power(k, node.arg);
+            } else {
+                T n = listed<T, 3>(v);
+                sn = rp::pow(s, n);
+                kn = rp::pow(k, n);
+            }
+            return listed<T, 0>(v) * sn / (kn + sn);
+        } else if constexpr (op == OPC_REVERSIBLE_MM) {
+            T s = listed<T, 1>(v), ks = listed<T, 2>(v), p = listed<T, 4>(v), kp = listed<T, 5>(v);
+            return (listed<T, 0>(v) * s / ks - listed<T, 3>(v) * p / kp) / (T(1.0) + s / ks + p / kp);
+        } else if constexpr (op == OPC_NEG) {
+            return -operand<T, node.left>(v);
+        } else if constexpr (op == OPC_POW) {
+            return rp::pow(operand<T, node.left>(v), operand<T, node.right>(v));
+        } else if constexpr (op == OPC_MUL) {
+            return operand<T, node.left>(v) * operand<T, node.right>(v);
+        } else if constexpr (op == OPC_DIV) {
+            return operand<T, node.left>(v) / operand<T, node.right>(v);
+        } else if constexpr (op == OPC_MOD) {
+            return rp::mod(operand<T, node.left>(v), operand<T, node.right>(v));
+        } else if constexpr (op == OPC_ADD) {
+            return operand<T, node.left>(v) + operand<T, node.right>(v);
+        } else if constexpr (op == OPC_SUB) {
+            return operand<T, node.left>(v) - operand<T, node.right>(v);
+        } else if constexpr (op == OPC_MIN) {
+            return rp::min(operand<T, node.left>(v), operand<T, node.right>(v));
+        } else if constexpr (op == OPC_MAX) {
+            return rp::max(operand<T, node.left>(v), operand<T, node.right>(v));
+        } else if constexpr (op == OPC_EXP) {
+            return rp::exp(operand<T, node.left>(v));
+        } else if constexpr (op == OPC_LOG) {
+            return rp::log(operand<T, node.left>(v));
+        } else if constexpr (op == OPC_SQRT) {
+            return rp::sqrt(operand<T, node.left>(v));
+        } else if constexpr (op == OPC_ABS) {
+            return rp::abs(operand<T, node.left>(v));
+        } else {
+            static_assert(op == OPC_TANH, "opcode the compiler does not emit");
+            return rp::tanh(operand<T, node.left>(v));
+        }
+    }
+};
+
+// operand k read from the variable slot bound to name k
+template <class T>
+struct slotted {
+    const T *vars;
+    const int *slots;
+    const T &operator[](int k) const { return vars[slots[k]]; }
+};
+
+} // namespace detail
+
+/**
+ * @brief An expression parsed at compile time
+ *
+ * The names are the expression's identifiers in order of first use.
+ * eval() takes their values in that order; an expr object constructed from
+ * a symbol table reads them from their slots instead, like a program
+ * compiled with parser_compile_symbols():
+ *
+ *     using rate = rp::expr<"k1*A*B - k2*C">; // names k1, A, B, k2, C
+ *     double v = rate::eval(values);
+ *     double w = rate(symbols)(vars);
+ */
+template <fixed_string S>
+class expr {
+public:
+    static constexpr detail::syntax_tree<S.capacity> tree = detail::parse<S.capacity>(S.chars);
+    static_assert(detail::parsed<tree.status, tree.position>());
+    static constexpr detail::program_tree<S.capacity> code = detail::lower(tree);
+
+    static constexpr int nvars = tree.nnames;
+    static constexpr std::array<std::string_view, nvars> names = [] {
+        std::array<std::string_view, nvars> r;
+        for (int k = 0; k < nvars; ++k) r[k] = std::string_view(S.chars + tree.name_start[k], tree.name_length[k]);
+        return r;
+    }();
+
+    /**
+     * @brief Evaluate on the values of the names, in order
+     */
+    template <class T>
+    static T eval(const T *values) {
+        return detail::term<code, code.root>::template eval<T>(values);
+    }
+
+    /**
+     * @brief Bind each name to its slot in a symbol table
+     * @throw rp::error with RP_ERR_UNKNOWN_IDENTIFIER at the first use of a
+     *        name the table does not have
+     */
+    explicit expr(const rp_symtab *symbols) {
+        for (int k = 0; k < nvars; ++k) {
+            slots_[k] = rp_symtab_find(symbols, std::string(names[k]).c_str());
+            if (slots_[k] < 0) {
+                rp_error e;
+                e.status = RP_ERR_UNKNOWN_IDENTIFIER;
+                e.position = tree.name_start[k];
+                e.expression = 0;
+                throw error(e);
+            }
+        }
+    }
+
+    /**
+     * @brief Evaluate on values of T indexed by slot, like rp_eval()
+     */
+    template <class T>
+    T operator()(const T *vars) const {
+        return detail::term<code, code.root>::template eval<T>(detail::slotted<T>{ vars, slots_.data() });
+    }
+
+    const std::array<int, nvars> &slots() const { return slots_; }
+
+private:
+    std::array<int, nvars> slots_{};
+};
+
+} // namespace rp
+
+#endif // REACTIONPARSER_EXPR_HPP
@@ -0,0 +1,73 @@
+/**
+ * @file arena.h
+ * @brief Bump allocator for scratch memory that is released all at once.
+ *
+ * Allocations are carved from malloc'ed blocks and never freed one by one;
+ * arena_reset() makes the memory reusable and arena_free() returns it. An
+ * arena that is never allocated from costs nothing, which keeps it off the
+ * common path of callers that only need it for unusually large inputs.
+ *
+ * @date 2025
+ */
+#ifndef REACTIONPARSER_ARENA_H
+#define REACTIONPARSER_ARENA_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#define ARENA_MIN_BLOCK 4096
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next; // older block
+    size_t capacity; // bytes in data
+    size_t used;
+    max_align_t data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head; // block allocations are served from, NULL while unused
+} Arena;
+
+/**
+ * @brief Allocate bytes aligned for any type
+ * @return the memory, or NULL if out of memory
+ */
+static inline void *arena_alloc(Arena *arena, size_t bytes) {
+    bytes = (bytes + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+    ArenaBlock *block = arena->head;
+    if (!block || block->capacity - block->used < bytes) {
+        size_t capacity = bytes > ARENA_MIN_BLOCK ? bytes : ARENA_MIN_BLOCK;
+        block = malloc(sizeof *block + capacity);
+        if (!block) return NULL;
+        block->next = arena->head;
+        block->capacity = capacity;
+        block->used = 0;
+        arena->head = block;
+    }
+    void *memory = (char *)block->data + block->used;
+    block->used += bytes;
+    return memory;
+}
+
+/**
+ * @brief Release everything but the newest block, which is kept for reuse
+ */
+static inline void arena_reset(Arena *arena) {
+    if (!arena->head) return;
+    for (ArenaBlock *block = arena->head->next, *next; block; block = next) {
+        next = block->next;
+        free(block);
+    }
+    arena->head->next = NULL;
+    arena->head->used = 0;
+}
+
+static inline void arena_free(Arena *arena) {
+    for (ArenaBlock *block = arena->head, *next; block; block = next) {
+        next = block->next;
+        free(block);
+    }
+    arena->head = NULL;
+}
+
+#endif // REACTIONPARSER_ARENA_H
@@ -0,0 +1,361 @@
+/**
+ * @file autodiff.c
+ * @brief Derivatives of compiled programs by automatic differentiation.
+ *
+ * Forward mode runs the program on dual numbers: every operand stack entry
+ * and temporary carries its value followed by its partial derivatives with
+ * respect to nd chosen variables. Each opcode's local partials come from
+ * eval_partials(), and the chain rule combines them with the operands'
+ * derivatives, so one pass yields the value and the whole gradient, exact to
+ * rounding.
+ *
+ * Reverse mode records the same local partials on a tape while evaluating
+ * forward, then sweeps the program backwards accumulating adjoints. The
+ * tape holds nothing but the partials, in instruction order: which stack
+ * entries they connect follows from the code, which is walked backwards
+ * with an adjoint stack mirroring the operand stack. The gradient with
+ * respect to every variable then costs a small constant multiple of one
+ * evaluation, however many variables there are. Tape and stacks are carved
+ * from an arena kept in the rp_tape, so repeated calls reuse the memory.
+ *
+ * Values are computed by the same eval functions the interpreter uses and
+ * agree with rp_eval() bit for bit.
+ *
+ * @date 2025
+ */
+
+
+// --- library import --- //
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "parser.h"
+#include "program.h"
+
+#define MAX_ARITY 6 // operands of the widest opcode, OPC_REVERSIBLE_MM
+#define DUAL_LOCAL 1024 // doubles of dual workspace kept on the C stack by rp_eval_gradient
+
+// d/dx x^(half_power / 2), using the powers eval_power() computes
+static inline double power_derivative(double x, int half_power) {
+    if (half_power == 1) return 0.5 / sqrt(x);
+    if (half_power == 2) return 1.0;
+    return 0.5 * half_power * eval_power(x, half_power - 2);
+}
+
+/**
+ * @brief Value of an evaluating opcode and its partial derivative with
+ *        respect to each operand
+ *
+ * Terms that are zero for the usual constant argument are kept zero where
+ * the formula would give 0 * inf or a logarithm of a non-positive number:
+ * d(a^b)/db at a <= 0, d(a^b)/da at b == 0.
+ *
+ * @param x the opcode_arity(opcode) operands
+ * @param partials receives one partial per operand
+ */
+static inline double eval_partials(int opcode, int arg, const double *x, double *partials) {
+    double value;
+    switch (opcode) {
+        case OPC_NEG:
+            partials[0] = -1.0;
+            return eval_uminus(x[0], 0);
+        case OPC_ADD:
+            partials[0] = partials[1] = 1.0;
+            return eval_add(x[0], x[1]);
+        case OPC_SUB:
+            partials[0] = 1.0;
+            partials[1] = -1.0;
+            return eval_subtract(x[0], x[1]);
+        case OPC_MUL:
+            partials[0] = x[1];
+            partials[1] = x[0];
+            return eval_multiply(x[0], x[1]);
+        case OPC_DIV:
+            value = eval_divide(x[0], x[1]);
+            partials[0] = 1.0 / x[1];
+            partials[1] = -value / x[1];
+            return value;
+        case OPC_MOD:
+            partials[0] = 1.0;
+            partials[1] = -trunc(x[0] / x[1]);
+            return eval_modulo(x[0], x[1]);
+        case OPC_POW:
+            value = eval_exponent(x[0], x[1]);
+            partials[0] = x[1] == 0 ? 0.0 : x[1] * eval_exponent(x[0], x[1] - 1);
+            partials[1] = x[0] > 0 ? value * log(x[0]) : 0.0;
+            return value;
+        case OPC_MIN:
+            value = eval_min(x[0], x[1]);
+            partials[0] = x[0] < x[1];
+            partials[1] = 1.0 - partials[0];
+            return value;
+        case OPC_MAX:
+            value = eval_max(x[0], x[1]);
+            partials[0] = x[0] > x[1];
+            partials[1] = 1.0 - partials[0];
+            return value;
+        case OPC_EXP:
+            value = eval_exp(x[0], 0);
+            partials[0] = value;
+            return value;
+        case OPC_LOG:
+            partials[0] = 1.0 / x[0];
+            return eval_log(x[0], 0);
+        case OPC_SQRT:
+            value = eval_sqrt(x[0], 0);
+            partials[0] = 0.5 / value;
+            return value;
+        case OPC_ABS:
+            partials[0] = x[0] < 0 ? -1.0 : 1.0;
+            return eval_abs(x[0], 0);
+        case OPC_TANH:
+            value = eval_tanh(x[0], 0);
+            partials[0] = 1.0 - value * value;
+            return value;
+        case OPC_MICHAELIS: {
+            // V S K
+            double sum = x[2] + x[1];
+            value = eval_michaelis(x[0], x[1], x[2]);
+            partials[0] = x[1] / sum;
+            partials[1] = x[0] * x[2] / (sum * sum);
+            partials[2] = -value / sum;
+            return value;
+        }
+        case OPC_HILL: {
+            // V S K n, through u = S^n and w = K^n
+            double u = arg ? eval_power(x[1], arg) : eval_exponent(x[1], x[3]);
+            double w = arg ? eval_power(x[2], arg) : eval_exponent(x[2], x[3]);
+            double sum = w + u;
+            value = eval_hill_powers(x[0], u, w);
+            double df_du = x[0] * w / (sum * sum), df_dw = -value / sum;
+            partials[0] = u / sum;
+            if (arg) {
+                partials[1] = df_du * power_derivative(x[1], arg);
+                partials[2] = df_dw * power_derivative(x[2], arg);
+                partials[3] = 0.0;
+            } else {
+                partials[1] = x[3] == 0 ? 0.0 : df_du * x[3] * eval_exponent(x[1], x[3] - 1);
+                partials[2] = x[3] == 0 ? 0.0 : df_dw * x[3] * eval_exponent(x[2], x[3] - 1);
+                partials[3] = (x[1] > 0 ? df_du * u * log(x[1]) : 0.0) + (x[2] > 0 ? df_dw * w * log(x[2]) : 0.0);
+            }
+            return value;
+        }
+        case OPC_REVERSIBLE_MM: {
+            // Vf S Ks Vr P Kp, through a = S/Ks and b = P/Kp
+            double a = x[1] / x[2], b = x[4] / x[5];
+            double denominator = 1 + a + b;
+            value = eval_reversible_mm(x[0], x[1], x[2], x[3], x[4], x[5]);
+            double df_da = (x[0] - value) / denominator, df_db = (-x[3] - value) / denominator;
+            partials[0] = a / denominator;
+            partials[1] = df_da / x[2];
+            partials[2] = -df_da * a / x[2];
+            partials[3] = -b / denominator;
+            partials[4] = df_db / x[5];
+            partials[5] = -df_db * b / x[5];
+            return value;
+        }
+    }
+    return NAN;
+}
+
+void eval_dual(const rp_program *program, const double *vars, const int *seed, int nd,
+               double *work, double *values, double *gradients) {
+    const int width = 1 + nd;
+    double *stack = work; // maxdepth entries of width doubles
+    double *temps = work + program->maxdepth * width; // then ntemps entries
+    int n = 0;
+
+    for (int i = 0; i < program->ncode; ++i) {
+        const Instruction *in = &program->code[i];
+        double *top = stack + n * width;
+        switch (in->opcode) {
+            case OPC_CONST:
+                top[0] = program->consts[in->arg];
+                memset(top + 1, 0, nd * sizeof *top);
+                n++;
+                continue;
+            case OPC_VAR:
+                top[0] = vars[in->arg];
+                memset(top + 1, 0, nd * sizeof *top);
+                if (seed[in->arg] >= 0) top[1 + seed[in->arg]] = 1.0;
+                n++;
+                continue;
+            case OPC_LOAD:
+                memcpy(top, temps + in->arg * width, width * sizeof *top);
+                n++;
+                continue;
+            case OPC_STORE:
+                memcpy(temps + in->arg * width, top - width, width * sizeof *top);
+                continue;
+            case OPC_OUTPUT:
+                n--;
+                values[in->arg] = top[-width];
+                memcpy(gradients + in->arg * nd, top - width + 1, nd * sizeof *top);
+                continue;
+            case OPC_MONOMIAL: {
+                // product rule one factor at a time
+                const Monomial *term = &program->monomials.terms[in->arg];
+                const Factor *factors = program->monomials.factors + term->first;
+                top[0] = 1.0;
+                memset(top + 1, 0, nd * sizeof *top);
+                for (int k = 0; k < term->nfactors; ++k) {
+                    int operand = factors[k].operand;
+                    double x = operand >= 0 ? vars[operand] : program->consts[~operand];
+                    double power = eval_power(x, factors[k].half_power);
+                    for (int d = 1; d <= nd; ++d) top[d] *= power;
+                    if (operand >= 0 && seed[operand] >= 0) {
+                        top[1 + seed[operand]] += top[0] * power_derivative(x, factors[k].half_power);
+                    }
+                    top[0] *= power;
+                }
+                n++;
+                continue;
+            }
+        }
+
+        int arity = opcode_arity(in->opcode);
+        double *first = top - arity * width;
+        double x[MAX_ARITY], partials[MAX_ARITY];
+        for (int k = 0; k < arity; ++k) x[k] = first[k * width];
+        first[0] = eval_partials(in->opcode, in->arg, x, partials);
+        for (int d = 1; d <= nd; ++d) {
+            double sum = partials[0] * first[d];
+            for (int k = 1; k < arity; ++k) sum += partials[k] * first[k * width + d];
+            first[d] = sum;
+        }
+        n -= arity - 1;
+    }
+    if (program->noutputs == 1) {
+        values[0] = stack[0];
+        memcpy(gradients, stack + 1, nd * sizeof *stack);
+    }
+}
+
+double rp_eval_gradient(const rp_program *program, const double *vars, const int *slots, int nslots,
+                        double *gradient) {
+    double local[DUAL_LOCAL];
+    int seed_local[64];
+    size_t need = (size_t)(1 + nslots) * (program->maxdepth + program->ntemps);
+    double *work = need > DUAL_LOCAL ? malloc(need * sizeof *work) : local;
+    int *seed = program->nvars > 64 ? malloc(program->nvars * sizeof *seed) : seed_local;
+    double value = NAN;
+    if (work && seed && program->noutputs == 1) {
+        // slots the program never reads are never seeded and get zero derivatives
+        for (int v = 0; v < program->nvars; ++v) seed[v] = -1;
+        for (int k = 0; k < nslots; ++k) {
+            if (slots[k] >= 0 && slots[k] < program->nvars) seed[slots[k]] = k;
+        }
+        eval_dual(program, vars, seed, nslots, work, &value, gradient);
+    } else {
+        for (int k = 0; k < nslots; ++k) gradient[k] = NAN;
+    }
+    if (work != local) free(work);
+    if (seed != seed_local) free(seed);
+    return value;
+}
+
+struct rp_tape {
+    Arena arena;
+};
+
+rp_tape *rp_tape_create(void) {
+    return calloc(1, sizeof(rp_tape));
+}
+
+void rp_tape_free(rp_tape *tape) {
+    if (!tape) return;
+    arena_free(&tape->arena);
+    free(tape);
+}
+
+double rp_eval_adjoint(rp_tape *tape, const rp_program *program, const double *vars, int nslots,
+                       double *gradient) {
+    memset(gradient, 0, nslots * sizeof *gradient);
+    if (program->noutputs != 1) return NAN;
+
+    // at most MAX_ARITY partials per instruction, plus one per monomial factor
+    size_t tape_len = (size_t)MAX_ARITY * program->ncode + program->monomials.nfactors;
+    arena_reset(&tape->arena);
+    double *stack = arena_alloc(&tape->arena, (program->maxdepth + 2 * program->ntemps + tape_len) * sizeof *stack);
+    if (!stack) {
+        for (int k = 0; k < nslots; ++k) gradient[k] = NAN;
+        return NAN;
+    }
+    double *temps = stack + program->maxdepth;
+    double *temp_adjoints = temps + program->ntemps;
+    double *partials = temp_adjoints + program->ntemps;
+    const Instruction *code = program->code;
+    const Factor *all_factors = program->monomials.factors;
+
+    // forward: evaluate, recording each instruction's partials
+    double *t = partials;
+    int n = 0;
+    for (int i = 0; i < program->ncode; ++i) {
+        switch (code[i].opcode) {
+            case OPC_CONST: stack[n++] = program->consts[code[i].arg]; continue;
+            case OPC_VAR: stack[n++] = vars[code[i].arg]; continue;
+            case OPC_LOAD: stack[n++] = temps[code[i].arg]; continue;
+            case OPC_STORE: temps[code[i].arg] = stack[n-1]; continue;
+            case OPC_MONOMIAL: {
+                // t[k] = product of the factors before k times the derivative of factor k
+                const Monomial *term = &program->monomials.terms[code[i].arg];
+                const Factor *factors = all_factors + term->first;
+                double product = 1.0;
+                for (int k = 0; k < term->nfactors; ++k) {
+                    int operand = factors[k].operand;
+                    double x = operand >= 0 ? vars[operand] : program->consts[~operand];
+                    t[k] = product * power_derivative(x, factors[k].half_power);
+                    product *= eval_power(x, factors[k].half_power);
+                }
+                t += term->nfactors;
+                stack[n++] = product;
+                continue;
+            }
+        }
+        int arity = opcode_arity(code[i].opcode);
+        double value = eval_partials(code[i].opcode, code[i].arg, stack + n - arity, t);
+        t += arity;
+        n -= arity - 1;
+        stack[n-1] = value;
+    }
+    double value = stack[0];
+
+    // reverse: the adjoint stack reuses the operand stack
+    for (int k = 0; k < program->ntemps; ++k) temp_adjoints[k] = 0.0;
+    double *adjoint = stack;
+    adjoint[0] = 1.0;
+    n = 1;
+    for (int i = program->ncode - 1; i >= 0; --i) {
+        int arg = code[i].arg;
+        switch (code[i].opcode) {
+            case OPC_CONST: n--; continue;
+            case OPC_VAR:
+                n--;
+                if (arg < nslots) gradient[arg] += adjoint[n];
+                continue;
+            case OPC_LOAD: n--; temp_adjoints[arg] += adjoint[n]; continue;
+            case OPC_STORE: adjoint[n-1] += temp_adjoints[arg]; continue;
+            case OPC_MONOMIAL: {
+                // complete each factor's partial with the product of the factors after it
+                const Monomial *term = &program->monomials.terms[arg];
+                const Factor *factors = all_factors + term->first;
+                double a = adjoint[--n], after = 1.0;
+                t -= term->nfactors;
+                for (int k = term->nfactors - 1; k >= 0; --k) {
+                    int operand = factors[k].operand;
+                    double x = operand >= 0 ? vars[operand] : program->consts[~operand];
+                    if (operand >= 0 && operand < nslots) gradient[operand] += a * t[k] * after;
+                    after *= eval_power(x, factors[k].half_power);
+                }
+                continue;
+            }
+        }
+        int arity = opcode_arity(code[i].opcode);
+        double a = adjoint[n-1];
+        t -= arity;
+        for (int k = 0; k < arity; ++k) adjoint[n-1+k] = a * t[k];
+        n += arity - 1;
+    }
+    return value;
+}
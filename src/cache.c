@@ -0,0 +1,221 @@
+/**
+ * @file cache.c
+ * @brief LRU cache of compiled programs keyed by expression text.
+ *
+ * Entries are found through a chained hash table on a 64-bit hash of the
+ * expression bytes and kept on a doubly linked list in order of use. An
+ * expression without variables is evaluated once when it is compiled and
+ * only its value is kept. When the entries' memory exceeds the cap, the
+ * least recently used ones are evicted. Failed compilations are not cached.
+ *
+ * @date 2025
+ */
+
+
+// --- library import --- //
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "program.h"
+
+#define CACHE_MIN_BUCKETS 64
+
+typedef struct CacheEntry {
+    struct CacheEntry *next; // next entry in the same bucket
+    struct CacheEntry *newer; // LRU list, most recent at the head
+    struct CacheEntry *older;
+    uint64_t hash;
+    size_t bytes; // memory charged to this entry
+    rp_program *program; // NULL for constant expressions
+    double value; // result of a constant expression
+    size_t len;
+    char text[]; // the expression, NUL-terminated
+} CacheEntry;
+
+struct rp_cache {
+    const rp_symtab *symbols;
+    CacheEntry **buckets;
+    size_t nbuckets; // power of two
+    CacheEntry *newest;
+    CacheEntry *oldest;
+    rp_cache_stats stats;
+};
+
+/* 8 bytes per step, multiply-xorshift mixing */
+static inline uint64_t hash_bytes(const char *s, size_t len) {
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h = len * k;
+    for (; len >= 8; s += 8, len -= 8) {
+        uint64_t word;
+        memcpy(&word, s, sizeof word);
+        h = (h ^ word * k) * 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 31;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, s, len);
+    h = (h ^ tail * k) * 0x94D049BB133111EBull;
+    return h ^ h >> 29;
+}
+
+static size_t program_bytes(const rp_program *program) {
+    if (!program) return 0;
+    // threaded code: one handler and one offset per instruction, plus the halt
+    size_t threaded = program->threaded
+        ? (program->ncode + 1) * (sizeof *program->threaded + sizeof *program->thread_start) : 0;
+    return sizeof *program + program->ncode * sizeof *program->code
+        + program->nconsts * sizeof *program->consts
+        + program->monomials.nterms * sizeof *program->monomials.terms
+        + program->monomials.nfactors * sizeof *program->monomials.factors + threaded;
+}
+
+static void unlink_lru(rp_cache *cache, CacheEntry *entry) {
+    if (entry->newer) entry->newer->older = entry->older;
+    else cache->newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer;
+    else cache->oldest = entry->newer;
+}
+
+static void push_lru(rp_cache *cache, CacheEntry *entry) {
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest) cache->newest->newer = entry;
+    else cache->oldest = entry;
+    cache->newest = entry;
+}
+
+static void remove_entry(rp_cache *cache, CacheEntry *entry) {
+    CacheEntry **link = &cache->buckets[entry->hash & (cache->nbuckets - 1)];
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+    unlink_lru(cache, entry);
+    cache->stats.entries--;
+    cache->stats.bytes -= entry->bytes;
+    rp_program_free(entry->program);
+    free(entry);
+}
+
+static int grow_buckets(rp_cache *cache) {
+    size_t nbuckets = 2 * cache->nbuckets;
+    CacheEntry **buckets = calloc(nbuckets, sizeof *buckets);
+    if (!buckets) return EXIT_FAILURE;
+    for (size_t b = 0; b < cache->nbuckets; ++b) {
+        for (CacheEntry *entry = cache->buckets[b], *next; entry; entry = next) {
+            next = entry->next;
+            CacheEntry **head = &buckets[entry->hash & (nbuckets - 1)];
+            entry->next = *head;
+            *head = entry;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->nbuckets = nbuckets;
+    return 0;
+}
+
+rp_cache *rp_cache_create(const rp_symtab *symbols, size_t max_bytes) {
+    rp_cache *cache = calloc(1, sizeof *cache);
+    if (!cache) return NULL;
+    cache->buckets = calloc(CACHE_MIN_BUCKETS, sizeof *cache->buckets);
+    if (!cache->buckets) {
+        free(cache);
+        return NULL;
+    }
+    cache->nbuckets = CACHE_MIN_BUCKETS;
+    cache->symbols = symbols;
+    cache->stats.max_bytes = max_bytes;
+    return cache;
+}
+
+/**
+ * @brief Compile expression and add it as the most recent entry
+ * @return the new entry, NULL on error (reported through error, never NULL)
+ */
+static CacheEntry *insert(rp_cache *cache, const char *expression, size_t len, uint64_t hash,
+                          rp_error *error) {
+    rp_program *program = parser_compile_symbols(expression, cache->symbols, error);
+    if (!program) return NULL;
+
+    CacheEntry *entry = malloc(sizeof *entry + len + 1);
+    if (!entry || (cache->stats.entries >= cache->nbuckets && grow_buckets(cache))) {
+        free(entry);
+        rp_program_free(program);
+        error->status = RP_ERR_NO_MEMORY;
+        error->position = 0;
+        return NULL;
+    }
+    entry->hash = hash;
+    entry->len = len;
+    memcpy(entry->text, expression, len + 1);
+    entry->program = program;
+    entry->value = 0;
+    if (program->nvars == 0) {
+        // nothing to bind: keep the value, not the program
+        entry->value = rp_eval(program, NULL);
+        rp_program_free(program);
+        entry->program = NULL;
+    }
+    entry->bytes = sizeof *entry + len + 1 + program_bytes(entry->program);
+
+    CacheEntry **head = &cache->buckets[hash & (cache->nbuckets - 1)];
+    entry->next = *head;
+    *head = entry;
+    push_lru(cache, entry);
+    cache->stats.entries++;
+    cache->stats.bytes += entry->bytes;
+
+    // evict from the cold end, never the entry just added
+    while (cache->stats.bytes > cache->stats.max_bytes && cache->oldest != entry) {
+        remove_entry(cache, cache->oldest);
+        cache->stats.evictions++;
+    }
+    return entry;
+}
+
+rp_status rp_cache_eval(rp_cache *cache, const char *expression, const double *vars,
+                        double *result, rp_error *error) {
+    rp_error local;
+    if (!error) error = &local;
+    size_t len = strlen(expression);
+    uint64_t hash = hash_bytes(expression, len);
+
+    CacheEntry *entry = cache->buckets[hash & (cache->nbuckets - 1)];
+    while (entry && (entry->hash != hash || entry->len != len || memcmp(entry->text, expression, len) != 0)) {
+        entry = entry->next;
+    }
+    if (entry) {
+        cache->stats.hits++;
+        if (entry != cache->newest) {
+            unlink_lru(cache, entry);
+            push_lru(cache, entry);
+        }
+        error->status = RP_OK;
+        error->position = 0;
+        error->expression = 0;
+    } else {
+        cache->stats.misses++;
+        entry = insert(cache, expression, len, hash, error);
+        if (!entry) {
+            *result = NAN;
+            return error->status;
+        }
+    }
+    *result = entry->program ? rp_eval(entry->program, vars) : entry->value;
+    return RP_OK;
+}
+
+void rp_cache_statistics(const rp_cache *cache, rp_cache_stats *stats) {
+    *stats = cache->stats;
+}
+
+void rp_cache_clear(rp_cache *cache) {
+    while (cache->oldest) remove_entry(cache, cache->oldest);
+}
+
+void rp_cache_free(rp_cache *cache) {
+    if (!cache) return;
+    rp_cache_clear(cache);
+    free(cache->buckets);
+    free(cache);
+}
@@ -0,0 +1,400 @@
+/**
+ * @file codegen.c
+ * @brief C source generation for compiled programs, built with the system
+ *        compiler and loaded with dlopen().
+ *
+ * The hand-written JIT in jit.c keeps the operand stack in 16 registers and
+ * optimizes nothing across instructions. For the largest models a program can
+ * instead be written out as one C translation unit of straight-line code:
+ *   - void name(const double *vars, double *out), writing every output
+ *   - for single expressions also double name_scalar(const double *vars) and
+ *     a batch kernel name_batch(columns, start, end, out) over rows
+ *
+ * Stack depth d becomes the local s<d> and temporary k the local t<k>, so
+ * the compiler sees the whole dataflow and allocates registers, schedules
+ * and vectorizes the batch loop itself. Every operation calls an inline
+ * eval function with the arithmetic of the one in program.h the interpreter
+ * calls, in the interpreter's order, and constants are printed as hexadecimal floats,
+ * which round-trip exactly. The code is built without -ffast-math and
+ * without contraction into fused multiply-adds, so nothing is reassociated
+ * across instructions; results agree with rp_eval() to the last bit except
+ * where the library's own -Ofast build rewrites a kernel's divisions into
+ * reciprocals.
+ *
+ * The source is a standalone translation unit: the helpers it calls are
+ * written out ahead of the model code, so it needs only libm and builds
+ * wherever the library is installed.
+ *
+ * rp_native_compile() runs the compiler with -O3 -march=native into a
+ * temporary directory and loads the shared object. Without a working
+ * compiler it returns NULL and the program stays on the JIT or interpreter.
+ *
+ * @date 2025
+ */
+
+
+// --- library import --- //
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "parser.h"
+#include "program.h"
+
+extern char **environ;
+
+// constants:
+#define NATIVE_NAME "rp_model" // entry point of the shared objects rp_native_compile() builds
+
+// where an evaluation reads its variables
+typedef enum {
+    READ_VARS, // vars[slot]
+    READ_COLUMNS, // v<slot>[r], the column hoisted out of the row loop
+} VarAccess;
+
+/* the eval functions of program.h and the kernels of vecmath.h that generated
+   code calls, copied here so the source depends on no header of the library;
+   keep them in step with the originals, which assert_native() in the tests
+   compares against */
+static const char helpers[] =
+    "#include <math.h>\n"
+    "#include <stddef.h>\n"
+    "#include <stdint.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "static inline uint64_t vm_bits(double x) { uint64_t b; memcpy(&b, &x, sizeof b); return b; }\n"
+    "static inline double vm_double(uint64_t b) { double x; memcpy(&x, &b, sizeof x); return x; }\n"
+    "static inline double vm_pow2(double n) {\n"
+    "    const double shift = 0x1.8p52;\n"
+    "    return vm_double((vm_bits(n + shift) - vm_bits(shift) + 1023) << 52);\n"
+    "}\n"
+    "static inline double vm_expm1_reduced(double x, double *n) {\n"
+    "    *n = rint(x * 1.4426950408889634);\n"
+    "    double r = fma(-*n, 0x1.62e42fefa3800p-1, x);\n"
+    "    r = fma(-*n, 0x1.ef35793c76730p-45, r);\n"
+    "    double p = 1.0 / 6227020800.0;\n"
+    "    p = fma(p, r, 1.0 / 479001600.0);\n"
+    "    p = fma(p, r, 1.0 / 39916800.0);\n"
+    "    p = fma(p, r, 1.0 / 3628800.0);\n"
+    "    p = fma(p, r, 1.0 / 362880.0);\n"
+    "    p = fma(p, r, 1.0 / 40320.0);\n"
+    "    p = fma(p, r, 1.0 / 5040.0);\n"
+    "    p = fma(p, r, 1.0 / 720.0);\n"
+    "    p = fma(p, r, 1.0 / 120.0);\n"
+    "    p = fma(p, r, 1.0 / 24.0);\n"
+    "    p = fma(p, r, 1.0 / 6.0);\n"
+    "    p = fma(p, r, 0.5);\n"
+    "    return fma(p, r * r, r);\n"
+    "}\n"
+    "static inline double vm_exp(double x) {\n"
+    "    x = x < -746.0 ? -746.0 : x;\n"
+    "    x = x > 710.0 ? 710.0 : x;\n"
+    "    double n;\n"
+    "    double q = vm_expm1_reduced(x, &n);\n"
+    "    double half = floor(0.5 * n);\n"
+    "    return (1.0 + q) * vm_pow2(half) * vm_pow2(n - half);\n"
+    "}\n"
+    "static inline double vm_log(double x) {\n"
+    "    uint64_t bits = vm_bits(x);\n"
+    "    double e = vm_double(0x4330000000000000ull | bits >> 52) - 0x1p52 - 1023.0;\n"
+    "    double m = vm_double((bits & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull);\n"
+    "    e = m > 1.4142135623730951 ? e + 1.0 : e;\n"
+    "    m = m > 1.4142135623730951 ? 0.5 * m : m;\n"
+    "    double f = m - 1.0;\n"
+    "    double s = f / (2.0 + f);\n"
+    "    double z = s * s;\n"
+    "    double p = 2.0 / 21;\n"
+    "    p = fma(p, z, 2.0 / 19);\n"
+    "    p = fma(p, z, 2.0 / 17);\n"
+    "    p = fma(p, z, 2.0 / 15);\n"
+    "    p = fma(p, z, 2.0 / 13);\n"
+    "    p = fma(p, z, 2.0 / 11);\n"
+    "    p = fma(p, z, 2.0 / 9);\n"
+    "    p = fma(p, z, 2.0 / 7);\n"
+    "    p = fma(p, z, 2.0 / 5);\n"
+    "    p = fma(p, z, 2.0 / 3);\n"
+    "    double log_m = fma(p * z, s, 2.0 * s);\n"
+    "    double result = fma(e, 0x1.62e42fefa3800p-1, fma(e, 0x1.ef35793c76730p-45, log_m));\n"
+    "    result = x == 0.0 ? -HUGE_VAL : result;\n"
+    "    return x < 0.0 ? NAN : result;\n"
+    "}\n"
+    "static inline double vm_tanh(double x) {\n"
+    "    double a = fabs(x);\n"
+    "    a = a > 40.0 ? 40.0 : a;\n"
+    "    double n;\n"
+    "    double q = vm_expm1_reduced(-2.0 * a, &n);\n"
+    "    double scale = vm_pow2(n);\n"
+    "    double t = fma(scale, q, scale - 1.0);\n"
+    "    return copysign(-t / (t + 2.0), x);\n"
+    "}\n"
+    "\n"
+    "static inline double eval_uminus(double a, double b) { return -a; }\n"
+    "static inline double eval_exponent(double a, double b) { return pow(a, b); }\n"
+    "static inline double eval_multiply(double a, double b) { return a * b; }\n"
+    "static inline double eval_divide(double a, double b) { return a / b; }\n"
+    "static inline double eval_add(double a, double b) { return a + b; }\n"
+    "static inline double eval_subtract(double a, double b) { return a - b; }\n"
+    "static inline double eval_modulo(double a, double b) { return fmodf(a, b); }\n"
+    "static inline double eval_min(double a, double b) { return a < b ? a : b; }\n"
+    "static inline double eval_max(double a, double b) { return a > b ? a : b; }\n"
+    "static inline double eval_exp(double a, double b) { return vm_exp(a); }\n"
+    "static inline double eval_log(double a, double b) { return vm_log(a); }\n"
+    "static inline double eval_sqrt(double a, double b) { return sqrt(a); }\n"
+    "static inline double eval_abs(double a, double b) { return fabs(a); }\n"
+    "static inline double eval_tanh(double a, double b) { return vm_tanh(a); }\n"
+    "static inline double eval_power(double x, int half_power) {\n"
+    "    double result = half_power & 1 ? sqrt(x) : 1.0;\n"
+    "    double base = x;\n"
+    "    for (int p = half_power >> 1; p; p >>= 1) {\n"
+    "        if (p & 1) result *= base;\n"
+    "        base *= base;\n"
+    "    }\n"
+    "    return result;\n"
+    "}\n"
+    "static inline double eval_michaelis(double v, double s, double k) { return v * s / (k + s); }\n"
+    "static inline double eval_hill(double v, double s, double k, double n, int half_power) {\n"
+    "    double sn = half_power ? eval_power(s, half_power) : eval_exponent(s, n);\n"
+    "    double kn = half_power ? eval_power(k, half_power) : eval_exponent(k, n);\n"
+    "    return v * sn / (kn + sn);\n"
+    "}\n"
+    "static inline double eval_reversible_mm(double vf, double s, double ks, double vr, double p, double kp) {\n"
+    "    return (vf * s / ks - vr * p / kp) / (1 + s / ks + p / kp);\n"
+    "}\n";
+
+static const char *const eval_names[] = {
+    [OPC_NEG] = "eval_uminus",
+    [OPC_POW] = "eval_exponent",
+    [OPC_MUL] = "eval_multiply",
+    [OPC_DIV] = "eval_divide",
+    [OPC_MOD] = "eval_modulo",
+    [OPC_ADD] = "eval_add",
+    [OPC_SUB] = "eval_subtract",
+    [OPC_MIN] = "eval_min",
+    [OPC_MAX] = "eval_max",
+    [OPC_EXP] = "eval_exp",
+    [OPC_LOG] = "eval_log",
+    [OPC_SQRT] = "eval_sqrt",
+    [OPC_ABS] = "eval_abs",
+    [OPC_TANH] = "eval_tanh",
+};
+
+/* a double as a C expression with exactly its value; the exponent bits are
+   tested directly since isinf() and isnan() fold to 0 under -ffast-math */
+static void put_double(FILE *out, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof bits);
+    if ((bits >> 52 & 0x7FF) != 0x7FF) fprintf(out, "%a", value);
+    else if (bits << 12) fputs("NAN", out);
+    else fputs(bits >> 63 ? "-INFINITY" : "INFINITY", out);
+}
+
+static void put_var(FILE *out, VarAccess access, int slot) {
+    fprintf(out, access == READ_VARS ? "vars[%d]" : "v%d[r]", slot);
+}
+
+// the monomial's factors multiplied left to right, as eval_monomial() does
+static void put_monomial(FILE *out, const rp_program *program, int index, int d, VarAccess access,
+                         const char *indent) {
+    const Monomial *term = &program->monomials.terms[index];
+    const Factor *factors = program->monomials.factors + term->first;
+    fprintf(out, "%ss%d = 1.0;\n", indent, d);
+    for (int k = 0; k < term->nfactors; ++k) {
+        fprintf(out, "%ss%d *= eval_power(", indent, d);
+        if (factors[k].operand >= 0) put_var(out, access, factors[k].operand);
+        else put_double(out, program->consts[~factors[k].operand]);
+        fprintf(out, ", %d);\n", factors[k].half_power);
+    }
+}
+
+/**
+ * @brief Write the statements evaluating a program; the result of a single
+ *        expression is left in s0
+ */
+static void put_body(FILE *out, const rp_program *program, VarAccess access, const char *indent) {
+    if (program->maxdepth > 0) {
+        fprintf(out, "%sdouble s0", indent);
+        for (int d = 1; d < program->maxdepth; ++d) fprintf(out, ", s%d", d);
+        fputs(";\n", out);
+    }
+    if (program->ntemps > 0) {
+        fprintf(out, "%sdouble t0", indent);
+        for (int k = 1; k < program->ntemps; ++k) fprintf(out, ", t%d", k);
+        fputs(";\n", out);
+    }
+
+    int n = 0;
+    for (int i = 0; i < program->ncode; ++i) {
+        const Instruction *ins = &program->code[i];
+        switch (ins->opcode) {
+            case OPC_CONST:
+                fprintf(out, "%ss%d = ", indent, n++);
+                put_double(out, program->consts[ins->arg]);
+                fputs(";\n", out);
+                break;
+            case OPC_VAR:
+                fprintf(out, "%ss%d = ", indent, n++);
+                put_var(out, access, ins->arg);
+                fputs(";\n", out);
+                break;
+            case OPC_MONOMIAL:
+                put_monomial(out, program, ins->arg, n++, access, indent);
+                break;
+            case OPC_MICHAELIS:
+                n -= 2;
+                fprintf(out, "%ss%d = eval_michaelis(s%d, s%d, s%d);\n", indent, n-1, n-1, n, n+1);
+                break;
+            case OPC_HILL:
+                n -= 3;
+                fprintf(out, "%ss%d = eval_hill(s%d, s%d, s%d, s%d, %d);\n",
+                        indent, n-1, n-1, n, n+1, n+2, ins->arg);
+                break;
+            case OPC_REVERSIBLE_MM:
+                n -= 5;
+                fprintf(out, "%ss%d = eval_reversible_mm(s%d, s%d, s%d, s%d, s%d, s%d);\n",
+                        indent, n-1, n-1, n, n+1, n+2, n+3, n+4);
+                break;
+            case OPC_STORE: fprintf(out, "%st%d = s%d;\n", indent, ins->arg, n-1); break;
+            case OPC_LOAD: fprintf(out, "%ss%d = t%d;\n", indent, n++, ins->arg); break;
+            case OPC_OUTPUT: fprintf(out, "%sout[%d] = s%d;\n", indent, ins->arg, --n); break;
+            default:
+                if (opcode_arity(ins->opcode) == 1) {
+                    fprintf(out, "%ss%d = %s(s%d, 0);\n", indent, n-1, eval_names[ins->opcode], n-1);
+                } else {
+                    n--;
+                    fprintf(out, "%ss%d = %s(s%d, s%d);\n", indent, n-1, eval_names[ins->opcode], n-1, n);
+                }
+                break;
+        }
+    }
+}
+
+// the batch kernel reads only the columns of slots the program uses
+static void put_columns(FILE *out, const rp_program *program) {
+    char *used = calloc(program->nvars > 0 ? program->nvars : 1, 1);
+    if (!used) return;
+    for (int i = 0; i < program->ncode; ++i) {
+        if (program->code[i].opcode == OPC_VAR) used[program->code[i].arg] = 1;
+    }
+    for (int k = 0; k < program->monomials.nfactors; ++k) {
+        if (program->monomials.factors[k].operand >= 0) used[program->monomials.factors[k].operand] = 1;
+    }
+    for (int slot = 0; slot < program->nvars; ++slot) {
+        if (used[slot]) fprintf(out, "    const double *restrict v%d = columns[%d];\n", slot, slot);
+    }
+    free(used);
+}
+
+int rp_native_source(const rp_program *program, const char *name, FILE *out) {
+    fputs("/* generated by ReactionParser; standalone, link with -lm */\n", out);
+    fputs(helpers, out);
+    fputc('\n', out);
+
+    fprintf(out, "void %s(const double *restrict vars, double *restrict out) {\n", name);
+    put_body(out, program, READ_VARS, "    ");
+    if (program->noutputs == 1) fputs("    out[0] = s0;\n", out);
+    fputs("}\n", out);
+
+    if (program->noutputs == 1) {
+        fprintf(out, "\ndouble %s_scalar(const double *restrict vars) {\n"
+                     "    double out;\n"
+                     "    %s(vars, &out);\n"
+                     "    return out;\n"
+                     "}\n", name, name);
+
+        fprintf(out, "\nvoid %s_batch(const double *const *columns, size_t start, size_t end,"
+                     " double *restrict out) {\n", name);
+        put_columns(out, program);
+        fputs("    for (size_t r = start; r < end; ++r) {\n", out);
+        put_body(out, program, READ_COLUMNS, "        ");
+        fputs("        out[r] = s0;\n"
+              "    }\n"
+              "}\n", out);
+    }
+    return ferror(out) ? -1 : 0;
+}
+
+/**
+ * @brief Run the compiler on source, writing library; its output is discarded
+ * @return 0 if it ran and succeeded
+ */
+static int run_compiler(const char *compiler, const char *source, const char *library) {
+    char *const argv[] = {
+        (char *)compiler, "-O3", "-march=native", "-ffp-contract=off", "-fno-math-errno",
+        "-fPIC", "-shared", (char *)source, "-o", (char *)library, "-lm", NULL,
+    };
+    posix_spawn_file_actions_t actions;
+    if (posix_spawn_file_actions_init(&actions) != 0) return -1;
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    pid_t pid;
+    int status = -1;
+    if (posix_spawnp(&pid, compiler, &actions, NULL, argv, environ) == 0) {
+        while (waitpid(pid, &status, 0) < 0) {
+            // only an interrupted wait is retried; anything else, such as ECHILD, is a failure
+            if (errno != EINTR) {
+                status = -1;
+                break;
+            }
+        }
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    return status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+rp_native_fn rp_native_compile(rp_program *program, const char *compiler) {
+    if (program->native_many) return program->native_many;
+    if (!compiler) compiler = getenv("CC");
+    if (!compiler || !*compiler) compiler = "cc";
+
+    const char *tmp = getenv("TMPDIR");
+    char dir[4096], source[4096 + 16], library[4096 + 16];
+    if (snprintf(dir, sizeof dir, "%s/rp-XXXXXX", tmp && *tmp ? tmp : "/tmp") >= (int)sizeof dir
+        || !mkdtemp(dir)) {
+        return NULL;
+    }
+    snprintf(source, sizeof source, "%s/model.c", dir);
+    snprintf(library, sizeof library, "%s/model.so", dir);
+
+    void *handle = NULL;
+    FILE *file = fopen(source, "w");
+    if (file) {
+        int written = rp_native_source(program, NATIVE_NAME, file);
+        if (fclose(file) == 0 && written == 0 && run_compiler(compiler, source, library) == 0) {
+            handle = dlopen(library, RTLD_NOW | RTLD_LOCAL);
+        }
+    }
+    // a loaded object stays mapped after its file is gone
+    unlink(source);
+    unlink(library);
+    rmdir(dir);
+    if (!handle) return NULL;
+
+    rp_native_fn many = (rp_native_fn)dlsym(handle, NATIVE_NAME);
+    rp_jit_fn scalar = (rp_jit_fn)dlsym(handle, NATIVE_NAME "_scalar");
+    jit_batch_kernel batch = (jit_batch_kernel)dlsym(handle, NATIVE_NAME "_batch");
+    if (!many || (program->noutputs == 1 && (!scalar || !batch))) {
+        dlclose(handle);
+        return NULL;
+    }
+    program->native_handle = handle;
+    program->native_many = many;
+    program->native_scalar = program->noutputs == 1 ? scalar : NULL;
+    program->native_batch = program->noutputs == 1 ? batch : NULL;
+    return many;
+}
+
+void native_release(rp_program *program) {
+    if (program->native_handle) dlclose(program->native_handle);
+    program->native_handle = NULL;
+    program->native_many = NULL;
+    program->native_scalar = NULL;
+    program->native_batch = NULL;
+}
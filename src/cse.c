@@ -0,0 +1,270 @@
+/**
+ * @file cse.c
+ * @brief Common subexpression elimination across a set of expressions.
+ *
+ * Each expression is compiled and simplified on its own, then its postfix
+ * program is hash-consed into one DAG shared by all expressions: identical
+ * (opcode, operands) pairs map to the same node. Operands of + and * are put
+ * in a canonical order first, which is exact in IEEE arithmetic, so A*B and
+ * B*A are shared too. No reassociation is done.
+ *
+ * The DAG is emitted as a single program. An operator node reached more than
+ * once is computed on first use and kept with OPC_STORE, later uses reload it
+ * with OPC_LOAD, and each expression ends in OPC_OUTPUT unless there is only
+ * one.
+ *
+ * @date 2025
+ */
+
+
+// --- library import --- //
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "program.h"
+
+typedef struct {
+    int opcode; // enum Opcode
+    int arg; // variable slot for OPC_VAR
+    double value; // OPC_CONST
+    int left; // operand node, -1 for loads
+    int right; // right operand of binary operators, -1 otherwise
+} DagNode;
+
+typedef struct {
+    DagNode *nodes;
+    int nnodes;
+    int *buckets; // node index or -1, open addressing
+    unsigned int mask;
+} Dag;
+
+static inline unsigned int hash_node(const DagNode *node) {
+    uint64_t bits;
+    memcpy(&bits, &node->value, sizeof bits);
+    uint64_t h = bits * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t)(unsigned)node->opcode * 0xC2B2AE3D27D4EB4Full;
+    h ^= (uint64_t)(unsigned)node->arg * 0x165667B19E3779F9ull;
+    h ^= (uint64_t)(unsigned)node->left * 0x27D4EB2F165667C5ull;
+    h ^= (uint64_t)(unsigned)node->right * 0x94D049BB133111EBull;
+    return (unsigned int)(h ^ h >> 29);
+}
+
+static inline int same_node(const DagNode *a, const DagNode *b) {
+    return a->opcode == b->opcode && a->arg == b->arg && a->left == b->left && a->right == b->right
+        && memcmp(&a->value, &b->value, sizeof a->value) == 0;
+}
+
+/**
+ * @brief Return the node equal to key, adding it if it is new
+ */
+static int intern(Dag *dag, DagNode key) {
+    if ((key.opcode == OPC_ADD || key.opcode == OPC_MUL) && key.left > key.right) {
+        int swap = key.left;
+        key.left = key.right;
+        key.right = swap;
+    }
+    unsigned int b = hash_node(&key) & dag->mask;
+    for (; dag->buckets[b] >= 0; b = (b + 1) & dag->mask) {
+        if (same_node(&dag->nodes[dag->buckets[b]], &key)) return dag->buckets[b];
+    }
+    dag->nodes[dag->nnodes] = key;
+    dag->buckets[b] = dag->nnodes;
+    return dag->nnodes++;
+}
+
+/**
+ * @brief Hash-cons one single-expression program into the DAG
+ * @return root node of the expression
+ */
+static int add_program(Dag *dag, const rp_program *program, int *stack) {
+    int depth = 0;
+    for (int i = 0; i < program->ncode; ++i) {
+        const Instruction *in = &program->code[i];
+        DagNode key = { in->opcode, 0, 0.0, -1, -1 };
+        switch (in->opcode) {
+            case OPC_CONST: key.value = program->consts[in->arg]; break;
+            case OPC_VAR: key.arg = in->arg; break;
+            default:
+                if (opcode_arity(in->opcode) == 1) {
+                    key.left = stack[--depth];
+                    break;
+                }
+                key.right = stack[--depth];
+                key.left = stack[--depth];
+                break;
+        }
+        stack[depth++] = intern(dag, key);
+    }
+    return stack[0];
+}
+
+static int emit(rp_program *out, int *cap, int opcode, int arg) {
+    if (out->ncode == *cap) {
+        int grown = 2 * *cap;
+        Instruction *code = realloc(out->code, grown * sizeof *code);
+        if (!code) return EXIT_FAILURE;
+        out->code = code;
+        *cap = grown;
+    }
+    out->code[out->ncode].opcode = opcode;
+    out->code[out->ncode].arg = arg;
+    out->ncode++;
+    return 0;
+}
+
+/**
+ * @brief Emit every root of the DAG into one multi-output program
+ */
+static int emit_program(const Dag *dag, const int *roots, int count, rp_program *out, rp_compile_stats *stats) {
+    int n = dag->nnodes;
+    int *uses = calloc(n, sizeof *uses);
+    int *temp = malloc(n * sizeof *temp); // temporary holding the node, -1 if none yet
+    int *pool = malloc(n * sizeof *pool); // constant pool index of a const node, -1 if none yet
+    int *pending = malloc((2 * n + 1) * sizeof *pending);
+    int cap = 2 * n + 2 * count;
+    out->code = malloc(cap * sizeof *out->code);
+    out->consts = malloc((n ? n : 1) * sizeof *out->consts);
+    int failed = !uses || !temp || !pool || !pending || !out->code || !out->consts;
+
+    for (int i = 0; !failed && i < n; ++i) {
+        const DagNode *node = &dag->nodes[i];
+        if (node->left >= 0) uses[node->left]++;
+        if (node->right >= 0) uses[node->right]++;
+        temp[i] = -1;
+        pool[i] = -1;
+    }
+    for (int k = 0; !failed && k < count; ++k) uses[roots[k]]++;
+
+    int depth = 0;
+    for (int k = 0; !failed && k < count; ++k) {
+        int npending = 0;
+        pending[npending++] = roots[k];
+        while (!failed && npending) {
+            int entry = pending[--npending];
+            int i = entry < 0 ? ~entry : entry;
+            const DagNode *node = &dag->nodes[i];
+
+            if (node->opcode == OPC_CONST) {
+                if (pool[i] < 0) {
+                    out->consts[out->nconsts] = node->value;
+                    pool[i] = out->nconsts++;
+                }
+                failed = emit(out, &cap, OPC_CONST, pool[i]);
+            } else if (node->opcode == OPC_VAR) {
+                failed = emit(out, &cap, OPC_VAR, node->arg);
+                if (node->arg >= out->nvars) out->nvars = node->arg + 1;
+            } else if (entry >= 0 && temp[i] >= 0) {
+                failed = emit(out, &cap, OPC_LOAD, temp[i]);
+                stats->shared++;
+            } else if (entry >= 0) {
+                pending[npending++] = ~i;
+                if (node->right >= 0) pending[npending++] = node->right;
+                pending[npending++] = node->left;
+                continue;
+            } else {
+                failed = emit(out, &cap, node->opcode, 0);
+                depth -= node->right >= 0 ? 2 : 1;
+                if (!failed && uses[i] > 1) {
+                    temp[i] = out->ntemps++;
+                    failed = emit(out, &cap, OPC_STORE, temp[i]);
+                }
+            }
+            if (++depth > out->maxdepth) out->maxdepth = depth;
+        }
+        // a single expression leaves its value on the stack, like a parser_compile() program
+        if (!failed && count > 1) failed = emit(out, &cap, OPC_OUTPUT, k);
+        depth--;
+    }
+
+    free(uses);
+    free(temp);
+    free(pool);
+    free(pending);
+    return failed ? EXIT_FAILURE : 0;
+}
+
+rp_program *parser_compile_many(const char *const *expressions, int count, const rp_symtab *symbols,
+                                rp_error *error) {
+    rp_error local;
+    if (!error) error = &local;
+    error->status = RP_OK;
+    error->position = 0;
+    error->expression = 0;
+    if (count < 1) {
+        error->status = RP_ERR_EMPTY;
+        return NULL;
+    }
+
+    rp_compile_stats stats = {0};
+    rp_program **programs = calloc(count, sizeof *programs);
+    if (!programs) {
+        error->status = RP_ERR_NO_MEMORY;
+        return NULL;
+    }
+
+    // compile and simplify each expression on its own first, monomials unfused
+    int total = 0, maxdepth = 0, failed = 0;
+    for (int k = 0; k < count && !failed; ++k) {
+        programs[k] = compile_program(expressions[k], symbols, error);
+        if (!programs[k]) {
+            error->expression = k;
+            failed = 1;
+            break;
+        }
+        rp_compile_stats one;
+        rp_program_stats(programs[k], &one);
+        stats.eliminated += one.eliminated;
+        stats.folded += one.folded;
+        stats.identities += one.identities;
+        stats.negations += one.negations;
+        total += programs[k]->ncode;
+        if (programs[k]->maxdepth > maxdepth) maxdepth = programs[k]->maxdepth;
+    }
+
+    Dag dag = {0};
+    int *roots = NULL, *stack = NULL;
+    rp_program *program = NULL;
+    if (!failed) {
+        unsigned int nbuckets = 16;
+        while (nbuckets < 2u * total) nbuckets *= 2;
+        dag.nodes = malloc(total * sizeof *dag.nodes);
+        dag.buckets = malloc(nbuckets * sizeof *dag.buckets);
+        dag.mask = nbuckets - 1;
+        roots = malloc(count * sizeof *roots);
+        stack = malloc((maxdepth + 1) * sizeof *stack);
+        program = calloc(1, sizeof *program);
+        failed = !dag.nodes || !dag.buckets || !roots || !stack || !program;
+        if (failed) error->status = RP_ERR_NO_MEMORY;
+    }
+    if (!failed) {
+        for (unsigned int b = 0; b <= dag.mask; ++b) dag.buckets[b] = -1;
+        for (int k = 0; k < count; ++k) roots[k] = add_program(&dag, programs[k], stack);
+
+        program->noutputs = count;
+        if (emit_program(&dag, roots, count, program, &stats)) {
+            error->status = RP_ERR_NO_MEMORY;
+            failed = 1;
+        }
+    }
+
+    for (int k = 0; k < count; ++k) rp_program_free(programs[k]);
+    free(programs);
+    free(dag.nodes);
+    free(dag.buckets);
+    free(roots);
+    free(stack);
+    if (failed) {
+        rp_program_free(program);
+        return NULL;
+    }
+
+    // rate laws and products are fused last, so the DAG can share their parts
+    match_rate_laws(program, &stats);
+    fuse_monomials(program, &stats);
+    stats.instructions = program->ncode;
+    vm_translate(program, &stats);
+    program->stats = stats;
+    return program;
+}
@@ -0,0 +1,262 @@
+/**
+ * @file incremental.c
+ * @brief Re-evaluation of a multi-expression program after a few variables
+ *        change.
+ *
+ * A program from parser_compile_many() computes its outputs one after the
+ * other, each in a segment of code ending in OPC_OUTPUT. Segments are
+ * coupled only through shared temporaries: a segment stores a value with
+ * OPC_STORE and later segments load it. Each segment and each temporary
+ * therefore depends on the variables it reads and the temporaries it loads,
+ * and those edges are inverted once into lists of readers per variable and
+ * per temporary.
+ *
+ * An update walks from the changed variables through the readers to every
+ * segment whose value can change and reruns only those, in program order,
+ * so a segment storing a temporary runs before the segments loading it.
+ * All other outputs and temporaries keep their cached values.
+ *
+ * @date 2025
+ */
+
+
+// --- library import --- //
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "program.h"
+
+struct rp_incremental {
+    const rp_program *program;
+    int nsegments; // outputs; a single expression is one segment
+    int *segment_start; // nsegments + 1 code offsets
+    int ntemps;
+    // dependency nodes: temporaries 0..ntemps-1, then the segments
+    int nvars;
+    int *var_start; // nvars + 1 offsets into var_readers
+    int *var_readers; // nodes reading each variable
+    int *temp_start; // ntemps + 1 offsets into temp_readers
+    int *temp_readers; // nodes loading each temporary
+    int *mark; // stamp of the last update that reached each node
+    int stamp;
+    int *queue; // nodes reached by an update
+    int evaluated; // whether outputs and temporaries hold values yet
+
+    double *out;
+    double *temps;
+    double *numstack;
+};
+
+// one edge from a variable or temporary to a node reading it
+typedef struct {
+    int source;
+    int node;
+} Edge;
+
+typedef struct {
+    Edge *edges;
+    size_t count;
+    size_t capacity;
+    int failed; // out of memory
+} EdgeList;
+
+static inline void add_edge(EdgeList *list, int source, int node) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? 2 * list->capacity : 64;
+        Edge *edges = realloc(list->edges, capacity * sizeof *edges);
+        if (!edges) {
+            list->failed = 1;
+            return;
+        }
+        list->edges = edges;
+        list->capacity = capacity;
+    }
+    list->edges[list->count++] = (Edge){ source, node };
+}
+
+/**
+ * @brief Record the variables and temporaries read by code [begin, end) as
+ *        inputs of node, each once
+ */
+static void add_inputs(const rp_program *program, int begin, int end, int node, int *var_mark,
+                       int *temp_mark, EdgeList *vars, EdgeList *temps) {
+    for (int i = begin; i < end; ++i) {
+        const Instruction *in = &program->code[i];
+        if (in->opcode == OPC_LOAD && temp_mark[in->arg] != node) {
+            temp_mark[in->arg] = node;
+            add_edge(temps, in->arg, node);
+        } else if (in->opcode == OPC_VAR && var_mark[in->arg] != node) {
+            var_mark[in->arg] = node;
+            add_edge(vars, in->arg, node);
+        } else if (in->opcode == OPC_MONOMIAL) {
+            const Monomial *term = &program->monomials.terms[in->arg];
+            for (int k = 0; k < term->nfactors; ++k) {
+                int slot = program->monomials.factors[term->first + k].operand;
+                if (slot < 0 || var_mark[slot] == node) continue;
+                var_mark[slot] = node;
+                add_edge(vars, slot, node);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Sort edges by source into compressed rows: start has nsources + 1
+ *        offsets into nodes
+ */
+static void invert(const EdgeList *list, int nsources, int *start, int *nodes) {
+    memset(start, 0, (nsources + 1) * sizeof *start);
+    for (size_t k = 0; k < list->count; ++k) start[list->edges[k].source + 1]++;
+    for (int s = 0; s < nsources; ++s) start[s+1] += start[s];
+    for (size_t k = 0; k < list->count; ++k) nodes[start[list->edges[k].source]++] = list->edges[k].node;
+    for (int s = nsources; s > 0; --s) start[s] = start[s-1];
+    start[0] = 0;
+}
+
+rp_incremental *rp_incremental_create(const rp_program *program) {
+    rp_incremental *state = calloc(1, sizeof *state);
+    if (!state) return NULL;
+    int ncode = program->ncode, ntemps = program->ntemps, nvars = program->nvars;
+    int nsegments = program->noutputs, nnodes = ntemps + nsegments;
+    state->program = program;
+    state->nsegments = nsegments;
+    state->ntemps = ntemps;
+    state->nvars = nvars;
+
+    int *begin = malloc((ncode + 1) * sizeof *begin);
+    int *var_mark = malloc((nvars + 1) * sizeof *var_mark);
+    int *temp_mark = malloc((ntemps + 1) * sizeof *temp_mark);
+    EdgeList vars = {0}, temps = {0};
+    state->segment_start = malloc((nsegments + 1) * sizeof *state->segment_start);
+    state->var_start = malloc((nvars + 1) * sizeof *state->var_start);
+    state->temp_start = malloc((ntemps + 1) * sizeof *state->temp_start);
+    state->mark = calloc(nnodes + 1, sizeof *state->mark);
+    state->queue = malloc((nnodes + 1) * sizeof *state->queue);
+    state->out = malloc((nsegments + 1) * sizeof *state->out);
+    state->temps = malloc((ntemps + 1) * sizeof *state->temps);
+    state->numstack = malloc((program->maxdepth + 1) * sizeof *state->numstack);
+    int ok = begin && var_mark && temp_mark && state->segment_start
+          && state->var_start && state->temp_start && state->mark && state->queue && state->out
+          && state->temps && state->numstack;
+
+    if (ok) {
+        for (int v = 0; v < nvars; ++v) var_mark[v] = -1;
+        for (int t = 0; t < ntemps; ++t) temp_mark[t] = -1;
+        subexpression_begin(program->code, 0, ncode, begin);
+        int segment = 0;
+        state->segment_start[0] = 0;
+        for (int i = 0; i < ncode; ++i) {
+            const Instruction *in = &program->code[i];
+            // a temporary depends on what the stored subexpression reads
+            if (in->opcode == OPC_STORE) {
+                add_inputs(program, begin[i], i, in->arg, var_mark, temp_mark, &vars, &temps);
+            }
+            if (in->opcode == OPC_OUTPUT) {
+                int start = state->segment_start[segment];
+                add_inputs(program, start, i, ntemps + segment, var_mark, temp_mark, &vars, &temps);
+                state->segment_start[++segment] = i + 1;
+            }
+        }
+        if (nsegments == 1) {
+            add_inputs(program, 0, ncode, ntemps, var_mark, temp_mark, &vars, &temps);
+            state->segment_start[1] = ncode;
+        }
+        state->var_readers = malloc((vars.count + 1) * sizeof *state->var_readers);
+        state->temp_readers = malloc((temps.count + 1) * sizeof *state->temp_readers);
+        ok = state->var_readers && state->temp_readers && !vars.failed && !temps.failed;
+    }
+    if (ok) {
+        invert(&vars, nvars, state->var_start, state->var_readers);
+        invert(&temps, ntemps, state->temp_start, state->temp_readers);
+    }
+
+    free(begin);
+    free(var_mark);
+    free(temp_mark);
+    free(vars.edges);
+    free(temps.edges);
+    if (!ok) {
+        rp_incremental_free(state);
+        return NULL;
+    }
+    return state;
+}
+
+// rerun one segment, refreshing its output and the temporaries it stores
+static inline void run_segment(rp_incremental *state, int segment, const double *vars) {
+    double result = eval_range(state->program, state->segment_start[segment], state->segment_start[segment+1],
+                               vars, state->temps, state->numstack, state->out);
+    if (state->nsegments == 1) state->out[0] = result;
+}
+
+void rp_incremental_eval(rp_incremental *state, const double *vars) {
+    for (int segment = 0; segment < state->nsegments; ++segment) run_segment(state, segment, vars);
+    state->evaluated = 1;
+}
+
+static int compare_ints(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// queue node once per update
+static inline void reach(rp_incremental *state, int node, int *count) {
+    if (state->mark[node] == state->stamp) return;
+    state->mark[node] = state->stamp;
+    state->queue[(*count)++] = node;
+}
+
+int rp_update(rp_incremental *state, const double *vars, const int *changed, int nchanged) {
+    if (!state->evaluated) {
+        rp_incremental_eval(state, vars);
+        return state->nsegments;
+    }
+    if (++state->stamp == 0) {
+        memset(state->mark, 0, (state->ntemps + state->nsegments) * sizeof *state->mark);
+        state->stamp = 1;
+    }
+
+    int count = 0;
+    for (int k = 0; k < nchanged; ++k) {
+        int v = changed[k];
+        if (v < 0 || v >= state->nvars) continue; // never read
+        for (int j = state->var_start[v]; j < state->var_start[v+1]; ++j) reach(state, state->var_readers[j], &count);
+    }
+    // changed temporaries reach their readers, breadth first
+    for (int k = 0; k < count; ++k) {
+        int t = state->queue[k];
+        if (t >= state->ntemps) continue;
+        for (int j = state->temp_start[t]; j < state->temp_start[t+1]; ++j) {
+            reach(state, state->temp_readers[j], &count);
+        }
+    }
+
+    // segments run in program order, so temporaries are stored before they are loaded
+    int nsegments = 0;
+    for (int k = 0; k < count; ++k) {
+        if (state->queue[k] >= state->ntemps) state->queue[nsegments++] = state->queue[k] - state->ntemps;
+    }
+    qsort(state->queue, nsegments, sizeof *state->queue, compare_ints);
+    for (int k = 0; k < nsegments; ++k) run_segment(state, state->queue[k], vars);
+    return nsegments;
+}
+
+const double *rp_incremental_outputs(const rp_incremental *state) {
+    return state->out;
+}
+
+void rp_incremental_free(rp_incremental *state) {
+    if (!state) return;
+    free(state->segment_start);
+    free(state->var_start);
+    free(state->var_readers);
+    free(state->temp_start);
+    free(state->temp_readers);
+    free(state->mark);
+    free(state->queue);
+    free(state->out);
+    free(state->temps);
+    free(state->numstack);
+    free(state);
+}
@@ -0,0 +1,560 @@
+/**
+ * @file jit.c
+ * @brief Native x86-64 code generation for compiled programs.
+ *
+ * Lowers a postfix program to straight-line machine code in an mmap'd page:
+ *   - a scalar SSE2 function, double f(const double *vars)
+ *   - a packed AVX batch kernel evaluating 4 rows per iteration
+ *
+ * Operand stack depth d lives in register xmm<d> (ymm<d> for the batch
+ * kernel), so programs deeper than 16 stay on the interpreter. sqrt, abs,
+ * min and max are single instructions, monomials are expanded into
+ * multiplications and the Michaelis-Menten kernels are inlined in the
+ * interpreter's order of operations; pow, %, exp, log, tanh and Hill kernels
+ * call back into the same eval functions the interpreter uses, so both paths
+ * share semantics. Constants, 1.0 and the sign and abs masks are stored in the page
+ * after the code and addressed RIP-relative, which keeps the code
+ * independent of the program it was generated from.
+ *
+ * No external code generator is needed; on other architectures
+ * rp_jit_compile() returns NULL and the interpreter is used.
+ *
+ * @date 2025
+ */
+
+
+// --- library import --- //
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "program.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+// constants:
+#define JIT_REGS 16 // xmm/ymm registers available for the operand stack
+#define SCALAR_FRAME (JIT_REGS * 8) // spill area around calls, 16-byte aligned
+#define PACKED_FRAME (JIT_REGS * 32 + 8) // spill area plus realignment after 4 pushes
+#define SIGN_MASK -1 // fixup index of the sign mask in the constant pool
+#define ABS_MASK -2 // and of the mask clearing the sign
+#define ONE -3 // and of 1.0 in every lane
+
+// addressing modes for memory operands
+enum Mem {
+    MEM_RBX, // [rbx + disp32]: vars (scalar) or columns (packed)
+    MEM_RSP, // [rsp + disp32]: spill area
+    MEM_RIP, // [rip + disp32]: constant pool, patched after layout
+    MEM_RAX_ROW, // [rax + r12*8]: current row of a column
+    MEM_R14_ROW, // [r14 + r12*8]: current row of the output
+};
+
+typedef struct {
+    size_t at; // offset of the disp32 to patch
+    int index; // constant index, SIGN_MASK, ABS_MASK or ONE
+} Fixup;
+
+typedef struct {
+    uint8_t *bytes;
+    size_t len;
+    size_t cap;
+    Fixup *fixups;
+    int nfixups;
+    int capfixups;
+    int failed; // out of memory; checked once at the end
+} CodeBuffer;
+
+// -- call-out helpers, shared semantics with the interpreter
+static double jit_pow(double arg1, double arg2) { return eval_exponent(arg1, arg2); }
+static double jit_mod(double arg1, double arg2) { return eval_modulo(arg1, arg2); }
+
+static void jit_pow_lanes(double *arg1, const double *arg2) {
+    for (int j = 0; j < JIT_LANES; ++j) arg1[j] = eval_exponent(arg1[j], arg2[j]);
+}
+
+static void jit_mod_lanes(double *arg1, const double *arg2) {
+    for (int j = 0; j < JIT_LANES; ++j) arg1[j] = eval_modulo(arg1[j], arg2[j]);
+}
+
+static double jit_exp(double arg1) { return eval_exp(arg1, 0); }
+static double jit_log(double arg1) { return eval_log(arg1, 0); }
+static double jit_tanh(double arg1) { return eval_tanh(arg1, 0); }
+
+static void jit_exp_lanes(double *arg1) {
+    for (int j = 0; j < JIT_LANES; ++j) arg1[j] = eval_exp(arg1[j], 0);
+}
+
+static void jit_log_lanes(double *arg1) {
+    for (int j = 0; j < JIT_LANES; ++j) arg1[j] = eval_log(arg1[j], 0);
+}
+
+static void jit_tanh_lanes(double *arg1) {
+    for (int j = 0; j < JIT_LANES; ++j) arg1[j] = eval_tanh(arg1[j], 0);
+}
+
+// the Hill coefficient's half power comes in edi (scalar) or esi (packed)
+static double jit_hill(double arg1, double arg2, double arg3, double arg4, int half_power) {
+    return eval_hill(arg1, arg2, arg3, arg4, half_power);
+}
+
+// the four parameters are consecutive spill slots, JIT_LANES apart
+static void jit_hill_lanes(double *args, int half_power) {
+    for (int j = 0; j < JIT_LANES; ++j) {
+        args[j] = eval_hill(args[j], args[JIT_LANES + j], args[2 * JIT_LANES + j], args[3 * JIT_LANES + j],
+                            half_power);
+    }
+}
+
+// helper called for a function without an instruction of its own
+static const void *call_target(int opcode, int packed) {
+    switch (opcode) {
+        case OPC_HILL: return packed ? (const void *)jit_hill_lanes : (const void *)jit_hill;
+        case OPC_POW: return packed ? (const void *)jit_pow_lanes : (const void *)jit_pow;
+        case OPC_MOD: return packed ? (const void *)jit_mod_lanes : (const void *)jit_mod;
+        case OPC_EXP: return packed ? (const void *)jit_exp_lanes : (const void *)jit_exp;
+        case OPC_LOG: return packed ? (const void *)jit_log_lanes : (const void *)jit_log;
+        case OPC_TANH: return packed ? (const void *)jit_tanh_lanes : (const void *)jit_tanh;
+    }
+    return NULL;
+}
+
+// -- byte emission
+static void put(CodeBuffer *b, const void *src, size_t n) {
+    if (b->len + n > b->cap) {
+        size_t cap = b->cap ? 2 * b->cap : 1024;
+        while (cap < b->len + n) cap *= 2;
+        uint8_t *bytes = realloc(b->bytes, cap);
+        if (!bytes) { b->failed = 1; return; }
+        b->bytes = bytes;
+        b->cap = cap;
+    }
+    memcpy(b->bytes + b->len, src, n);
+    b->len += n;
+}
+
+static void put1(CodeBuffer *b, uint8_t x) { put(b, &x, 1); }
+static void put4(CodeBuffer *b, uint32_t x) { put(b, &x, 4); }
+static void put8(CodeBuffer *b, uint64_t x) { put(b, &x, 8); }
+
+static void patch4(CodeBuffer *b, size_t at, uint32_t x) {
+    if (!b->failed) memcpy(b->bytes + at, &x, 4);
+}
+
+static void add_fixup(CodeBuffer *b, int index) {
+    if (b->nfixups == b->capfixups) {
+        int cap = b->capfixups ? 2 * b->capfixups : 32;
+        Fixup *fixups = realloc(b->fixups, cap * sizeof *fixups);
+        if (!fixups) { b->failed = 1; return; }
+        b->fixups = fixups;
+        b->capfixups = cap;
+    }
+    b->fixups[b->nfixups].at = b->len;
+    b->fixups[b->nfixups].index = index;
+    b->nfixups++;
+}
+
+// REX.X / REX.B (or their inverted VEX forms) required by a memory operand
+static inline int mem_x(enum Mem mem) { return mem == MEM_RAX_ROW || mem == MEM_R14_ROW; }
+static inline int mem_b(enum Mem mem) { return mem == MEM_R14_ROW; }
+
+static void put_modrm_mem(CodeBuffer *b, int reg, enum Mem mem, int32_t disp) {
+    reg &= 7;
+    switch (mem) {
+        case MEM_RBX: put1(b, 0x80 | reg << 3 | 3); put4(b, disp); break;
+        case MEM_RSP: put1(b, 0x80 | reg << 3 | 4); put1(b, 0x24); put4(b, disp); break;
+        case MEM_RIP: put1(b, reg << 3 | 5); add_fixup(b, disp); put4(b, 0); break;
+        case MEM_RAX_ROW: put1(b, reg << 3 | 4); put1(b, 3 << 6 | 4 << 3 | 0); break;
+        case MEM_R14_ROW: put1(b, reg << 3 | 4); put1(b, 3 << 6 | 4 << 3 | 6); break;
+    }
+}
+
+// legacy-encoded SSE2: prefix [REX] 0F op modrm
+static void sse_mem(CodeBuffer *b, uint8_t prefix, uint8_t op, int reg, enum Mem mem, int32_t disp) {
+    uint8_t rex = 0x40 | (reg >= 8) << 2 | mem_x(mem) << 1 | mem_b(mem);
+    put1(b, prefix);
+    if (rex != 0x40) put1(b, rex);
+    put1(b, 0x0F);
+    put1(b, op);
+    put_modrm_mem(b, reg, mem, disp);
+}
+
+static void sse_reg(CodeBuffer *b, uint8_t prefix, uint8_t op, int reg, int rm) {
+    uint8_t rex = 0x40 | (reg >= 8) << 2 | (rm >= 8);
+    put1(b, prefix);
+    if (rex != 0x40) put1(b, rex);
+    put1(b, 0x0F);
+    put1(b, op);
+    put1(b, 0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+// three-byte VEX, 256-bit, 66 prefix, W0
+static void put_vex(CodeBuffer *b, int map, int reg, int vvvv, int x, int bext) {
+    put1(b, 0xC4);
+    put1(b, (reg < 8) << 7 | !x << 6 | !bext << 5 | map);
+    put1(b, (~vvvv & 15) << 3 | 1 << 2 | 1);
+}
+
+static void avx_reg(CodeBuffer *b, uint8_t op, int reg, int vvvv, int rm) {
+    put_vex(b, 1, reg, vvvv, 0, rm >= 8);
+    put1(b, op);
+    put1(b, 0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+static void avx_mem(CodeBuffer *b, int map, uint8_t op, int reg, int vvvv, enum Mem mem, int32_t disp) {
+    put_vex(b, map, reg, vvvv, mem_x(mem), mem_b(mem));
+    put1(b, op);
+    put_modrm_mem(b, reg, mem, disp);
+}
+
+// mov rax, imm64; call rax
+static void call_abs(CodeBuffer *b, const void *target) {
+    put1(b, 0x48); put1(b, 0xB8); put8(b, (uint64_t)(uintptr_t)target);
+    put1(b, 0xFF); put1(b, 0xD0);
+}
+
+// lea reg, [rsp + disp32] for reg in {rdi, rsi}
+static void lea_rsp(CodeBuffer *b, int reg, int32_t disp) {
+    put1(b, 0x48); put1(b, 0x8D); put1(b, 0x80 | reg << 3 | 4); put1(b, 0x24); put4(b, disp);
+}
+
+enum { RSI = 6, RDI = 7 };
+
+// SSE2/AVX opcode bytes for the binary arithmetic operators
+static inline uint8_t arith_opcode(int opcode) {
+    switch (opcode) {
+        case OPC_ADD: return 0x58;
+        case OPC_MUL: return 0x59;
+        case OPC_SUB: return 0x5C;
+        case OPC_DIV: return 0x5E;
+        case OPC_MIN: return 0x5D;
+        case OPC_MAX: return 0x5F;
+    }
+    return 0;
+}
+
+/**
+ * @brief Emit an OPC_MONOMIAL pushed to register n, using n+1 and n+2 as scratch
+ *
+ * Unrolls eval_power() for each factor with the same multiplications in the
+ * same order, so native code and interpreter agree to the bit.
+ */
+static void emit_monomial(CodeBuffer *b, const rp_program *program, int index, int n, int packed) {
+    const Monomial *term = &program->monomials.terms[index];
+    const Factor *factors = program->monomials.factors + term->first;
+    int result = n + 1, base = n + 2;
+
+    for (int k = 0; k < term->nfactors; ++k) {
+        int operand = factors[k].operand;
+        if (packed && operand >= 0) {
+            put1(b, 0x48); put1(b, 0x8B); put1(b, 0x83); put4(b, 8 * operand); // mov rax, [rbx+8*slot]
+            avx_mem(b, 1, 0x10, base, 0, MEM_RAX_ROW, 0); // vmovupd
+        } else if (packed) {
+            avx_mem(b, 2, 0x19, base, 0, MEM_RIP, ~operand); // vbroadcastsd
+        } else {
+            sse_mem(b, 0xF2, 0x10, base, operand >= 0 ? MEM_RBX : MEM_RIP,
+                    operand >= 0 ? 8 * operand : ~operand); // movsd
+        }
+
+        // result = base^(p/2); -1 while it is still the 1.0 eval_power() starts from
+        int value = -1;
+        if (factors[k].half_power & 1) {
+            if (packed) avx_reg(b, 0x51, result, 0, base); // vsqrtpd
+            else sse_reg(b, 0xF2, 0x51, result, base); // sqrtsd
+            value = result;
+        }
+        for (int p = factors[k].half_power >> 1; p; p >>= 1) {
+            if (p & 1 && value < 0) {
+                value = base;
+            } else if (p & 1) {
+                if (value == base) {
+                    if (packed) avx_reg(b, 0x28, result, 0, base); // vmovapd
+                    else sse_reg(b, 0x66, 0x28, result, base); // movapd
+                    value = result;
+                }
+                if (packed) avx_reg(b, 0x59, result, result, base); // vmulpd
+                else sse_reg(b, 0xF2, 0x59, result, base); // mulsd
+            }
+            if (p > 1) {
+                // squaring the base would clobber a result still held there
+                if (value == base) {
+                    if (packed) avx_reg(b, 0x28, result, 0, base);
+                    else sse_reg(b, 0x66, 0x28, result, base);
+                    value = result;
+                }
+                if (packed) avx_reg(b, 0x59, base, base, base);
+                else sse_reg(b, 0xF2, 0x59, base, base);
+            }
+        }
+
+        // the first factor is the product so far, 1.0 * x being exact
+        if (k == 0) {
+            if (packed) avx_reg(b, 0x28, n, 0, value);
+            else sse_reg(b, 0x66, 0x28, n, value);
+        } else {
+            if (packed) avx_reg(b, 0x59, n, n, value);
+            else sse_reg(b, 0xF2, 0x59, n, value);
+        }
+    }
+}
+
+// dst = dst op src
+static void arith(CodeBuffer *b, uint8_t op, int dst, int src, int packed) {
+    if (packed) avx_reg(b, op, dst, dst, src);
+    else sse_reg(b, 0xF2, op, dst, src);
+}
+
+/**
+ * @brief Emit an OPC_MICHAELIS or OPC_REVERSIBLE_MM on the top n registers
+ *
+ * Same operations in the same order as eval_michaelis() and
+ * eval_reversible_mm(); the parameters' registers double as temporaries and
+ * the result replaces the first.
+ */
+static void emit_rate_law(CodeBuffer *b, int opcode, int n, int packed) {
+    if (opcode == OPC_MICHAELIS) {
+        int v = n - 3, s = n - 2, k = n - 1;
+        arith(b, 0x58, k, s, packed); // K + S
+        arith(b, 0x59, v, s, packed); // V * S
+        arith(b, 0x5E, v, k, packed);
+        return;
+    }
+    int vf = n - 6, s = n - 5, ks = n - 4, vr = n - 3, p = n - 2, kp = n - 1;
+    arith(b, 0x59, vf, s, packed); // Vf * S / Ks
+    arith(b, 0x5E, vf, ks, packed);
+    arith(b, 0x59, vr, p, packed); // Vr * P / Kp
+    arith(b, 0x5E, vr, kp, packed);
+    arith(b, 0x5E, s, ks, packed); // 1 + S/Ks + P/Kp
+    if (packed) avx_mem(b, 1, 0x58, s, s, MEM_RIP, ONE); // vaddpd
+    else sse_mem(b, 0xF2, 0x58, s, MEM_RIP, ONE); // addsd
+    arith(b, 0x5E, p, kp, packed);
+    arith(b, 0x58, s, p, packed);
+    arith(b, 0x5C, vf, vr, packed);
+    arith(b, 0x5E, vf, s, packed);
+}
+
+/**
+ * @brief Emit double f(const double *vars); vars kept in rbx across calls
+ */
+static void emit_scalar(CodeBuffer *b, const rp_program *program) {
+    put1(b, 0x53); // push rbx
+    put1(b, 0x48); put1(b, 0x89); put1(b, 0xFB); // mov rbx, rdi
+    put1(b, 0x48); put1(b, 0x81); put1(b, 0xEC); put4(b, SCALAR_FRAME); // sub rsp, frame
+
+    int n = 0;
+    for (int i = 0; i < program->ncode; ++i) {
+        const Instruction *in = &program->code[i];
+        switch (in->opcode) {
+            case OPC_CONST: sse_mem(b, 0xF2, 0x10, n++, MEM_RIP, in->arg); break; // movsd
+            case OPC_VAR: sse_mem(b, 0xF2, 0x10, n++, MEM_RBX, 8 * in->arg); break; // movsd
+            case OPC_MONOMIAL: emit_monomial(b, program, in->arg, n++, 0); break;
+            case OPC_NEG: sse_mem(b, 0x66, 0x57, n-1, MEM_RIP, SIGN_MASK); break; // xorpd
+            case OPC_ABS: sse_mem(b, 0x66, 0x54, n-1, MEM_RIP, ABS_MASK); break; // andpd
+            case OPC_SQRT: sse_reg(b, 0xF2, 0x51, n-1, n-1); break; // sqrtsd
+            case OPC_ADD: case OPC_SUB: case OPC_MUL: case OPC_DIV: case OPC_MIN: case OPC_MAX:
+                sse_reg(b, 0xF2, arith_opcode(in->opcode), n-2, n-1);
+                n--;
+                break;
+            case OPC_POW: case OPC_MOD:
+                // everything below the operands is caller-saved: spill, call, reload
+                for (int k = 0; k < n-2; ++k) sse_mem(b, 0xF2, 0x11, k, MEM_RSP, 8 * k);
+                if (n-2 != 0) sse_reg(b, 0x66, 0x28, 0, n-2); // movapd xmm0, left
+                if (n-1 != 1) sse_reg(b, 0x66, 0x28, 1, n-1); // movapd xmm1, right
+                call_abs(b, call_target(in->opcode, 0));
+                if (n-2 != 0) sse_reg(b, 0x66, 0x28, n-2, 0);
+                for (int k = 0; k < n-2; ++k) sse_mem(b, 0xF2, 0x10, k, MEM_RSP, 8 * k);
+                n--;
+                break;
+            case OPC_EXP: case OPC_LOG: case OPC_TANH:
+                for (int k = 0; k < n-1; ++k) sse_mem(b, 0xF2, 0x11, k, MEM_RSP, 8 * k);
+                if (n-1 != 0) sse_reg(b, 0x66, 0x28, 0, n-1); // movapd xmm0, operand
+                call_abs(b, call_target(in->opcode, 0));
+                if (n-1 != 0) sse_reg(b, 0x66, 0x28, n-1, 0);
+                for (int k = 0; k < n-1; ++k) sse_mem(b, 0xF2, 0x10, k, MEM_RSP, 8 * k);
+                break;
+            case OPC_MICHAELIS: case OPC_REVERSIBLE_MM:
+                emit_rate_law(b, in->opcode, n, 0);
+                n -= opcode_arity(in->opcode) - 1;
+                break;
+            case OPC_HILL:
+                // parameters to xmm0-3, moving down so none is overwritten before it is read
+                for (int k = 0; k < n-4; ++k) sse_mem(b, 0xF2, 0x11, k, MEM_RSP, 8 * k);
+                for (int k = 0; k < 4 && n-4 != 0; ++k) sse_reg(b, 0x66, 0x28, k, n-4+k);
+                put1(b, 0xBF); put4(b, in->arg); // mov edi, half_power
+                call_abs(b, call_target(in->opcode, 0));
+                if (n-4 != 0) sse_reg(b, 0x66, 0x28, n-4, 0);
+                for (int k = 0; k < n-4; ++k) sse_mem(b, 0xF2, 0x10, k, MEM_RSP, 8 * k);
+                n -= 3;
+                break;
+        }
+    }
+
+    put1(b, 0x48); put1(b, 0x81); put1(b, 0xC4); put4(b, SCALAR_FRAME); // add rsp, frame
+    put1(b, 0x5B); // pop rbx
+    put1(b, 0xC3); // ret
+}
+
+/**
+ * @brief Emit a jit_batch_kernel; columns in rbx, row in r12, end in r13, out in r14
+ */
+static void emit_packed(CodeBuffer *b, const rp_program *program) {
+    static const uint8_t prologue[] = {
+        0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, // push rbx, r12, r13, r14
+        0x48, 0x89, 0xFB, // mov rbx, rdi
+        0x49, 0x89, 0xF4, // mov r12, rsi
+        0x49, 0x89, 0xD5, // mov r13, rdx
+        0x49, 0x89, 0xCE, // mov r14, rcx
+    };
+    put(b, prologue, sizeof prologue);
+    put1(b, 0x48); put1(b, 0x81); put1(b, 0xEC); put4(b, PACKED_FRAME); // sub rsp, frame
+
+    size_t loop = b->len;
+    put1(b, 0x4D); put1(b, 0x39); put1(b, 0xEC); // cmp r12, r13
+    put1(b, 0x0F); put1(b, 0x83); // jae done
+    size_t exit_jump = b->len;
+    put4(b, 0);
+
+    int n = 0;
+    for (int i = 0; i < program->ncode; ++i) {
+        const Instruction *in = &program->code[i];
+        switch (in->opcode) {
+            case OPC_CONST: avx_mem(b, 2, 0x19, n++, 0, MEM_RIP, in->arg); break; // vbroadcastsd
+            case OPC_VAR:
+                put1(b, 0x48); put1(b, 0x8B); put1(b, 0x83); put4(b, 8 * in->arg); // mov rax, [rbx+8*slot]
+                avx_mem(b, 1, 0x10, n++, 0, MEM_RAX_ROW, 0); // vmovupd
+                break;
+            case OPC_MONOMIAL: emit_monomial(b, program, in->arg, n++, 1); break;
+            case OPC_NEG: avx_mem(b, 1, 0x57, n-1, n-1, MEM_RIP, SIGN_MASK); break; // vxorpd
+            case OPC_ABS: avx_mem(b, 1, 0x54, n-1, n-1, MEM_RIP, ABS_MASK); break; // vandpd
+            case OPC_SQRT: avx_reg(b, 0x51, n-1, 0, n-1); break; // vsqrtpd
+            case OPC_ADD: case OPC_SUB: case OPC_MUL: case OPC_DIV: case OPC_MIN: case OPC_MAX:
+                avx_reg(b, arith_opcode(in->opcode), n-2, n-2, n-1);
+                n--;
+                break;
+            case OPC_POW: case OPC_MOD: case OPC_EXP: case OPC_LOG: case OPC_TANH: {
+                // helpers work in place on the spill area, on the operand(s) on top
+                int arity = opcode_arity(in->opcode);
+                for (int k = 0; k < n; ++k) avx_mem(b, 1, 0x11, k, 0, MEM_RSP, 32 * k);
+                put1(b, 0xC5); put1(b, 0xF8); put1(b, 0x77); // vzeroupper
+                lea_rsp(b, RDI, 32 * (n-arity));
+                if (arity == 2) lea_rsp(b, RSI, 32 * (n-1));
+                call_abs(b, call_target(in->opcode, 1));
+                n -= arity - 1;
+                for (int k = 0; k < n; ++k) avx_mem(b, 1, 0x10, k, 0, MEM_RSP, 32 * k);
+                break;
+            }
+            case OPC_MICHAELIS: case OPC_REVERSIBLE_MM:
+                emit_rate_law(b, in->opcode, n, 1);
+                n -= opcode_arity(in->opcode) - 1;
+                break;
+            case OPC_HILL:
+                for (int k = 0; k < n; ++k) avx_mem(b, 1, 0x11, k, 0, MEM_RSP, 32 * k);
+                put1(b, 0xC5); put1(b, 0xF8); put1(b, 0x77); // vzeroupper
+                lea_rsp(b, RDI, 32 * (n-4));
+                put1(b, 0xBE); put4(b, in->arg); // mov esi, half_power
+                call_abs(b, call_target(in->opcode, 1));
+                n -= 3;
+                for (int k = 0; k < n; ++k) avx_mem(b, 1, 0x10, k, 0, MEM_RSP, 32 * k);
+                break;
+        }
+    }
+
+    avx_mem(b, 1, 0x11, 0, 0, MEM_R14_ROW, 0); // vmovupd [r14 + r12*8], ymm0
+    put1(b, 0x49); put1(b, 0x83); put1(b, 0xC4); put1(b, JIT_LANES); // add r12, lanes
+    put1(b, 0xE9); put4(b, (uint32_t)(loop - (b->len + 4))); // jmp loop
+    patch4(b, exit_jump, (uint32_t)(b->len - (exit_jump + 4)));
+
+    put1(b, 0xC5); put1(b, 0xF8); put1(b, 0x77); // vzeroupper
+    put1(b, 0x48); put1(b, 0x81); put1(b, 0xC4); put4(b, PACKED_FRAME); // add rsp, frame
+    static const uint8_t epilogue[] = {
+        0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, // pop r14, r13, r12, rbx
+        0xC3, // ret
+    };
+    put(b, epilogue, sizeof epilogue);
+}
+
+/**
+ * @brief Append the sign and abs masks, ones and constant pool, then resolve RIP-relative references
+ */
+static void emit_pool(CodeBuffer *b, const rp_program *program) {
+    while (b->len % 32) put1(b, 0xCC); // int3 padding; the masks are read aligned
+    size_t mask = b->len;
+    for (int j = 0; j < JIT_LANES; ++j) put8(b, 0x8000000000000000ull);
+    size_t abs_mask = b->len;
+    for (int j = 0; j < JIT_LANES; ++j) put8(b, 0x7FFFFFFFFFFFFFFFull);
+    size_t ones = b->len;
+    for (int j = 0; j < JIT_LANES; ++j) put(b, &(double){ 1.0 }, sizeof(double));
+    size_t pool = b->len;
+    put(b, program->consts, program->nconsts * sizeof *program->consts);
+
+    for (int i = 0; i < b->nfixups; ++i) {
+        const Fixup *f = &b->fixups[i];
+        size_t target = f->index == SIGN_MASK ? mask : f->index == ABS_MASK ? abs_mask
+                      : f->index == ONE ? ones : pool + 8 * f->index;
+        patch4(b, f->at, (uint32_t)(target - (f->at + 4)));
+    }
+}
+
+rp_jit_fn rp_jit_compile(rp_program *program) {
+    if (program->jit_scalar) return program->jit_scalar;
+    // monomials take two registers above their own
+    int registers = program->maxdepth + (program->monomials.nterms ? 2 : 0);
+    if (program->noutputs != 1 || program->ntemps || registers > JIT_REGS) return NULL;
+
+    CodeBuffer b = {0};
+    int packed = __builtin_cpu_supports("avx");
+    size_t packed_entry = 0;
+
+    emit_scalar(&b, program);
+    if (packed) {
+        while (b.len % 16) put1(&b, 0xCC);
+        packed_entry = b.len;
+        emit_packed(&b, program);
+    }
+    emit_pool(&b, program);
+
+    void *page = MAP_FAILED;
+    size_t size = 0;
+    if (!b.failed) {
+        size_t pagesize = (size_t)sysconf(_SC_PAGESIZE);
+        size = (b.len + pagesize - 1) / pagesize * pagesize;
+        page = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (page != MAP_FAILED) {
+        memcpy(page, b.bytes, b.len);
+        if (mprotect(page, size, PROT_READ | PROT_EXEC)) {
+            munmap(page, size);
+            page = MAP_FAILED;
+        }
+    }
+    free(b.bytes);
+    free(b.fixups);
+    if (page == MAP_FAILED) return NULL;
+
+    program->jit_page = page;
+    program->jit_size = size;
+    program->jit_scalar = (rp_jit_fn)page;
+    program->jit_batch = packed ? (jit_batch_kernel)((uint8_t *)page + packed_entry) : NULL;
+    return program->jit_scalar;
+}
+
+void jit_release(rp_program *program) {
+    if (program->jit_page) munmap(program->jit_page, program->jit_size);
+    program->jit_page = NULL;
+    program->jit_scalar = NULL;
+    program->jit_batch = NULL;
+}
+
+#else
+
+rp_jit_fn rp_jit_compile(rp_program *program) {
+    return NULL;
+}
+
+void jit_release(rp_program *program) {
+}
+
+#endif
@@ -1,12 +1,256 @@
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "parser.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAVE_MMAP 1
+#endif
+
+#define CHUNK_MIN_BYTES (64 * 1024) // smaller chunks are not worth a thread
+#define CHUNKS_PER_THREAD 4 // lets threads that draw short lines pick up more work
+#define LINE_BUFFER 256
+
+typedef struct {
+    const char *begin; // first byte of the chunk, always the start of a line
+    const char *end;
+    char *out; // formatted results for the chunk's lines
+    size_t nout;
+    size_t capacity;
+    int failed;
+} Chunk;
+
+/**
+ * @brief Map a whole file read-only, or read it where mmap is unavailable
+ * @return 0 with the contents in *data, which may be NULL for an empty file;
+ *         -1 with errno set if the file cannot be read
+ */
+static int map_file(const char *path, const char **data, size_t *size) {
+    *data = NULL;
+    *size = 0;
+#ifdef HAVE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    void *mapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int saved = errno;
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        errno = saved;
+        return -1;
+    }
+    *data = mapped;
+    *size = (size_t)st.st_size;
+    madvise(mapped, *size, MADV_SEQUENTIAL);
+    return 0;
+#else
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    char *contents = NULL;
+    size_t capacity = 0, n;
+    do {
+        if (*size == capacity) {
+            capacity = capacity ? 2 * capacity : 1 << 16;
+            char *grown = realloc(contents, capacity);
+            if (!grown) {
+                free(contents);
+                fclose(f);
+                errno = ENOMEM;
+                return -1;
+            }
+            contents = grown;
+        }
+        n = fread(contents + *size, 1, capacity - *size, f);
+        *size += n;
+    } while (n);
+    if (ferror(f)) {
+        int saved = errno;
+        free(contents);
+        fclose(f);
+        errno = saved;
+        return -1;
+    }
+    fclose(f);
+    *data = contents;
+    return 0;
+#endif
+}
+
+static void unmap_file(const char *data, size_t size) {
+#ifdef HAVE_MMAP
+    if (data) munmap((void *)data, size);
+#else
+    (void)size;
+    free((void *)data);
+#endif
+}
+
+/**
+ * @brief Append one formatted line to a chunk's output
+ */
+static int append(Chunk *chunk, const char *text, int len) {
+    if (len < 0) return EXIT_FAILURE;
+    if (chunk->nout + (size_t)len + 1 > chunk->capacity) {
+        size_t capacity = 2 * chunk->capacity + (size_t)len + 1;
+        char *grown = realloc(chunk->out, capacity);
+        if (!grown) return EXIT_FAILURE;
+        chunk->out = grown;
+        chunk->capacity = capacity;
+    }
+    memcpy(chunk->out + chunk->nout, text, (size_t)len);
+    chunk->nout += (size_t)len;
+    return 0;
+}
+
+/**
+ * @brief Evaluate every line of a chunk, one output line per input line
+ *
+ * Whitespace-only lines give empty output lines; errors are written in place
+ * of the result so output line i always belongs to input line i.
+ */
+static void evaluate_chunk(Chunk *chunk) {
+    char local[LINE_BUFFER];
+    char *line = local;
+    size_t capacity = sizeof local;
+
+    for (const char *p = chunk->begin; p < chunk->end;) {
+        const char *newline = memchr(p, '\n', (size_t)(chunk->end - p));
+        const char *eol = newline ? newline : chunk->end;
+        const char *start = p;
+        size_t len = (size_t)(eol - start);
+        p = eol + 1;
+
+        // the parser reads NUL-terminated strings; the mapping is read-only
+        if (len + 1 > capacity) {
+            char *grown = line == local ? malloc(len + 1) : realloc(line, len + 1);
+            if (!grown) {
+                chunk->failed = 1;
+                break;
+            }
+            line = grown;
+            capacity = len + 1;
+        }
+        memcpy(line, start, len);
+        line[len] = '\0';
+
+        char text[LINE_BUFFER];
+        int n;
+        double result;
+        rp_error error;
+        if (strspn(line, " \t\r\v\f") == len) {
+            n = snprintf(text, sizeof text, "\n");
+        } else if (parser_eval(line, &result, &error)) {
+            n = snprintf(text, sizeof text, "ERROR: %s at position %d\n",
+                         rp_strerror(error.status), error.position);
+            chunk->failed = 1;
+        } else {
+            n = snprintf(text, sizeof text, "%.15G\n", result);
+        }
+        if (append(chunk, text, n)) {
+            chunk->failed = 1;
+            break;
+        }
+    }
+    if (line != local) free(line);
+}
+
+/**
+ * @brief Evaluate a newline-delimited expression file, writing results in order
+ *
+ * The file is mapped and cut into chunks at line boundaries; chunks are
+ * evaluated in parallel into private buffers and written out in file order.
+ */
+static int evaluate_file(const char *path) {
+    const char *data;
+    size_t size;
+    if (map_file(path, &data, &size)) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    if (size == 0) {
+        // an empty file has no results
+        unmap_file(data, size);
+        return 0;
+    }
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    size_t nchunks = size / CHUNK_MIN_BYTES;
+    if (nchunks > (size_t)threads * CHUNKS_PER_THREAD) nchunks = (size_t)threads * CHUNKS_PER_THREAD;
+    if (nchunks < 1) nchunks = 1;
+    Chunk *chunks = calloc(nchunks, sizeof *chunks);
+    if (!chunks) {
+        unmap_file(data, size);
+        fprintf(stderr, "ERROR: %s\n", rp_strerror(RP_ERR_NO_MEMORY));
+        return EXIT_FAILURE;
+    }
+
+    // move each nominal boundary forward past the next newline
+    const char *end = data + size;
+    const char *begin = data;
+    for (size_t c = 0; c < nchunks; ++c) {
+        const char *cut = c + 1 == nchunks ? end : data + size / nchunks * (c + 1);
+        if (cut < begin) cut = begin;
+        if (cut < end) {
+            const char *newline = memchr(cut, '\n', (size_t)(end - cut));
+            cut = newline ? newline + 1 : end;
+        }
+        chunks[c].begin = begin;
+        chunks[c].end = cut;
+        begin = cut;
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long c = 0; c < (long)nchunks; ++c) {
+        evaluate_chunk(&chunks[c]);
+    }
+
+    int failed = 0;
+    for (size_t c = 0; c < nchunks; ++c) {
+        if (chunks[c].nout && fwrite(chunks[c].out, 1, chunks[c].nout, stdout) != chunks[c].nout) failed = 1;
+        failed |= chunks[c].failed;
+        free(chunks[c].out);
+    }
+    free(chunks);
+    unmap_file(data, size);
+    return failed ? EXIT_FAILURE : 0;
+}
+
 /**
  * @brief CLI wrapper
  */
 int main(int argc, char *argv[]) {
+    if (argc < 2 || (strcmp(argv[1], "--file") == 0 && argc < 3)) {
+        fprintf(stderr, "usage: %s \"expression\"\n       %s --file expressions.txt\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (strcmp(argv[1], "--file") == 0) {
+        return evaluate_file(argv[2]);
+    }
     char *expression = argv[1];
-    double result = parser(expression);
+    double result;
+    rp_error error;
+    if (parser_eval(expression, &result, &error)) {
+        fprintf(stderr, "ERROR: %s at position %d\n", rp_strerror(error.status), error.position);
+        return EXIT_FAILURE;
+    }
     printf("%.15G\n", result);
     return 0;
 }
@@ -0,0 +1,360 @@
+/**
+ * @file network.c
+ * @brief Right-hand side of a reaction network's ODEs in one call.
+ *
+ * All rate expressions are compiled into one multi-output program, so a
+ * subterm shared by several reactions is computed once. The stoichiometry
+ * matrix is kept in compressed sparse row form, one row per species, and
+ * multiplied with the rate vector row by row. The rate vector, the shared
+ * temporaries and the operand stack live in one buffer allocated with the
+ * network, so evaluating the right-hand side never allocates.
+ *
+ * For the Jacobian each rate is also compiled on its own and differentiated
+ * in forward mode with respect to just the species it reads, which is
+ * usually two or three. Every such partial lands on a fixed position of the
+ * sparse Jacobian, scaled by a stoichiometric coefficient; those positions
+ * are worked out once by rp_network_jacobian_init().
+ *
+ * @date 2025
+ */
+
+
+// --- library import --- //
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "program.h"
+
+struct rp_network {
+    rp_program *program; // every rate, one output per reaction
+    int nreactions;
+    int nspecies;
+    int *row_start; // nspecies + 1 offsets into reactions and values
+    int *reactions;
+    double *values;
+    double *rates; // nreactions rates, then the program's temporaries and operand stack
+    double *temps;
+    double *numstack;
+
+    // Jacobian, see rp_network_jacobian_init()
+    rp_program **reaction_programs; // each rate on its own
+    int *dep_start; // nreactions + 1 offsets into dep_species and partials
+    int *dep_species; // species each rate reads
+    int *seed_start; // nreactions offsets into seeds, one entry per slot of the rate's program
+    int *seeds; // derivative index of each slot, or -1
+    int *jac_row_start; // nspecies + 1 offsets into jac_columns
+    int *jac_columns;
+    int *scatter; // per stoichiometry nonzero and dependency of its reaction: position in the values
+    double *partials; // d rate / d species for each dependency
+    double *dual_work;
+};
+
+// first species row that is not well formed, or -1
+static int check_stoichiometry(int nspecies, const int *row_start, const int *reactions, int nreactions) {
+    if (row_start[0] != 0) return 0;
+    for (int i = 0; i < nspecies; ++i) {
+        if (row_start[i+1] < row_start[i]) return i;
+        for (int k = row_start[i]; k < row_start[i+1]; ++k) {
+            if (reactions[k] < 0 || reactions[k] >= nreactions) return i;
+        }
+    }
+    return -1;
+}
+
+rp_network *rp_network_create(const char *const *rates, int nreactions, const rp_symtab *symbols,
+                              int nspecies, const int *row_start, const int *reactions, const double *values,
+                              rp_error *error) {
+    rp_error local;
+    if (!error) error = &local;
+    error->status = RP_OK;
+    error->position = 0;
+    error->expression = 0;
+    int bad_row = nspecies < 0 ? 0 : check_stoichiometry(nspecies, row_start, reactions, nreactions);
+    if (bad_row >= 0) {
+        error->status = RP_ERR_STOICHIOMETRY;
+        error->position = bad_row;
+        return NULL;
+    }
+
+    rp_program *program = parser_compile_many(rates, nreactions, symbols, error);
+    if (!program) return NULL;
+    // the rates have compiled once already, so only allocation can fail here
+    rp_program **reaction_programs = calloc(nreactions, sizeof *reaction_programs);
+    for (int r = 0; reaction_programs && r < nreactions; ++r) {
+        reaction_programs[r] = parser_compile_symbols(rates[r], symbols, NULL);
+        if (!reaction_programs[r]) {
+            for (int k = 0; k < r; ++k) rp_program_free(reaction_programs[k]);
+            free(reaction_programs);
+            reaction_programs = NULL;
+        }
+    }
+
+    int nnz = row_start[nspecies];
+    rp_network *network = calloc(1, sizeof *network);
+    if (network) {
+        network->program = program;
+        network->reaction_programs = reaction_programs;
+        network->nreactions = nreactions;
+        network->nspecies = nspecies;
+        network->row_start = malloc((nspecies + 1) * sizeof *network->row_start);
+        network->reactions = malloc((nnz ? nnz : 1) * sizeof *network->reactions);
+        network->values = malloc((nnz ? nnz : 1) * sizeof *network->values);
+        network->rates = malloc((nreactions + program->ntemps + program->maxdepth) * sizeof *network->rates);
+    }
+    if (!network || !reaction_programs || !network->row_start || !network->reactions || !network->values
+        || !network->rates) {
+        if (!network) {
+            rp_program_free(program);
+            for (int r = 0; reaction_programs && r < nreactions; ++r) rp_program_free(reaction_programs[r]);
+            free(reaction_programs);
+        }
+        rp_network_free(network);
+        error->status = RP_ERR_NO_MEMORY;
+        return NULL;
+    }
+    memcpy(network->row_start, row_start, (nspecies + 1) * sizeof *row_start);
+    if (nnz) {
+        memcpy(network->reactions, reactions, nnz * sizeof *reactions);
+        memcpy(network->values, values, nnz * sizeof *values);
+    }
+    network->temps = network->rates + nreactions;
+    network->numstack = network->temps + program->ntemps;
+    return network;
+}
+
+void rp_network_rhs(rp_network *network, const double *vars, double *dxdt) {
+    const double *rates = network->rates;
+    eval_outputs(network->program, vars, network->temps, network->numstack, network->rates);
+    for (int i = 0; i < network->nspecies; ++i) {
+        double sum = 0.0;
+        for (int k = network->row_start[i]; k < network->row_start[i+1]; ++k) {
+            sum += network->values[k] * rates[network->reactions[k]];
+        }
+        dxdt[i] = sum;
+    }
+}
+
+const double *rp_network_rates(const rp_network *network) {
+    return network->rates;
+}
+
+int rp_network_species(const rp_network *network) {
+    return network->nspecies;
+}
+
+int rp_network_reactions(const rp_network *network) {
+    return network->nreactions;
+}
+
+int rp_network_native_compile(rp_network *network, const char *compiler) {
+    return rp_native_compile(network->program, compiler) ? 0 : -1;
+}
+
+static void jacobian_free(rp_network *network) {
+    free(network->dep_start);
+    free(network->dep_species);
+    free(network->seed_start);
+    free(network->seeds);
+    free(network->jac_row_start);
+    free(network->jac_columns);
+    free(network->scatter);
+    free(network->partials);
+    free(network->dual_work);
+    network->dep_start = network->dep_species = network->seed_start = network->seeds = NULL;
+    network->jac_row_start = network->jac_columns = network->scatter = NULL;
+    network->partials = network->dual_work = NULL;
+}
+
+// append the species bound to slot, once per stamp
+static inline void add_dependency(int slot, const int *slot_species, int *mark, int stamp,
+                                  int *species, int *count) {
+    if (slot < 0 || slot_species[slot] < 0 || mark[slot_species[slot]] == stamp) return;
+    mark[slot_species[slot]] = stamp;
+    species[(*count)++] = slot_species[slot];
+}
+
+// species read by a rate program, as variables or monomial factors
+static int rate_dependencies(const rp_program *program, const int *slot_species, int *mark, int stamp,
+                             int *species) {
+    int count = 0;
+    for (int i = 0; i < program->ncode; ++i) {
+        const Instruction *in = &program->code[i];
+        if (in->opcode == OPC_VAR) add_dependency(in->arg, slot_species, mark, stamp, species, &count);
+        if (in->opcode != OPC_MONOMIAL) continue;
+        const Monomial *term = &program->monomials.terms[in->arg];
+        for (int k = 0; k < term->nfactors; ++k) {
+            int slot = program->monomials.factors[term->first + k].operand;
+            add_dependency(slot, slot_species, mark, stamp, species, &count);
+        }
+    }
+    return count;
+}
+
+rp_status network_dependencies(const rp_network *network, const int *species_slots, int **dep_start,
+                               int **dep_species) {
+    int nspecies = network->nspecies, nreactions = network->nreactions;
+
+    // a rate depends on at most as many species as it has slots
+    int maxslot = 0;
+    size_t maxdeps = 0;
+    for (int r = 0; r < nreactions; ++r) {
+        int nvars = network->reaction_programs[r]->nvars;
+        maxdeps += nvars < nspecies ? nvars : nspecies;
+        if (nvars > maxslot) maxslot = nvars;
+    }
+    int *slot_species = malloc((maxslot + 1) * sizeof *slot_species);
+    int *mark = malloc((nspecies + 1) * sizeof *mark);
+    *dep_start = malloc((nreactions + 1) * sizeof **dep_start);
+    *dep_species = malloc((maxdeps + 1) * sizeof **dep_species);
+    int ok = slot_species && mark && *dep_start && *dep_species;
+
+    for (int v = 0; ok && v < maxslot; ++v) slot_species[v] = -1;
+    for (int i = 0; ok && i < nspecies; ++i) {
+        mark[i] = -1;
+        int slot = species_slots[i];
+        if (slot >= 0 && slot < maxslot) slot_species[slot] = i;
+    }
+    int ndeps = 0;
+    for (int r = 0; ok && r < nreactions; ++r) {
+        (*dep_start)[r] = ndeps;
+        ndeps += rate_dependencies(network->reaction_programs[r], slot_species, mark, r, *dep_species + ndeps);
+    }
+    free(slot_species);
+    free(mark);
+    if (!ok) {
+        free(*dep_start);
+        free(*dep_species);
+        *dep_start = *dep_species = NULL;
+        return RP_ERR_NO_MEMORY;
+    }
+    (*dep_start)[nreactions] = ndeps;
+    return RP_OK;
+}
+
+const rp_program *network_reaction_program(const rp_network *network, int reaction) {
+    return network->reaction_programs[reaction];
+}
+
+void network_stoichiometry(const rp_network *network, const int **row_start, const int **reactions,
+                           const double **values) {
+    *row_start = network->row_start;
+    *reactions = network->reactions;
+    *values = network->values;
+}
+
+rp_status rp_network_jacobian_init(rp_network *network, const int *species_slots) {
+    int nspecies = network->nspecies, nreactions = network->nreactions;
+    jacobian_free(network);
+
+    int nslots = 0;
+    for (int r = 0; r < nreactions; ++r) nslots += network->reaction_programs[r]->nvars;
+    int *mark = malloc((nspecies + 1) * sizeof *mark);
+    int *position = malloc((nspecies + 1) * sizeof *position);
+    network->seed_start = malloc(nreactions * sizeof *network->seed_start);
+    network->seeds = malloc((nslots + 1) * sizeof *network->seeds);
+    network->jac_row_start = malloc((nspecies + 1) * sizeof *network->jac_row_start);
+    int ok = mark && position && network->seed_start && network->seeds && network->jac_row_start
+          && network_dependencies(network, species_slots, &network->dep_start, &network->dep_species) == RP_OK;
+
+    // the forward-mode seed of each slot of each rate: the index of the species among its dependencies
+    size_t work = 0;
+    int nseeds = 0;
+    for (int r = 0; ok && r < nreactions; ++r) {
+        const rp_program *program = network->reaction_programs[r];
+        const int *deps = network->dep_species + network->dep_start[r];
+        int count = network->dep_start[r+1] - network->dep_start[r];
+        network->seed_start[r] = nseeds;
+        for (int v = 0; v < program->nvars; ++v) network->seeds[nseeds + v] = -1;
+        for (int j = 0; j < count; ++j) network->seeds[nseeds + species_slots[deps[j]]] = j;
+        nseeds += program->nvars;
+
+        size_t need = (size_t)(1 + count) * (program->maxdepth + program->ntemps);
+        if (need > work) work = need;
+    }
+    int ndeps = ok ? network->dep_start[nreactions] : 0;
+
+    // the Jacobian's row i is the union of the dependencies of the reactions changing species i
+    size_t nscatter = 0, nnz = 0;
+    for (int i = 0; ok && i < nspecies; ++i) {
+        for (int k = network->row_start[i]; k < network->row_start[i+1]; ++k) {
+            int r = network->reactions[k];
+            nscatter += network->dep_start[r+1] - network->dep_start[r];
+        }
+    }
+    if (ok) {
+        network->jac_columns = malloc((nscatter + 1) * sizeof *network->jac_columns);
+        network->scatter = malloc((nscatter + 1) * sizeof *network->scatter);
+        network->partials = malloc((ndeps + 1) * sizeof *network->partials);
+        network->dual_work = malloc((work ? work : 1) * sizeof *network->dual_work);
+        ok = network->jac_columns && network->scatter && network->partials && network->dual_work;
+    }
+    nscatter = 0;
+    for (int i = 0; ok && i < nspecies; ++i) mark[i] = -1;
+    for (int i = 0; ok && i < nspecies; ++i) {
+        network->jac_row_start[i] = (int)nnz;
+        for (int k = network->row_start[i]; k < network->row_start[i+1]; ++k) {
+            int r = network->reactions[k];
+            for (int j = network->dep_start[r]; j < network->dep_start[r+1]; ++j) {
+                int species = network->dep_species[j];
+                if (mark[species] != i) {
+                    mark[species] = i;
+                    position[species] = (int)nnz;
+                    network->jac_columns[nnz++] = species;
+                }
+                network->scatter[nscatter++] = position[species];
+            }
+        }
+    }
+    if (ok) network->jac_row_start[nspecies] = (int)nnz;
+
+    free(mark);
+    free(position);
+    if (!ok) {
+        jacobian_free(network);
+        return RP_ERR_NO_MEMORY;
+    }
+    return RP_OK;
+}
+
+int rp_network_jacobian_pattern(const rp_network *network, const int **row_start, const int **columns) {
+    if (!network->jac_row_start) return -1;
+    *row_start = network->jac_row_start;
+    *columns = network->jac_columns;
+    return network->jac_row_start[network->nspecies];
+}
+
+void rp_network_jacobian(rp_network *network, const double *vars, double *values) {
+    for (int r = 0; r < network->nreactions; ++r) {
+        int nd = network->dep_start[r+1] - network->dep_start[r];
+        eval_dual(network->reaction_programs[r], vars, network->seeds + network->seed_start[r], nd,
+                  network->dual_work, &network->rates[r], network->partials + network->dep_start[r]);
+    }
+
+    memset(values, 0, network->jac_row_start[network->nspecies] * sizeof *values);
+    const int *scatter = network->scatter;
+    for (int i = 0; i < network->nspecies; ++i) {
+        for (int k = network->row_start[i]; k < network->row_start[i+1]; ++k) {
+            int r = network->reactions[k];
+            double coefficient = network->values[k];
+            for (int j = network->dep_start[r]; j < network->dep_start[r+1]; ++j) {
+                values[*scatter++] += coefficient * network->partials[j];
+            }
+        }
+    }
+}
+
+void rp_network_free(rp_network *network) {
+    if (!network) return;
+    rp_program_free(network->program);
+    for (int r = 0; network->reaction_programs && r < network->nreactions; ++r) {
+        rp_program_free(network->reaction_programs[r]);
+    }
+    free(network->reaction_programs);
+    jacobian_free(network);
+    free(network->row_start);
+    free(network->reactions);
+    free(network->values);
+    free(network->rates);
+    free(network);
+}
@@ -0,0 +1,320 @@
+/**
+ * @file optimize.c
+ * @brief Algebraic simplification of compiled programs.
+ *
+ * The postfix program is rebuilt into an expression tree, simplifying each
+ * operator node as soon as its operands are known:
+ *   - constant subexpressions are folded with the interpreter's own eval
+ *     functions, so folding never changes a result
+ *   - identities are removed: x+0, 0+x, x-0, x*1, 1*x, x/1, x^1, and
+ *     0-x, -1*x, x*-1 become -x, x^0 becomes 1
+ *   - double negation -(-x) collapses to x
+ * The tree is then emitted back to postfix. No reassociation is done, so
+ * rounding is the same as evaluating the original expression. Operands of
+ * + and * are emitted deeper-subtree first (Sethi-Ullman order), which is
+ * exact and keeps right-nested sums and products at a constant stack depth.
+ *
+ * fuse_monomials() then turns mass-action products such as k1*A*B^2 into
+ * single instructions. This is the one pass that may change the last bit of
+ * a result: factors are multiplied left to right and small powers expanded
+ * into multiplications, where the original program applied pow() and the
+ * expression's grouping.
+ *
+ * @date 2025
+ */
+
+
+// --- library import --- //
+#include <stdlib.h>
+
+#include "parser.h"
+#include "program.h"
+
+typedef struct {
+    int opcode; // enum Opcode
+    int arg; // variable slot for OPC_VAR
+    double value; // OPC_CONST
+    int left; // operand node, -1 for loads
+    int right; // right operand of binary operators, -1 otherwise
+} Node;
+
+typedef struct {
+    Node *nodes;
+    int nnodes;
+    rp_compile_stats *stats;
+} Tree;
+
+static inline int new_node(Tree *t, int opcode, int arg, double value, int left, int right) {
+    Node *node = &t->nodes[t->nnodes];
+    node->opcode = opcode;
+    node->arg = arg;
+    node->value = value;
+    node->left = left;
+    node->right = right;
+    return t->nnodes++;
+}
+
+static inline int is_const(const Tree *t, int i, double value) {
+    return t->nodes[i].opcode == OPC_CONST && t->nodes[i].value == value;
+}
+
+/**
+ * @brief Create the node for opcode applied to simplified operands
+ * @return index of the node standing for the result, possibly an operand
+ */
+static int simplify_node(Tree *t, int opcode, int left, int right) {
+    const Node *l = &t->nodes[left];
+    const Node *r = right >= 0 ? &t->nodes[right] : NULL;
+
+    if (l->opcode == OPC_CONST && (!r || r->opcode == OPC_CONST)) {
+        t->stats->folded++;
+        return new_node(t, OPC_CONST, 0, eval_opcode(opcode, l->value, r ? r->value : 0), -1, -1);
+    }
+
+    switch (opcode) {
+        case OPC_NEG:
+            if (l->opcode == OPC_NEG) { t->stats->negations++; return l->left; }
+            break;
+        case OPC_ADD:
+            if (is_const(t, left, 0)) { t->stats->identities++; return right; }
+            if (is_const(t, right, 0)) { t->stats->identities++; return left; }
+            break;
+        case OPC_SUB:
+            if (is_const(t, right, 0)) { t->stats->identities++; return left; }
+            if (is_const(t, left, 0)) { t->stats->identities++; return simplify_node(t, OPC_NEG, right, -1); }
+            break;
+        case OPC_MUL:
+            if (is_const(t, left, 1)) { t->stats->identities++; return right; }
+            if (is_const(t, right, 1)) { t->stats->identities++; return left; }
+            if (is_const(t, left, -1)) { t->stats->identities++; return simplify_node(t, OPC_NEG, right, -1); }
+            if (is_const(t, right, -1)) { t->stats->identities++; return simplify_node(t, OPC_NEG, left, -1); }
+            break;
+        case OPC_DIV:
+            if (is_const(t, right, 1)) { t->stats->identities++; return left; }
+            break;
+        case OPC_POW:
+            if (is_const(t, right, 1)) { t->stats->identities++; return left; }
+            if (is_const(t, right, 0)) { t->stats->identities++; return new_node(t, OPC_CONST, 0, 1.0, -1, -1); }
+            break;
+    }
+    return new_node(t, opcode, 0, 0, left, right);
+}
+
+int optimize_code(Instruction *code, int *ncode, double *consts, int *nconsts,
+                  int *nvars, int *maxdepth, rp_compile_stats *stats) {
+    int n = *ncode;
+    Tree t = { malloc(2 * n * sizeof *t.nodes), 0, stats };
+    int *stack = malloc((2 * n + 1) * sizeof *stack);
+    int *need = malloc(2 * n * sizeof *need); // stack depth each node takes to evaluate
+    if (!t.nodes || !stack || !need) {
+        free(t.nodes);
+        free(stack);
+        free(need);
+        return EXIT_FAILURE;
+    }
+
+    // rebuild the tree; simplifications may add one node per instruction (0-x -> -x)
+    int depth = 0;
+    for (int i = 0; i < n; ++i) {
+        const Instruction *in = &code[i];
+        switch (in->opcode) {
+            case OPC_CONST: stack[depth++] = new_node(&t, OPC_CONST, 0, consts[in->arg], -1, -1); break;
+            case OPC_VAR: stack[depth++] = new_node(&t, OPC_VAR, in->arg, 0, -1, -1); break;
+            default:
+                if (opcode_arity(in->opcode) == 1) {
+                    stack[depth-1] = simplify_node(&t, in->opcode, stack[depth-1], -1);
+                    break;
+                }
+                depth--;
+                stack[depth-1] = simplify_node(&t, in->opcode, stack[depth-1], stack[depth]);
+                break;
+        }
+    }
+
+    // operands always precede their node, so one forward pass sees them first
+    for (int i = 0; i < t.nnodes; ++i) {
+        const Node *node = &t.nodes[i];
+        if (node->left < 0) {
+            need[i] = 1;
+        } else if (node->right < 0) {
+            need[i] = need[node->left];
+        } else {
+            int first = need[node->left], second = need[node->right];
+            if ((node->opcode == OPC_ADD || node->opcode == OPC_MUL) && second > first) {
+                first = need[node->right];
+                second = need[node->left];
+            }
+            need[i] = first > second ? first : second + 1;
+        }
+    }
+
+    /* emit postfix with an explicit stack; long sums make left-deep trees too
+       deep to recurse over. A negative entry marks a node whose operands are done */
+    int root = stack[0];
+    int *pending = stack, npending = 0;
+    int ncode_out = 0, nconsts_out = 0, nvars_out = 0;
+    depth = 0;
+    *maxdepth = 0;
+    pending[npending++] = root;
+    while (npending) {
+        int entry = pending[--npending];
+        int i = entry < 0 ? ~entry : entry;
+        const Node *node = &t.nodes[i];
+        Instruction *out = &code[ncode_out];
+
+        if (node->opcode == OPC_CONST) {
+            out->opcode = OPC_CONST;
+            consts[nconsts_out] = node->value;
+            out->arg = nconsts_out++;
+        } else if (node->opcode == OPC_VAR) {
+            out->opcode = OPC_VAR;
+            out->arg = node->arg;
+            if (node->arg >= nvars_out) nvars_out = node->arg + 1;
+        } else if (entry >= 0) {
+            pending[npending++] = ~i;
+            if (node->right >= 0 && (node->opcode == OPC_ADD || node->opcode == OPC_MUL)
+                && need[node->right] > need[node->left]) {
+                pending[npending++] = node->left;
+                pending[npending++] = node->right;
+            } else {
+                if (node->right >= 0) pending[npending++] = node->right;
+                pending[npending++] = node->left;
+            }
+            continue;
+        } else {
+            out->opcode = node->opcode;
+            out->arg = 0;
+            depth -= node->right >= 0 ? 2 : 1;
+        }
+        ncode_out++;
+        if (++depth > *maxdepth) *maxdepth = depth;
+    }
+
+    stats->eliminated += n - ncode_out;
+    *ncode = ncode_out;
+    *nconsts = nconsts_out;
+    *nvars = nvars_out;
+    free(t.nodes);
+    free(stack);
+    free(need);
+    return 0;
+}
+
+// what an operand on the fusion stack is made of
+enum { OPERAND_OTHER = 0, OPERAND_VAR, OPERAND_CONST, OPERAND_PRODUCT };
+
+typedef struct {
+    int begin; // first instruction computing the operand
+    int kind;
+} Operand;
+
+/* an operand is final once something other than a product consumes it;
+   products are fused over the instructions [begin, end] */
+static inline void close_operand(const Operand *operand, int end, int *fused_end, int *nterms) {
+    if (operand->kind != OPERAND_PRODUCT) return;
+    fused_end[operand->begin] = end;
+    (*nterms)++;
+}
+
+void fuse_monomials(rp_program *program, rp_compile_stats *stats) {
+    Instruction *code = program->code;
+    int n = program->ncode;
+    int *fused_end = malloc(n * sizeof *fused_end);
+    Operand *stack = malloc((program->maxdepth + 1) * sizeof *stack);
+    if (!fused_end || !stack) {
+        free(fused_end);
+        free(stack);
+        return;
+    }
+
+    // find maximal products: every operand of a * is a factor, ^ raises a variable to a constant
+    int depth = 0, nterms = 0;
+    for (int i = 0; i < n; ++i) {
+        const Instruction *in = &code[i];
+        fused_end[i] = -1;
+        switch (in->opcode) {
+            case OPC_CONST: stack[depth++] = (Operand){ i, OPERAND_CONST }; continue;
+            case OPC_VAR: stack[depth++] = (Operand){ i, OPERAND_VAR }; continue;
+            case OPC_LOAD: case OPC_MONOMIAL: stack[depth++] = (Operand){ i, OPERAND_OTHER }; continue;
+            case OPC_STORE:
+                close_operand(&stack[depth-1], i - 1, fused_end, &nterms);
+                stack[depth-1].kind = OPERAND_OTHER;
+                continue;
+            case OPC_OUTPUT:
+                depth--;
+                close_operand(&stack[depth], i - 1, fused_end, &nterms);
+                continue;
+        }
+        int arity = opcode_arity(in->opcode);
+        if (arity != 2) {
+            // functions and rate law kernels take their operands whole
+            for (int k = depth - arity; k < depth; ++k) {
+                close_operand(&stack[k], k + 1 < depth ? stack[k+1].begin - 1 : i - 1, fused_end, &nterms);
+            }
+            depth -= arity - 1;
+            stack[depth-1].kind = OPERAND_OTHER;
+            continue;
+        }
+        Operand *left = &stack[depth-2], *right = &stack[depth-1];
+        int kind = OPERAND_OTHER;
+        if (in->opcode == OPC_MUL && left->kind != OPERAND_OTHER && right->kind != OPERAND_OTHER) {
+            kind = OPERAND_PRODUCT;
+        } else if (in->opcode == OPC_POW && left->kind == OPERAND_VAR && right->kind == OPERAND_CONST
+                   && fusable_exponent(program->consts[code[right->begin].arg])) {
+            kind = OPERAND_PRODUCT;
+        } else {
+            close_operand(left, right->begin - 1, fused_end, &nterms);
+            close_operand(right, i - 1, fused_end, &nterms);
+        }
+        left->kind = kind;
+        depth--;
+    }
+    if (depth == 1) close_operand(&stack[0], n - 1, fused_end, &nterms);
+    free(stack);
+
+    MonomialTable *monomials = &program->monomials;
+    if (nterms) {
+        monomials->terms = malloc(nterms * sizeof *monomials->terms);
+        monomials->factors = malloc(n * sizeof *monomials->factors); // at most one per instruction
+    }
+    if (!nterms || !monomials->terms || !monomials->factors) {
+        free(monomials->terms);
+        free(monomials->factors);
+        monomials->terms = NULL;
+        monomials->factors = NULL;
+        free(fused_end);
+        return;
+    }
+
+    // rewrite each product as one instruction; its factors are its loads in order
+    int ncode = 0;
+    for (int i = 0; i < n; ++i) {
+        if (fused_end[i] < 0) {
+            code[ncode++] = code[i];
+            continue;
+        }
+        Monomial *term = &monomials->terms[monomials->nterms];
+        term->first = monomials->nfactors;
+        term->nfactors = 0;
+        for (int j = i; j <= fused_end[i]; ++j) {
+            if (code[j].opcode == OPC_MUL) continue;
+            Factor *factor = &monomials->factors[monomials->nfactors++];
+            factor->operand = code[j].opcode == OPC_VAR ? code[j].arg : ~code[j].arg;
+            factor->half_power = 2;
+            if (j + 2 <= fused_end[i] && code[j+2].opcode == OPC_POW) {
+                factor->half_power = (int)(2 * program->consts[code[j+1].arg]);
+                j += 2;
+            }
+            term->nfactors++;
+        }
+        code[ncode].opcode = OPC_MONOMIAL;
+        code[ncode++].arg = monomials->nterms++;
+        i = fused_end[i];
+    }
+    free(fused_end);
+
+    // a product now takes one stack slot however it was nested
+    program->ncode = ncode;
+    program->maxdepth = program_depth(code, ncode);
+    stats->monomials += nterms;
+}
@@ -8,7 +8,12 @@
  *   - Exponentiation: ^
  *   - Unary minus
  *   - Parentheses
- *   - Floating point numbers
+ *   - Built-in functions: exp, log, sqrt, abs, tanh, and min/max of two or more arguments
+ *   - Floating point numbers, with optional exponent (6.022e23)
+ *   - Named variables, resolved to slots of a caller-supplied symbol table
+ *
+ * Expressions are compiled once into a compact postfix program (see rp_program)
+ * which can then be evaluated any number of times without touching the string.
  *
  * Original implementation based on:
  *   - Shunting Yard Algorithm in C: https://literateprograms.org/shunting_yard_algorithm__c_.html
@@ -28,252 +33,1039 @@
 
 // --- library import --- //
 #include <math.h>
-#include <stdio.h> 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
-#include <threads.h>
+#include <limits.h>
 
 #include "parser.h"
+#include "program.h"
+#include "arena.h"
 
 // constants:
-#define MAXOPSTACK 64
-#define MAXNUMSTACK 64
-#define OP_MAX 128
-#define IS_DIGIT_OR_DECIMAL(c) ((c) == '.' || ((unsigned)((c) - '0') < 10))
+#define INLINE_TOKENS 256 // expressions up to this length parse without allocating
+#define MAX_EXPRESSION_LENGTH (INT_MAX / 2)
+#define BATCH_BLOCK 32 // rows evaluated per opcode dispatch in rp_eval_batch
+#define CACHE_LINE 64
+#define PARALLEL_MIN_ROWS 4096 // below this, thread start-up costs more than it saves
+#define MANY_LOCAL_TEMPS 256 // shared subexpressions kept on the C stack by rp_eval_many
+#define OP_MAX 256
+#define SYMTAB_MIN_BUCKETS 16
+#define MAX_DIGITS 19 // significant digits that fit a 64-bit mantissa
+#define MAX_EXPONENT 100000 // exponents are clamped here; far past any finite double
+#define ARITY_VARIADIC -1 // function taking two or more arguments
+#define IS_IDENT_START(c) ((c) == '_' || isalpha((unsigned char)(c)))
+#define IS_IDENT_CHAR(c) ((c) == '_' || isalnum((unsigned char)(c)))
 #define GET_OPERATOR(c) (op_lookup[(unsigned char)(c)])
 
-// -- Operator eval functions:
-static inline double eval_uminus(double arg1, double arg2) {return -arg1;}
-static inline double eval_exponent(double arg1, double arg2) {return pow(arg1, arg2);}
-static inline double eval_multiply(double arg1, double arg2) {return arg1*arg2;}
-static inline double eval_divide(double arg1, double arg2) {return arg1/arg2;}
-static inline double eval_add(double arg1, double arg2) {return arg1+arg2;}
-static inline double eval_subtract(double arg1, double arg2) {return arg1 -arg2;}
-static inline double eval_modulo(double arg1, double arg2) {return fmodf(arg1,arg2);}
-
 // -- Operator table details
-enum {ASSOC_NONE=0, ASSOC_LEFT, ASSOC_RIGHT}; 
+enum {ASSOC_NONE=0, ASSOC_LEFT, ASSOC_RIGHT};
 struct Operator {
     char operator; // string literal value
     int precedence; // i.e. PEMDAS
     int association; // handedness of operator
     int unary; // bool
     double (*eval)(double arg1, double arg2); //evaluation function
-} operators[] = {
-    {'_', 10, ASSOC_RIGHT, 1, eval_uminus},
-    {'^', 9, ASSOC_RIGHT, 0, eval_exponent},
-    {'*', 8, ASSOC_LEFT, 0, eval_multiply},
-    {'/', 8, ASSOC_LEFT, 0, eval_divide},
-    {'%', 8, ASSOC_LEFT, 0, eval_modulo},
-    {'+', 5, ASSOC_LEFT, 0, eval_add},
-    {'-', 5, ASSOC_LEFT, 0, eval_subtract},
-    {'(', 0, ASSOC_NONE, 0, NULL},
-    {')', 0, ASSOC_NONE, 0, NULL},
+    enum Opcode opcode; // instruction emitted when the operator is reduced
+    const char *name; // built-in functions only, NULL for operators
+    int arity; // arguments a function takes, or ARITY_VARIADIC
+};
+
+/* all parser tables are read-only after static initialization, so any
+   number of threads can parse at once */
+enum {OPI_UMINUS=0, OPI_POW, OPI_MUL, OPI_DIV, OPI_MOD, OPI_ADD, OPI_SUB, OPI_LPAREN, OPI_RPAREN,
+      OPI_COMMA, OPI_FUNCTIONS};
+/* functions are prefix operators binding tighter than anything else; they
+   sit below their '(' on the operator stack and are reduced by its ')' */
+static const struct Operator operators[] = {
+    {'_', 10, ASSOC_RIGHT, 1, eval_uminus, OPC_NEG},
+    {'^', 9, ASSOC_RIGHT, 0, eval_exponent, OPC_POW},
+    {'*', 8, ASSOC_LEFT, 0, eval_multiply, OPC_MUL},
+    {'/', 8, ASSOC_LEFT, 0, eval_divide, OPC_DIV},
+    {'%', 8, ASSOC_LEFT, 0, eval_modulo, OPC_MOD},
+    {'+', 5, ASSOC_LEFT, 0, eval_add, OPC_ADD},
+    {'-', 5, ASSOC_LEFT, 0, eval_subtract, OPC_SUB},
+    {'(', 0, ASSOC_NONE, 0, NULL, OPC_NONE},
+    {')', 0, ASSOC_NONE, 0, NULL, OPC_NONE},
+    {',', 0, ASSOC_NONE, 0, NULL, OPC_NONE},
+    // OPI_FUNCTIONS onwards
+    {'f', 11, ASSOC_RIGHT, 1, eval_exp, OPC_EXP, "exp", 1},
+    {'f', 11, ASSOC_RIGHT, 1, eval_log, OPC_LOG, "log", 1},
+    {'f', 11, ASSOC_RIGHT, 1, eval_sqrt, OPC_SQRT, "sqrt", 1},
+    {'f', 11, ASSOC_RIGHT, 1, eval_abs, OPC_ABS, "abs", 1},
+    {'f', 11, ASSOC_RIGHT, 1, eval_tanh, OPC_TANH, "tanh", 1},
+    {'f', 11, ASSOC_RIGHT, 0, eval_min, OPC_MIN, "min", ARITY_VARIADIC},
+    {'f', 11, ASSOC_RIGHT, 0, eval_max, OPC_MAX, "max", ARITY_VARIADIC},
+};
+#define NOPERATORS ((int)(sizeof operators / sizeof operators[0]))
+
+static const struct Operator startoperator = {'X', 0, ASSOC_NONE, 0, NULL, OPC_NONE};
+
+static const struct Operator *const op_lookup[OP_MAX] = {
+    ['_'] = &operators[OPI_UMINUS],
+    ['^'] = &operators[OPI_POW],
+    ['*'] = &operators[OPI_MUL],
+    ['/'] = &operators[OPI_DIV],
+    ['%'] = &operators[OPI_MOD],
+    ['+'] = &operators[OPI_ADD],
+    ['-'] = &operators[OPI_SUB],
+    ['('] = &operators[OPI_LPAREN],
+    [')'] = &operators[OPI_RPAREN],
+    [','] = &operators[OPI_COMMA],
 };
 
-static struct Operator startoperator = {'X', 0, ASSOC_NONE, 0, NULL};
-static thread_local struct Operator *op = NULL;
-static thread_local struct Operator *pop;
-static thread_local char *expr = NULL;
-static thread_local char *tstart = NULL;
+/* the built-in function called name, NULL if there is none */
+static const struct Operator *find_function(const char *name, size_t len) {
+    for (int i = OPI_FUNCTIONS; i < NOPERATORS; ++i) {
+        if (strncmp(operators[i].name, name, len) == 0 && operators[i].name[len] == '\0') return &operators[i];
+    }
+    return NULL;
+}
+
+// -- symbol table: names -> dense slots, open addressing on an FNV-1a hash
+struct rp_symtab {
+    char **names;
+    int count;
+    int capacity;
+    int *buckets; // slot index or -1
+    int nbuckets; // power of two
+};
 
-static struct Operator *op_lookup[OP_MAX];
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+#define FNV_STEP(h, c) (((h) ^ (unsigned char)(c)) * FNV_PRIME)
 
-static void init_operator_lookup(void) {
-    for (int i = 0; i < sizeof operators / sizeof operators[0]; ++i) {
-        op_lookup[operators[i].operator] = &operators[i];
+static inline unsigned int hash_name(const char *name, size_t len) {
+    unsigned int h = FNV_OFFSET;
+    for (size_t i = 0; i < len; ++i) h = FNV_STEP(h, name[i]);
+    return h;
+}
+
+/* the lexer hashes identifiers while scanning them, so lookups take the hash */
+static int symtab_lookup(const rp_symtab *symbols, const char *name, size_t len, unsigned int hash) {
+    unsigned int mask = symbols->nbuckets - 1;
+    for (unsigned int b = hash & mask; symbols->buckets[b] >= 0; b = (b + 1) & mask) {
+        const char *candidate = symbols->names[symbols->buckets[b]];
+        if (strncmp(candidate, name, len) == 0 && candidate[len] == '\0') return symbols->buckets[b];
     }
+    return -1;
+}
+
+static inline int symtab_find(const rp_symtab *symbols, const char *name, size_t len) {
+    return symtab_lookup(symbols, name, len, hash_name(name, len));
+}
+
+static int symtab_rehash(rp_symtab *symbols, int nbuckets) {
+    int *buckets = malloc(nbuckets * sizeof *buckets);
+    if (!buckets) return EXIT_FAILURE;
+    for (int b = 0; b < nbuckets; ++b) buckets[b] = -1;
+    for (int slot = 0; slot < symbols->count; ++slot) {
+        const char *name = symbols->names[slot];
+        unsigned int b = hash_name(name, strlen(name)) & (nbuckets - 1);
+        while (buckets[b] >= 0) b = (b + 1) & (nbuckets - 1);
+        buckets[b] = slot;
+    }
+    free(symbols->buckets);
+    symbols->buckets = buckets;
+    symbols->nbuckets = nbuckets;
+    return 0;
+}
+
+rp_symtab *rp_symtab_create(void) {
+    rp_symtab *symbols = calloc(1, sizeof *symbols);
+    if (!symbols) return NULL;
+    if (symtab_rehash(symbols, SYMTAB_MIN_BUCKETS)) {
+        free(symbols);
+        return NULL;
+    }
+    return symbols;
+}
+
+int rp_symtab_add(rp_symtab *symbols, const char *name) {
+    size_t len = strlen(name);
+    if (!len || !IS_IDENT_START(name[0])) return -1;
+    for (size_t i = 1; i < len; ++i) {
+        if (!IS_IDENT_CHAR(name[i])) return -1;
+    }
+
+    int slot = symtab_find(symbols, name, len);
+    if (slot >= 0) return slot;
+
+    // keep the load factor at or below one half
+    if (2 * (symbols->count + 1) > symbols->nbuckets
+        && symtab_rehash(symbols, 2 * symbols->nbuckets)) return -1;
+    if (symbols->count == symbols->capacity) {
+        int capacity = symbols->capacity ? 2 * symbols->capacity : 8;
+        char **names = realloc(symbols->names, capacity * sizeof *names);
+        if (!names) return -1;
+        symbols->names = names;
+        symbols->capacity = capacity;
+    }
+    char *copy = malloc(len + 1);
+    if (!copy) return -1;
+    memcpy(copy, name, len + 1);
+
+    slot = symbols->count++;
+    symbols->names[slot] = copy;
+    unsigned int b = hash_name(name, len) & (symbols->nbuckets - 1);
+    while (symbols->buckets[b] >= 0) b = (b + 1) & (symbols->nbuckets - 1);
+    symbols->buckets[b] = slot;
+    return slot;
+}
+
+int rp_symtab_find(const rp_symtab *symbols, const char *name) {
+    return symtab_find(symbols, name, strlen(name));
+}
+
+int rp_symtab_size(const rp_symtab *symbols) {
+    return symbols->count;
+}
+
+const char *rp_symtab_name(const rp_symtab *symbols, int slot) {
+    if (slot < 0 || slot >= symbols->count) return NULL;
+    return symbols->names[slot];
+}
+
+void rp_symtab_free(rp_symtab *symbols) {
+    if (!symbols) return;
+    for (int slot = 0; slot < symbols->count; ++slot) free(symbols->names[slot]);
+    free(symbols->names);
+    free(symbols->buckets);
+    free(symbols);
 }
 
 // -- stack manipulating functions
+/* Every instruction, constant and stacked operator comes from a distinct
+   byte of the expression, so its length bounds all of them. The buffers are
+   sized from it before parsing: short expressions use the inline arrays,
+   longer ones one arena allocation, and no push needs a bounds check. */
 typedef struct {
-    struct Operator *opstack[MAXOPSTACK];
+    const struct Operator **opstack;
+    const char **oppos; // where each stacked operator appeared, for errors
+    int *opdepth; // operand depth when each operator was stacked; counts function arguments
     int nopstack;
-    double numstack[MAXNUMSTACK];
-    int nnumstack;
+    // emitted postfix program; operands are tracked by depth only
+    Instruction *code;
+    int ncode;
+    double *consts;
+    int nconsts;
+    int nvars;
+    int depth;
+    int maxdepth;
+    // first error, reported relative to the start of the expression
+    rp_status status;
+    const char *errpos;
+    Arena arena; // buffers of expressions longer than INLINE_TOKENS
+    const struct Operator *opstack_inline[INLINE_TOKENS];
+    const char *oppos_inline[INLINE_TOKENS];
+    int opdepth_inline[INLINE_TOKENS];
+    Instruction code_inline[INLINE_TOKENS];
+    double consts_inline[INLINE_TOKENS];
 } ParserContext;
 
-static inline void push_opstack(ParserContext *ctx, struct Operator *op) 
-{
-    if (ctx->nopstack>MAXOPSTACK-1) {
-        fprintf(stderr, "ERROR: Operator stack overflow\n"); // use greater size for operator stack
-        exit(EXIT_FAILURE);
+/* records an error and returns it, so callers can `return fail(...)` */
+static inline rp_status fail(ParserContext *ctx, rp_status status, const char *at) {
+    ctx->status = status;
+    ctx->errpos = at;
+    return status;
+}
+
+/**
+ * @brief Point the context's buffers at storage for an expression of len bytes
+ * @return RP_OK, or an error if the expression is too long to allocate for
+ */
+static rp_status context_init(ParserContext *ctx, const char *expression, size_t len) {
+    ctx->arena.head = NULL;
+    ctx->opstack = ctx->opstack_inline;
+    ctx->oppos = ctx->oppos_inline;
+    ctx->opdepth = ctx->opdepth_inline;
+    ctx->code = ctx->code_inline;
+    ctx->consts = ctx->consts_inline;
+    if (len <= INLINE_TOKENS) return RP_OK;
+
+    if (len > MAX_EXPRESSION_LENGTH) return fail(ctx, RP_ERR_TOO_LONG, expression);
+    ctx->opstack = arena_alloc(&ctx->arena, len * sizeof *ctx->opstack);
+    ctx->oppos = arena_alloc(&ctx->arena, len * sizeof *ctx->oppos);
+    ctx->opdepth = arena_alloc(&ctx->arena, len * sizeof *ctx->opdepth);
+    ctx->code = arena_alloc(&ctx->arena, len * sizeof *ctx->code);
+    ctx->consts = arena_alloc(&ctx->arena, len * sizeof *ctx->consts);
+    if (!ctx->opstack || !ctx->oppos || !ctx->opdepth || !ctx->code || !ctx->consts) {
+        return fail(ctx, RP_ERR_NO_MEMORY, expression);
     }
-    ctx->opstack[ctx->nopstack++]=op; // increment operator stack 1 forward with operator argument 
+    return RP_OK;
 }
 
-static inline struct Operator *pop_opstack(ParserContext *ctx) {
+static inline void context_release(ParserContext *ctx) {
+    arena_free(&ctx->arena);
+}
 
-    if (!ctx->nopstack) {
-        fprintf(stderr, "ERROR: Operator stack empty\n");
-        exit(EXIT_FAILURE);
-        }
-    return ctx->opstack[--ctx->nopstack];
+static inline rp_status push_opstack(ParserContext *ctx, const struct Operator *op, const char *at)
+{
+    ctx->oppos[ctx->nopstack] = at;
+    ctx->opdepth[ctx->nopstack] = ctx->depth;
+    ctx->opstack[ctx->nopstack++]=op; // increment operator stack 1 forward with operator argument
+    return RP_OK;
+}
+
+static inline rp_status emit(ParserContext *ctx, enum Opcode opcode, int arg) {
+    ctx->code[ctx->ncode].opcode = opcode;
+    ctx->code[ctx->ncode].arg = arg;
+    ctx->ncode++;
+    return RP_OK;
+}
+
+/* replaces the eager operand push: a load is emitted and the operand stack
+   only tracks how deep it will get */
+static inline rp_status push_load(ParserContext *ctx, enum Opcode opcode, int arg) {
+    emit(ctx, opcode, arg);
+    if (++ctx->depth > ctx->maxdepth) ctx->maxdepth = ctx->depth;
+    return RP_OK;
+}
+
+static inline rp_status push_numstack(ParserContext *ctx, double operand) {
+    ctx->consts[ctx->nconsts] = operand;
+    return push_load(ctx, OPC_CONST, ctx->nconsts++);
+}
+
+static inline rp_status push_varstack(ParserContext *ctx, int slot) {
+    if (slot >= ctx->nvars) ctx->nvars = slot + 1;
+    return push_load(ctx, OPC_VAR, slot);
 }
 
-static inline void push_numstack(ParserContext *ctx, double operand) {
-    if (ctx->nnumstack>MAXNUMSTACK-1) {
-        fprintf(stderr, "ERROR: Operand stack overflow\n");
-        exit(EXIT_FAILURE);
+/* replaces the eager pop-evaluate-push: checks the operator on top of the
+   operator stack has its operands, pops it and emits its opcode */
+static inline rp_status reduce_operator(ParserContext *ctx) {
+    const struct Operator *pop = ctx->opstack[--ctx->nopstack];
+    const char *at = ctx->oppos[ctx->nopstack];
+    int arity = pop->unary ? 1 : 2;
+    if (pop->opcode == OPC_NONE) {
+        return fail(ctx, RP_ERR_UNMATCHED_OPEN, at);
     }
-    ctx->numstack[ctx->nnumstack++]=operand;
-    return;
+    if (ctx->depth < arity) {
+        return fail(ctx, RP_ERR_MISSING_OPERAND, at);
+    }
+    ctx->depth -= arity - 1;
+    return emit(ctx, pop->opcode, 0);
 }
 
-static inline double pop_numstack(ParserContext *ctx) {
-    if (!ctx->nnumstack) {
-        fprintf(stderr, "ERROR: Operand stack empty\n");
-        exit(EXIT_FAILURE);
+/* the ')' of a function call: each argument left one operand above the
+   depth the call started at; checks their count and emits the function */
+static inline rp_status reduce_function(ParserContext *ctx) {
+    const struct Operator *function = ctx->opstack[--ctx->nopstack];
+    const char *at = ctx->oppos[ctx->nopstack];
+    int nargs = ctx->depth - ctx->opdepth[ctx->nopstack];
+    if (function->arity == ARITY_VARIADIC ? nargs < 2 : nargs != function->arity) {
+        return fail(ctx, RP_ERR_ARGUMENT_COUNT, at);
     }
-    return ctx->numstack[--ctx->nnumstack];
+    // min(a, b, c) is min(min(a, b), c)
+    for (int k = function->unary ? 0 : 1; k < nargs; ++k) emit(ctx, function->opcode, 0);
+    ctx->depth -= nargs - 1;
+    return RP_OK;
 }
 
-static inline void shunt_operator(ParserContext *ctx, struct Operator *op) {
-    double n1, n2; // left and right operands
+static inline rp_status shunt_operator(ParserContext *ctx, const struct Operator *op, const char *at) {
 
-    //handle paranthesis by evaluating everything until the matching right parenthasis
+    //handle paranthesis by reducing everything until the matching right parenthasis
     if (op->operator=='(') {
-        push_opstack(ctx, op);
-        return;
-    } else if (op->operator==')') {
-        // evaluate subexpressions with parenthasis and push result as number to operand stack
+        return push_opstack(ctx, op, at);
+    } else if (op->operator==')' || op->operator==',') {
+        // emit subexpressions within parenthesis; their result stays on the operand stack
         while (ctx->nopstack > 0 && ctx->opstack[ctx->nopstack-1]->operator != '(') {
-            pop=pop_opstack(ctx); // retrieve current operator
-            n1=pop_numstack(ctx); //n1 becomes most recent operand
-            
-            // if unary-subtract found; handle as single operator
-            if (pop->unary) push_numstack(ctx, pop->eval(n1, 0));
-            else { // for all other operators:
-                n2=pop_numstack(ctx); // n2 is now equal to most recent value in numstack
-                push_numstack(ctx,pop->eval(n2, n1));
-            }
+            if (reduce_operator(ctx)) return ctx->status;
         }
-        // evaluate current operator, ensures not at parenthesis yet
-        if (!(pop=pop_opstack(ctx)) || pop->operator != '(') {
-
-            fprintf(stderr, "ERROR: Stack error. No matching \'(\'\n)");
-            exit(EXIT_FAILURE);
+        if (!ctx->nopstack) {
+            return fail(ctx, op->operator==')' ? RP_ERR_UNMATCHED_CLOSE : RP_ERR_SYNTAX, at);
         }
-        return;
+        int call = ctx->nopstack > 1 && ctx->opstack[ctx->nopstack-2]->name;
+        if (op->operator==',') {
+            // an argument separator, only valid directly inside a call
+            return call ? RP_OK : fail(ctx, RP_ERR_SYNTAX, at);
+        }
+        // drop the matching parenthesis
+        ctx->nopstack--;
+        return call ? reduce_function(ctx) : RP_OK;
     }
     if (op->association==ASSOC_RIGHT) {
         // handling exponents:
         while (ctx->nopstack && op->precedence < ctx->opstack[ctx->nopstack-1]->precedence) {
-            pop=pop_opstack(ctx); // retrieve operator function
-            n1=pop_numstack(ctx); // retrieve exponent operand value
-            if (pop->unary) push_numstack(ctx, pop->eval(n1, 0)); //decrement exponent operand
-            else {
-                n2=pop_numstack(ctx); // left-hand operand
-                push_numstack(ctx, pop->eval(n2, n1));
-            }
+            if (reduce_operator(ctx)) return ctx->status;
         }
     } else {
         // While the current operator does not take precedence over the former:
         while (ctx->nopstack && op->precedence <= ctx->opstack[ctx->nopstack-1]->precedence) {
-            pop=pop_opstack(ctx);
-            n1=pop_numstack(ctx);
-            if (pop->unary) push_numstack(ctx, pop->eval(n1, 0));
-            else {
-                n2=pop_numstack(ctx);
-                push_numstack(ctx, pop->eval(n2, n1));
-            }
+            if (reduce_operator(ctx)) return ctx->status;
         }
     }
-    push_opstack(ctx, op); 
+    return push_opstack(ctx, op, at);
 }
 
-enum TokenType { T_OPERATOR, T_NUMBER, T_WHITESPACE, T_INVALID };
-static inline enum TokenType classify_char(char c) {
-    if (IS_DIGIT_OR_DECIMAL(c)) return T_NUMBER;
-    if (isspace(c)) return T_WHITESPACE;
-    if (GET_OPERATOR(c)) return T_OPERATOR;
-    return T_INVALID;
-}
+// -- lexer: one table lookup per byte selects the scanner for the next token
+enum CharClass { CC_INVALID=0, CC_END, CC_SPACE, CC_DIGIT, CC_DOT, CC_IDENT, CC_EXPONENT, CC_OPERATOR };
+static const unsigned char char_class[256] = {
+    ['\0'] = CC_END,
+    [' '] = CC_SPACE, ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\v'] = CC_SPACE, ['\f'] = CC_SPACE, ['\r'] = CC_SPACE,
+    ['0' ... '9'] = CC_DIGIT,
+    ['.'] = CC_DOT,
+    ['A' ... 'Z'] = CC_IDENT, ['a' ... 'z'] = CC_IDENT, ['_'] = CC_IDENT,
+    ['e'] = CC_EXPONENT, ['E'] = CC_EXPONENT, // identifier characters that also mark an exponent
+    ['^'] = CC_OPERATOR, ['*'] = CC_OPERATOR, ['/'] = CC_OPERATOR, ['%'] = CC_OPERATOR,
+    ['+'] = CC_OPERATOR, ['-'] = CC_OPERATOR, ['('] = CC_OPERATOR, [')'] = CC_OPERATOR,
+    [','] = CC_OPERATOR,
+};
+#define CHAR_CLASS(c) (char_class[(unsigned char)(c)])
+#define CONTINUES_IDENT(c) (CHAR_CLASS(c) == CC_IDENT || CHAR_CLASS(c) == CC_EXPONENT || CHAR_CLASS(c) == CC_DIGIT)
+#define DIGIT_VALUE(c) ((unsigned)((unsigned char)(c) - '0')) // >= 10 for non-digits
 
-double parser(const char *expression) {
-    char *expr = expression;
-    double n1, n2;
+/**
+ * @brief Scan a decimal literal, converting it as the digits go by
+ *
+ * Accepts digits with an optional fraction and an optional exponent
+ * (1, 1.5, .5, 5., 2e-3). The first 19 significant digits are accumulated
+ * into an integer mantissa and rounded once by decimal_to_double(); longer
+ * literals and the rare cases it cannot decide are handed to strtod().
+ *
+ * @param value receives the number
+ * @return the first byte after the literal, or NULL if it has no digits
+ */
+static inline const char *scan_number(const char *s, double *value) {
+    const char *start = s;
+    uint64_t w = 0;
+    int digits = 0; // significant digits in w, leading zeros excluded
+    int q = 0; // power of ten applied to w
+    int seen = 0, truncated = 0;
+    unsigned int d;
+
+    for (; (d = DIGIT_VALUE(*s)) < 10; ++s, seen = 1) {
+        if (digits < MAX_DIGITS) {
+            w = 10 * w + d;
+            digits += w != 0;
+        } else {
+            q++;
+            truncated |= d != 0;
+        }
+    }
+    if (*s == '.') {
+        for (++s; (d = DIGIT_VALUE(*s)) < 10; ++s, seen = 1) {
+            if (digits < MAX_DIGITS) {
+                w = 10 * w + d;
+                digits += w != 0;
+                q--;
+            } else {
+                truncated |= d != 0;
+            }
+        }
+    }
+    if (!seen) return NULL;
+
+    // an 'e' not followed by exponent digits is left for the caller to reject
+    if (CHAR_CLASS(*s) == CC_EXPONENT) {
+        const char *e = s + 1;
+        int negative = *e == '-';
+        if (*e == '-' || *e == '+') e++;
+        if (DIGIT_VALUE(*e) < 10) {
+            int exponent = 0;
+            for (; (d = DIGIT_VALUE(*e)) < 10; ++e) {
+                if (exponent < MAX_EXPONENT) exponent = 10 * exponent + d;
+            }
+            q += negative ? -exponent : exponent;
+            s = e;
+        }
+    }
 
-    ParserContext ctx = {0};
+    if (truncated || !decimal_to_double(w, q, value)) *value = strtod(start, NULL);
+    return s;
+}
 
-    init_operator_lookup();
+/**
+ * @brief Tokenize an expression and emit its postfix program into ctx
+ *
+ * Each byte is classified once: its class picks the scanner, numbers are
+ * converted and identifiers hashed while they are scanned. Never exits or
+ * prints: the first error is recorded in ctx->status and ctx->errpos and
+ * returned. The context owns memory afterwards, release it with
+ * context_release() whatever the outcome.
+ *
+ * @param symbols table identifiers are resolved against, may be NULL
+ * @return RP_OK on success
+ */
+static rp_status compile_expression(ParserContext *ctx, const char *expression, const rp_symtab *symbols) {
+    const char *expr = expression;
 
     // --- reset stacks ---
-    ctx.nnumstack = 0;
-    ctx.nopstack = 0;
+    ctx->nopstack = 0;
+    ctx->ncode = 0;
+    ctx->nconsts = 0;
+    ctx->nvars = 0;
+    ctx->depth = 0;
+    ctx->maxdepth = 0;
+    ctx->status = RP_OK;
+    ctx->errpos = expression;
+    if (context_init(ctx, expression, strlen(expression))) return ctx->status;
 
-    struct Operator *lastoperator = &startoperator;
+    const struct Operator *op;
+    // NULL while the last token was an operand
+    const struct Operator *lastoperator = &startoperator;
 
     // main iteration loop:
-    for (expr = expression; *expr; ++expr) {
-        enum TokenType token = classify_char(*expr);
-        if (!tstart) {
-            if (token == T_OPERATOR) {
-                op=GET_OPERATOR(*expr);
-                if (lastoperator && (lastoperator == &startoperator || lastoperator->operator != ')')) {
-                    if (op->operator == '-') op = GET_OPERATOR('_');
-                    else if (op->operator != '(') {
-                        fprintf(
-                            stderr, 
-                            "ERROR: Illegal use of binary operator (%c)\n", 
-                            op->operator
-                        );
-                        exit(EXIT_FAILURE);
-                    }
+    for (;;) {
+        const char *tstart = expr;
+        enum CharClass kind = CHAR_CLASS(*expr);
+        if (kind == CC_END) break;
+
+        if (kind == CC_SPACE) {
+            expr++;
+            continue;
+        }
+        if (kind == CC_OPERATOR) {
+            op = GET_OPERATOR(*expr);
+            if (lastoperator && (lastoperator == &startoperator || lastoperator->operator != ')')) {
+                if (op->operator == '-') op = GET_OPERATOR('_');
+                else if (op->operator != '(') {
+                    return fail(ctx, RP_ERR_BINARY_OPERATOR, expr);
                 }
-                /* move the current operator to the operator stack
-                in priority order */
-                shunt_operator(&ctx, op);
-                lastoperator=op;
-            } else if (token == T_NUMBER) {
-                tstart = expr;
-            } else if (token == T_INVALID) {
-                fprintf(stderr, "ERROR: Syntax error %c \n", *expr);
-                return EXIT_FAILURE;
             }
+            /* move the current operator to the operator stack
+            in priority order */
+            if (shunt_operator(ctx, op, expr)) return ctx->status;
+            lastoperator = op;
+            expr++;
+            continue;
+        }
+        if (kind == CC_INVALID) {
+            return fail(ctx, RP_ERR_SYNTAX, expr);
+        }
+
+        // an operand straight after another operand or ')' has no operator joining them
+        if (!lastoperator || lastoperator->operator == ')') {
+            return fail(ctx, RP_ERR_MISSING_OPERATOR, expr);
+        }
+        if (kind == CC_DIGIT || kind == CC_DOT) {
+            double value;
+            expr = scan_number(expr, &value);
+            if (!expr) return fail(ctx, RP_ERR_SYNTAX, tstart);
+            if (push_numstack(ctx, value)) return ctx->status;
         } else {
-            if (token == T_WHITESPACE) {
-                push_numstack(&ctx, strtod(tstart, NULL));
-                tstart=NULL;
-                lastoperator=NULL;
-            } else if (token == T_OPERATOR) {
-                push_numstack(&ctx, strtod(tstart, NULL));
-                tstart=NULL;
-                op = GET_OPERATOR(*expr);
-                shunt_operator(&ctx, op);
-                lastoperator=op;
-            } else if (token != T_NUMBER) {
-                fprintf(stderr, "ERROR: Syntax error \n");
-                return EXIT_FAILURE;
+            unsigned int hash = FNV_OFFSET;
+            do {
+                hash = FNV_STEP(hash, *expr);
+                expr++;
+            } while (CONTINUES_IDENT(*expr));
+            // a name followed by '(' calls a built-in function
+            const char *next = expr;
+            while (CHAR_CLASS(*next) == CC_SPACE) next++;
+            const struct Operator *function = *next == '(' ? find_function(tstart, expr - tstart) : NULL;
+            if (function) {
+                if (shunt_operator(ctx, function, tstart)) return ctx->status;
+                lastoperator = function;
+                continue;
+            }
+            int slot = symbols ? symtab_lookup(symbols, tstart, expr - tstart, hash) : -1;
+            if (slot < 0) {
+                return fail(ctx, RP_ERR_UNKNOWN_IDENTIFIER, tstart);
             }
+            if (push_varstack(ctx, slot)) return ctx->status;
         }
+        // operands must be separated from a following operand by whitespace or an operator
+        if (CONTINUES_IDENT(*expr) || *expr == '.') {
+            return fail(ctx, RP_ERR_SYNTAX, expr);
+        }
+        lastoperator = NULL;
+    }
+    // After tokens are handled, reduce all remaining operators on top of the operator stack
+
+    while (ctx->nopstack > 0) {
+        if (reduce_operator(ctx)) return ctx->status;
+    }
+
+    // assertion method to ensure the program leaves exactly 1 value:
+    if (ctx->depth == 0) return fail(ctx, RP_ERR_EMPTY, expr);
+    if (ctx->depth != 1) return fail(ctx, RP_ERR_MISSING_OPERATOR, expr);
+    return RP_OK;
+}
+
+/**
+ * @brief Run a postfix program on the given operand stack.
+ *
+ * Operand counts were validated when the program was emitted and numstack
+ * holds the program's maxdepth values, so no bounds checks are needed here.
+ */
+static inline double run_program(const Instruction *code, int ncode, const double *consts,
+                                 const MonomialTable *monomials, const double *vars, double *temps,
+                                 double *out, double *numstack) {
+    int n = 0;
+
+    for (int i = 0; i < ncode; ++i) {
+        switch (code[i].opcode) {
+            case OPC_CONST: numstack[n++] = consts[code[i].arg]; break;
+            case OPC_VAR: numstack[n++] = vars[code[i].arg]; break;
+            case OPC_NEG: numstack[n-1] = eval_uminus(numstack[n-1], 0); break;
+            case OPC_POW: n--; numstack[n-1] = eval_exponent(numstack[n-1], numstack[n]); break;
+            case OPC_MUL: n--; numstack[n-1] = eval_multiply(numstack[n-1], numstack[n]); break;
+            case OPC_DIV: n--; numstack[n-1] = eval_divide(numstack[n-1], numstack[n]); break;
+            case OPC_MOD: n--; numstack[n-1] = eval_modulo(numstack[n-1], numstack[n]); break;
+            case OPC_ADD: n--; numstack[n-1] = eval_add(numstack[n-1], numstack[n]); break;
+            case OPC_SUB: n--; numstack[n-1] = eval_subtract(numstack[n-1], numstack[n]); break;
+            case OPC_MIN: n--; numstack[n-1] = eval_min(numstack[n-1], numstack[n]); break;
+            case OPC_MAX: n--; numstack[n-1] = eval_max(numstack[n-1], numstack[n]); break;
+            case OPC_EXP: numstack[n-1] = eval_exp(numstack[n-1], 0); break;
+            case OPC_LOG: numstack[n-1] = eval_log(numstack[n-1], 0); break;
+            case OPC_SQRT: numstack[n-1] = eval_sqrt(numstack[n-1], 0); break;
+            case OPC_ABS: numstack[n-1] = eval_abs(numstack[n-1], 0); break;
+            case OPC_TANH: numstack[n-1] = eval_tanh(numstack[n-1], 0); break;
+            case OPC_MONOMIAL: numstack[n++] = eval_monomial(monomials, code[i].arg, consts, vars); break;
+            case OPC_MICHAELIS:
+                n -= 2;
+                numstack[n-1] = eval_michaelis(numstack[n-1], numstack[n], numstack[n+1]);
+                break;
+            case OPC_HILL:
+                n -= 3;
+                numstack[n-1] = eval_hill(numstack[n-1], numstack[n], numstack[n+1], numstack[n+2], code[i].arg);
+                break;
+            case OPC_REVERSIBLE_MM:
+                n -= 5;
+                numstack[n-1] = eval_reversible_mm(numstack[n-1], numstack[n], numstack[n+1],
+                                                   numstack[n+2], numstack[n+3], numstack[n+4]);
+                break;
+            case OPC_STORE: temps[code[i].arg] = numstack[n-1]; break;
+            case OPC_LOAD: numstack[n++] = temps[code[i].arg]; break;
+            case OPC_OUTPUT: out[code[i].arg] = numstack[--n]; break;
+        }
+    }
+    return numstack[0];
+}
+
+// the threaded interpreter when the program has been translated, else the switch loop
+static inline double run_range(const rp_program *program, int begin, int end, const double *vars,
+                               double *temps, double *out, double *numstack) {
+    if (program->threaded) return vm_run(program, begin, end, vars, temps, out, numstack, NULL);
+    return run_program(program->code + begin, end - begin, program->consts, &program->monomials,
+                       vars, temps, out, numstack);
+}
+
+static const char *const status_messages[] = {
+    [RP_OK] = "no error",
+    [RP_ERR_SYNTAX] = "syntax error",
+    [RP_ERR_BINARY_OPERATOR] = "illegal use of binary operator",
+    [RP_ERR_MISSING_OPERAND] = "operator is missing an operand",
+    [RP_ERR_MISSING_OPERATOR] = "operands without an operator between them",
+    [RP_ERR_UNMATCHED_OPEN] = "no matching ')'",
+    [RP_ERR_UNMATCHED_CLOSE] = "no matching '('",
+    [RP_ERR_UNKNOWN_IDENTIFIER] = "unknown identifier",
+    [RP_ERR_EMPTY] = "empty expression",
+    [RP_ERR_TOO_LONG] = "expression too long",
+    [RP_ERR_NO_MEMORY] = "out of memory",
+    [RP_ERR_ARGUMENT_COUNT] = "wrong number of function arguments",
+    [RP_ERR_STOICHIOMETRY] = "malformed stoichiometry matrix",
+};
+
+const char *rp_strerror(rp_status status) {
+    if ((unsigned)status >= sizeof status_messages / sizeof status_messages[0]) return "unknown error";
+    return status_messages[status];
+}
+
+/* copies the outcome of a parse into the caller's error, if any */
+static inline rp_status report(rp_error *error, rp_status status, int position) {
+    if (error) {
+        error->status = status;
+        error->position = position;
+        error->expression = 0;
     }
-    // After tokens are handled, evaluate all remaining tokens on top of the operator stack
-    if (tstart){ push_numstack(&ctx, strtod(tstart, NULL)); tstart = NULL; }
+    return status;
+}
+
+rp_status parser_check(const char *expression, const rp_symtab *symbols, rp_error *error) {
+    ParserContext ctx;
+
+    compile_expression(&ctx, expression, symbols);
+    context_release(&ctx);
+    return report(error, ctx.status, (int)(ctx.errpos - expression));
+}
+
+rp_program *parser_compile(const char *expression) {
+    return parser_compile_symbols(expression, NULL, NULL);
+}
+
+rp_program *compile_program(const char *expression, const rp_symtab *symbols, rp_error *error) {
+    ParserContext ctx;
+
+    rp_compile_stats stats = {0};
+
+    if (compile_expression(&ctx, expression, symbols)) {
+        context_release(&ctx);
+        report(error, ctx.status, (int)(ctx.errpos - expression));
+        return NULL;
+    }
+    optimize_code(ctx.code, &ctx.ncode, ctx.consts, &ctx.nconsts, &ctx.nvars, &ctx.maxdepth, &stats);
+    stats.instructions = ctx.ncode;
+
+    rp_program *program = calloc(1, sizeof *program);
+    if (program) {
+        program->code = malloc(ctx.ncode * sizeof *program->code);
+        program->consts = malloc((ctx.nconsts ? ctx.nconsts : 1) * sizeof *program->consts);
+    }
+    if (!program || !program->code || !program->consts) {
+        context_release(&ctx);
+        rp_program_free(program);
+        report(error, RP_ERR_NO_MEMORY, 0);
+        return NULL;
+    }
+    memcpy(program->code, ctx.code, ctx.ncode * sizeof *program->code);
+    memcpy(program->consts, ctx.consts, ctx.nconsts * sizeof *program->consts);
+    context_release(&ctx);
+    program->ncode = ctx.ncode;
+    program->nconsts = ctx.nconsts;
+    program->nvars = ctx.nvars;
+    program->maxdepth = ctx.maxdepth;
+    program->noutputs = 1;
+    program->stats = stats;
+    report(error, RP_OK, 0);
+    return program;
+}
+
+rp_program *parser_compile_symbols(const char *expression, const rp_symtab *symbols, rp_error *error) {
+    rp_program *program = compile_program(expression, symbols, error);
+    if (program) {
+        match_rate_laws(program, &program->stats);
+        fuse_monomials(program, &program->stats);
+        program->stats.instructions = program->ncode;
+        vm_translate(program, &program->stats);
+    }
+    return program;
+}
+
+void rp_program_stats(const rp_program *program, rp_compile_stats *stats) {
+    *stats = program->stats;
+}
 
-    while (ctx.nopstack > 0) {
-        op=pop_opstack(&ctx);
-        n1=pop_numstack(&ctx);
-        if (op->unary) push_numstack(&ctx, op->eval(n1, 0));
-        else {
-            n2=pop_numstack(&ctx);
-            push_numstack(&ctx, op->eval(n2, n1));
+double rp_eval(const rp_program *program, const double *vars) {
+    if (program->noutputs != 1) return NAN;
+    if (program->native_scalar) return program->native_scalar(vars);
+    if (program->jit_scalar) return program->jit_scalar(vars);
+    if (program->ntemps) {
+        // a single expression from parser_compile_many() that shares subterms
+        double result;
+        rp_eval_many(program, vars, &result);
+        return result;
+    }
+    if (program->maxdepth <= MAXNUMSTACK) {
+        double numstack[MAXNUMSTACK];
+        return run_range(program, 0, program->ncode, vars, NULL, NULL, numstack);
+    }
+    // only programs nested deeper than any hand-written rate law get here
+    double *numstack = malloc(program->maxdepth * sizeof *numstack);
+    if (!numstack) return NAN;
+    double result = run_range(program, 0, program->ncode, vars, NULL, NULL, numstack);
+    free(numstack);
+    return result;
+}
+
+void rp_eval_many(const rp_program *program, const double *vars, double *out) {
+    if (program->noutputs == 1 && !program->ntemps) {
+        out[0] = rp_eval(program, vars);
+        return;
+    }
+    if (program->native_many) {
+        program->native_many(vars, out);
+        return;
+    }
+    double local[MANY_LOCAL_TEMPS];
+    double numstack_local[MAXNUMSTACK];
+    double *temps = program->ntemps > MANY_LOCAL_TEMPS ? malloc(program->ntemps * sizeof *temps) : local;
+    double *numstack = program->maxdepth > MAXNUMSTACK
+        ? malloc(program->maxdepth * sizeof *numstack) : numstack_local;
+    if (temps && numstack) {
+        double result = run_range(program, 0, program->ncode, vars, temps, out, numstack);
+        if (program->noutputs == 1) out[0] = result;
+    } else {
+        for (int k = 0; k < program->noutputs; ++k) out[k] = NAN;
+    }
+    if (temps != local) free(temps);
+    if (numstack != numstack_local) free(numstack);
+}
+
+void eval_outputs(const rp_program *program, const double *vars, double *temps, double *numstack, double *out) {
+    if (program->native_many) {
+        program->native_many(vars, out);
+        return;
+    }
+    double result = run_range(program, 0, program->ncode, vars, temps, out, numstack);
+    if (program->noutputs == 1) out[0] = result;
+}
+
+double eval_range(const rp_program *program, int begin, int end, const double *vars, double *temps,
+                  double *numstack, double *out) {
+    return run_range(program, begin, end, vars, temps, out, numstack);
+}
+
+void rp_program_bytecode(const rp_program *program, rp_bytecode *bytecode) {
+    bytecode->code = program->code;
+    bytecode->ncode = program->ncode;
+    bytecode->consts = program->consts;
+    bytecode->terms = program->monomials.terms;
+    bytecode->factors = program->monomials.factors;
+    bytecode->nvars = program->nvars;
+    bytecode->maxdepth = program->maxdepth;
+    bytecode->ntemps = program->ntemps;
+    bytecode->noutputs = program->noutputs;
+}
+
+int rp_program_outputs(const rp_program *program) {
+    return program->noutputs;
+}
+
+/**
+ * @brief Multiply dst by x^(half_power / 2) row by row, rounding like eval_power()
+ */
+static inline void block_power(double *dst, const double *x, int half_power, int m) {
+    double result[BATCH_BLOCK], base[BATCH_BLOCK];
+    if (half_power == 2) {
+        for (int j = 0; j < m; ++j) dst[j] *= x[j];
+        return;
+    }
+    for (int j = 0; j < m; ++j) {
+        result[j] = half_power & 1 ? sqrt(x[j]) : 1.0;
+        base[j] = x[j];
+    }
+    for (int p = half_power >> 1; p; p >>= 1) {
+        if (p & 1) for (int j = 0; j < m; ++j) result[j] *= base[j];
+        if (p > 1) for (int j = 0; j < m; ++j) base[j] *= base[j];
+    }
+    for (int j = 0; j < m; ++j) dst[j] *= result[j];
+}
+
+/**
+ * @brief Run a postfix program over a block of m <= BATCH_BLOCK rows.
+ *
+ * Each operand stack entry is a pointer to m contiguous values: variable
+ * loads point straight into the caller's columns, every other entry lives in
+ * the scratch row for its depth. Each opcode is a flat loop over the block
+ * which the compiler vectorizes to full AVX2 width. lanes and scratch hold
+ * the program's maxdepth entries.
+ */
+static inline void run_block(const Instruction *code, int ncode, const double *consts,
+                             const MonomialTable *monomials, const double *const *columns, size_t base, int m,
+                             const double **lanes, double (*scratch)[BATCH_BLOCK], double *out) {
+    int n = 0;
+
+    for (int i = 0; i < ncode; ++i) {
+        double *dst;
+        const double *a, *b;
+        switch (code[i].opcode) {
+            case OPC_CONST: {
+                double value = consts[code[i].arg];
+                dst = scratch[n];
+                for (int j = 0; j < m; ++j) dst[j] = value;
+                lanes[n++] = dst;
+                continue;
+            }
+            case OPC_VAR: lanes[n++] = columns[code[i].arg] + base; continue;
+            case OPC_MONOMIAL: {
+                const Monomial *term = &monomials->terms[code[i].arg];
+                const Factor *factors = monomials->factors + term->first;
+                dst = scratch[n];
+                for (int j = 0; j < m; ++j) dst[j] = 1.0;
+                for (int k = 0; k < term->nfactors; ++k) {
+                    int operand = factors[k].operand;
+                    if (operand >= 0) {
+                        block_power(dst, columns[operand] + base, factors[k].half_power, m);
+                    } else {
+                        double value = eval_power(consts[~operand], factors[k].half_power);
+                        for (int j = 0; j < m; ++j) dst[j] *= value;
+                    }
+                }
+                lanes[n++] = dst;
+                continue;
+            }
+            case OPC_MICHAELIS: {
+                const double *v = lanes[n-3], *s = lanes[n-2], *k = lanes[n-1];
+                dst = scratch[n-3];
+                for (int j = 0; j < m; ++j) dst[j] = eval_michaelis(v[j], s[j], k[j]);
+                n -= 2;
+                lanes[n-1] = dst;
+                continue;
+            }
+            case OPC_HILL: {
+                const double *v = lanes[n-4], *s = lanes[n-3], *k = lanes[n-2], *e = lanes[n-1];
+                int half_power = code[i].arg;
+                dst = scratch[n-4];
+                if (half_power) {
+                    double sn[BATCH_BLOCK], kn[BATCH_BLOCK];
+                    for (int j = 0; j < m; ++j) sn[j] = kn[j] = 1.0;
+                    block_power(sn, s, half_power, m);
+                    block_power(kn, k, half_power, m);
+                    for (int j = 0; j < m; ++j) dst[j] = eval_hill_powers(v[j], sn[j], kn[j]);
+                } else {
+                    for (int j = 0; j < m; ++j) dst[j] = eval_hill(v[j], s[j], k[j], e[j], 0);
+                }
+                n -= 3;
+                lanes[n-1] = dst;
+                continue;
+            }
+            case OPC_REVERSIBLE_MM: {
+                const double *vf = lanes[n-6], *s = lanes[n-5], *ks = lanes[n-4];
+                const double *vr = lanes[n-3], *p = lanes[n-2], *kp = lanes[n-1];
+                dst = scratch[n-6];
+                for (int j = 0; j < m; ++j) dst[j] = eval_reversible_mm(vf[j], s[j], ks[j], vr[j], p[j], kp[j]);
+                n -= 5;
+                lanes[n-1] = dst;
+                continue;
+            }
+            case OPC_NEG: case OPC_EXP: case OPC_LOG: case OPC_SQRT: case OPC_ABS: case OPC_TANH:
+                dst = scratch[n-1];
+                b = lanes[n-1];
+                switch (code[i].opcode) {
+                    case OPC_NEG: for (int j = 0; j < m; ++j) dst[j] = eval_uminus(b[j], 0); break;
+                    case OPC_EXP: for (int j = 0; j < m; ++j) dst[j] = eval_exp(b[j], 0); break;
+                    case OPC_LOG: for (int j = 0; j < m; ++j) dst[j] = eval_log(b[j], 0); break;
+                    case OPC_SQRT: for (int j = 0; j < m; ++j) dst[j] = eval_sqrt(b[j], 0); break;
+                    case OPC_ABS: for (int j = 0; j < m; ++j) dst[j] = eval_abs(b[j], 0); break;
+                    case OPC_TANH: for (int j = 0; j < m; ++j) dst[j] = eval_tanh(b[j], 0); break;
+                }
+                lanes[n-1] = dst;
+                continue;
+        }
+        // binary operators: the result replaces the left operand
+        dst = scratch[n-2];
+        a = lanes[n-2];
+        b = lanes[n-1];
+        switch (code[i].opcode) {
+            case OPC_POW: for (int j = 0; j < m; ++j) dst[j] = eval_exponent(a[j], b[j]); break;
+            case OPC_MUL: for (int j = 0; j < m; ++j) dst[j] = eval_multiply(a[j], b[j]); break;
+            case OPC_DIV: for (int j = 0; j < m; ++j) dst[j] = eval_divide(a[j], b[j]); break;
+            case OPC_MOD: for (int j = 0; j < m; ++j) dst[j] = eval_modulo(a[j], b[j]); break;
+            case OPC_ADD: for (int j = 0; j < m; ++j) dst[j] = eval_add(a[j], b[j]); break;
+            case OPC_SUB: for (int j = 0; j < m; ++j) dst[j] = eval_subtract(a[j], b[j]); break;
+            case OPC_MIN: for (int j = 0; j < m; ++j) dst[j] = eval_min(a[j], b[j]); break;
+            case OPC_MAX: for (int j = 0; j < m; ++j) dst[j] = eval_max(a[j], b[j]); break;
         }
+        lanes[--n - 1] = dst;
     }
+    for (int j = 0; j < m; ++j) out[j] = lanes[0][j];
+}
 
-    // assertion method to ensure final operand stack has 1 value:
-    if (ctx.nnumstack != 1) {
-        fprintf(stderr, "ERROR: Number stack has %d elements after evaluation (expected 1).\n", ctx.nnumstack);
-        fprintf(stderr, "Contents: [");
-        for (int i = 0; i < ctx.nnumstack; i++) {
-            fprintf(stderr, "%g", ctx.numstack[i]);
-            if (i < ctx.nnumstack - 1)
-                fprintf(stderr, ", ");
+/**
+ * @brief Evaluate rows [start, end) of a batch
+ *
+ * All mutable state is the scratch block on the calling thread's stack,
+ * aligned to a cache line so threads never share one. Programs deeper than
+ * MAXNUMSTACK take it from the heap instead, once per call rather than per
+ * block.
+ */
+static void eval_batch_range(const rp_program *program, const double *const *columns,
+                             size_t start, size_t end, double *out) {
+    double scratch_local[MAXNUMSTACK][BATCH_BLOCK] __attribute__((aligned(CACHE_LINE)));
+    const double *lanes_local[MAXNUMSTACK];
+    double (*scratch)[BATCH_BLOCK] = scratch_local;
+    const double **lanes = lanes_local;
+
+    size_t base = start;
+    if (program->noutputs != 1) {
+        for (size_t r = start; r < end; ++r) out[r] = NAN;
+        return;
+    }
+    if (program->native_batch) {
+        program->native_batch(columns, start, end, out);
+        return;
+    }
+    if (program->ntemps) {
+        // blocks keep no temporaries, so shared subterms are evaluated row by row
+        double *row = malloc((program->nvars ? program->nvars : 1) * sizeof *row);
+        for (size_t r = start; r < end; ++r) {
+            for (int i = 0; row && i < program->nvars; ++i) row[i] = columns[i][r];
+            out[r] = row ? rp_eval(program, row) : NAN;
         }
-        fprintf(stderr, "]\n");
-        return EXIT_FAILURE;
+        free(row);
+        return;
+    }
+    if (program->maxdepth > MAXNUMSTACK) {
+        scratch = aligned_alloc(CACHE_LINE, program->maxdepth * sizeof *scratch);
+        lanes = malloc(program->maxdepth * sizeof *lanes);
+        if (!scratch || !lanes) {
+            for (size_t r = start; r < end; ++r) out[r] = NAN;
+            free(scratch);
+            free(lanes);
+            return;
+        }
+    }
+    if (program->jit_batch) {
+        // native kernel takes whole groups of lanes, the interpreter the remainder
+        base = end - (end - start) % JIT_LANES;
+        if (base > start) program->jit_batch(columns, start, base, out);
+    }
+    for (; base + BATCH_BLOCK <= end; base += BATCH_BLOCK) {
+        run_block(program->code, program->ncode, program->consts, &program->monomials, columns, base,
+                  BATCH_BLOCK, lanes, scratch, out + base);
+    }
+    if (base < end) {
+        run_block(program->code, program->ncode, program->consts, &program->monomials, columns, base,
+                  (int)(end - base), lanes, scratch, out + base);
+    }
+    if (scratch != scratch_local) {
+        free(scratch);
+        free(lanes);
+    }
+}
+
+void rp_eval_batch(const rp_program *program, const double *const *columns, size_t n, double *out) {
+    eval_batch_range(program, columns, 0, n, out);
+}
+
+void rp_eval_batch_parallel(const rp_program *program, const double *const *columns, size_t n, double *out) {
+#ifdef _OPENMP
+    /* one contiguous chunk per thread, a whole number of blocks long so chunk
+       boundaries in out fall on cache line boundaries when out is aligned */
+    #pragma omp parallel if (n >= PARALLEL_MIN_ROWS)
+    {
+        size_t nthreads = (size_t)omp_get_num_threads();
+        size_t blocks = (n + BATCH_BLOCK - 1) / BATCH_BLOCK;
+        size_t chunk = (blocks + nthreads - 1) / nthreads * BATCH_BLOCK;
+        size_t start = (size_t)omp_get_thread_num() * chunk;
+        size_t end = start + chunk < n ? start + chunk : n;
+        if (start < end) eval_batch_range(program, columns, start, end, out);
     }
-    double result = ctx.numstack[0];
+#else
+    eval_batch_range(program, columns, 0, n, out);
+#endif
+}
+
+void rp_program_free(rp_program *program) {
+    if (!program) return;
+    jit_release(program);
+    native_release(program);
+    free(program->code);
+    free(program->consts);
+    free(program->monomials.terms);
+    free(program->monomials.factors);
+    free(program->threaded);
+    free(program->thread_start);
+    free(program);
+}
+
+rp_status parser_eval(const char *expression, double *result, rp_error *error) {
+    ParserContext ctx;
+
+    double local[MAXNUMSTACK];
+
+    if (compile_expression(&ctx, expression, NULL)) {
+        context_release(&ctx);
+        *result = NAN;
+        return report(error, ctx.status, (int)(ctx.errpos - expression));
+    }
+    double *numstack = ctx.maxdepth <= MAXNUMSTACK ? local : arena_alloc(&ctx.arena, ctx.maxdepth * sizeof *numstack);
+    if (!numstack) {
+        context_release(&ctx);
+        *result = NAN;
+        return report(error, RP_ERR_NO_MEMORY, 0);
+    }
+    *result = run_program(ctx.code, ctx.ncode, ctx.consts, NULL, NULL, NULL, NULL, numstack);
+    context_release(&ctx);
+    return report(error, RP_OK, 0);
+}
+
+double parser(const char *expression) {
+    double result;
+
+    parser_eval(expression, &result, NULL);
     return result;
 }
-    
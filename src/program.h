@@ -0,0 +1,356 @@
+/**
+ * @file program.h
+ * @brief Internal layout of compiled programs, shared by the evaluators in
+ *        parser.c and the native code generator in jit.c; the instruction
+ *        encoding itself is public, in bytecode.h.
+ *
+ * @date 2025
+ */
+#ifndef REACTIONPARSER_PROGRAM_H
+#define REACTIONPARSER_PROGRAM_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bytecode.h"
+#include "parser.h"
+#include "vecmath.h"
+
+#define MAXNUMSTACK 64
+
+// -- Operator eval functions:
+static inline double eval_uminus(double arg1, double arg2) {return -arg1;}
+static inline double eval_exponent(double arg1, double arg2) {return pow(arg1, arg2);}
+static inline double eval_multiply(double arg1, double arg2) {return arg1*arg2;}
+static inline double eval_divide(double arg1, double arg2) {return arg1/arg2;}
+static inline double eval_add(double arg1, double arg2) {return arg1+arg2;}
+static inline double eval_subtract(double arg1, double arg2) {return arg1 -arg2;}
+static inline double eval_modulo(double arg1, double arg2) {return fmodf(arg1,arg2);}
+// -- Built-in function eval functions; unary ones ignore arg2
+static inline double eval_min(double arg1, double arg2) {return arg1 < arg2 ? arg1 : arg2;}
+static inline double eval_max(double arg1, double arg2) {return arg1 > arg2 ? arg1 : arg2;}
+static inline double eval_exp(double arg1, double arg2) {return vm_exp(arg1);}
+static inline double eval_log(double arg1, double arg2) {return vm_log(arg1);}
+static inline double eval_sqrt(double arg1, double arg2) {return sqrt(arg1);}
+static inline double eval_abs(double arg1, double arg2) {return fabs(arg1);}
+static inline double eval_tanh(double arg1, double arg2) {return vm_tanh(arg1);}
+
+// operands an evaluating opcode pops: 1 for unary minus and the unary functions
+static inline int opcode_arity(int opcode) {
+    switch (opcode) {
+        case OPC_NEG: case OPC_EXP: case OPC_LOG: case OPC_SQRT: case OPC_ABS: case OPC_TANH:
+            return 1;
+        case OPC_MICHAELIS: return 3;
+        case OPC_HILL: return 4;
+        case OPC_REVERSIBLE_MM: return 6;
+    }
+    return 2;
+}
+
+// applies an evaluating opcode to known operands; arg2 is ignored for unary opcodes
+static inline double eval_opcode(int opcode, double arg1, double arg2) {
+    switch (opcode) {
+        case OPC_NEG: return eval_uminus(arg1, arg2);
+        case OPC_POW: return eval_exponent(arg1, arg2);
+        case OPC_MUL: return eval_multiply(arg1, arg2);
+        case OPC_DIV: return eval_divide(arg1, arg2);
+        case OPC_MOD: return eval_modulo(arg1, arg2);
+        case OPC_ADD: return eval_add(arg1, arg2);
+        case OPC_SUB: return eval_subtract(arg1, arg2);
+        case OPC_MIN: return eval_min(arg1, arg2);
+        case OPC_MAX: return eval_max(arg1, arg2);
+        case OPC_EXP: return eval_exp(arg1, arg2);
+        case OPC_LOG: return eval_log(arg1, arg2);
+        case OPC_SQRT: return eval_sqrt(arg1, arg2);
+        case OPC_ABS: return eval_abs(arg1, arg2);
+        case OPC_TANH: return eval_tanh(arg1, arg2);
+    }
+    return NAN;
+}
+
+/* fused products of powers, k*A^2*B^0.5: one instruction instead of a load,
+   a pow call and a multiply per factor */
+#define MONOMIAL_MAX_POWER 16 // largest exponent expanded into multiplications
+
+typedef struct {
+    Monomial *terms;
+    int nterms;
+    Factor *factors;
+    int nfactors;
+} MonomialTable;
+
+// exponents eval_power() handles: positive multiples of 1/2 up to MONOMIAL_MAX_POWER
+static inline int fusable_exponent(double exponent) {
+    return exponent > 0 && exponent <= MONOMIAL_MAX_POWER && 2 * exponent == (int)(2 * exponent);
+}
+
+/* x^(half_power / 2) by square-and-multiply, with sqrt for the half; every
+   evaluator multiplies in this order so they all round alike */
+static inline double eval_power(double x, int half_power) {
+    double result = half_power & 1 ? sqrt(x) : 1.0;
+    double base = x;
+    for (int p = half_power >> 1; p; p >>= 1) {
+        if (p & 1) result *= base;
+        base *= base;
+    }
+    return result;
+}
+
+// factors are multiplied left to right, as they appeared in the expression
+static inline double eval_monomial(const MonomialTable *monomials, int index,
+                                   const double *consts, const double *vars) {
+    const Monomial *term = &monomials->terms[index];
+    const Factor *factors = monomials->factors + term->first;
+    double result = 1.0;
+    for (int k = 0; k < term->nfactors; ++k) {
+        int operand = factors[k].operand;
+        result *= eval_power(operand >= 0 ? vars[operand] : consts[~operand], factors[k].half_power);
+    }
+    return result;
+}
+
+// -- rate law kernels; the arithmetic of the written-out law, minus its repeats
+static inline double eval_michaelis(double v, double s, double k) {
+    return v * s / (k + s);
+}
+
+// V*S^n/(K^n+S^n) from the powers
+static inline double eval_hill_powers(double v, double sn, double kn) {
+    return v * sn / (kn + sn);
+}
+
+static inline double eval_hill(double v, double s, double k, double n, int half_power) {
+    double sn = half_power ? eval_power(s, half_power) : eval_exponent(s, n);
+    double kn = half_power ? eval_power(k, half_power) : eval_exponent(k, n);
+    return eval_hill_powers(v, sn, kn);
+}
+
+static inline double eval_reversible_mm(double vf, double s, double ks, double vr, double p, double kp) {
+    return (vf * s / ks - vr * p / kp) / (1 + s / ks + p / kp);
+}
+
+/* native batch kernel: evaluates rows [start, end) of the columns, end - start
+   a multiple of JIT_LANES */
+#define JIT_LANES 4
+typedef void (*jit_batch_kernel)(const double *const *columns, size_t start, size_t end, double *out);
+
+/* first instruction of the subexpression ending at each instruction in
+   [from, to), given begin for the instructions before from; a store belongs
+   to the value it keeps */
+static inline void subexpression_begin(const Instruction *code, int from, int to, int *begin) {
+    for (int i = from; i < to; ++i) {
+        switch (code[i].opcode) {
+            case OPC_CONST: case OPC_VAR: case OPC_LOAD: case OPC_MONOMIAL: case OPC_OUTPUT:
+                begin[i] = i;
+                break;
+            case OPC_STORE:
+                begin[i] = begin[i-1];
+                break;
+            default: {
+                int first = i;
+                for (int k = opcode_arity(code[i].opcode); k > 0; --k) first = begin[first-1];
+                begin[i] = first;
+                break;
+            }
+        }
+    }
+}
+
+// stack depth a program reaches
+static inline int program_depth(const Instruction *code, int ncode) {
+    int depth = 0, maxdepth = 0;
+    for (int i = 0; i < ncode; ++i) {
+        switch (code[i].opcode) {
+            case OPC_CONST: case OPC_VAR: case OPC_LOAD: case OPC_MONOMIAL: depth++; break;
+            case OPC_STORE: break;
+            case OPC_OUTPUT: depth--; break;
+            default: depth -= opcode_arity(code[i].opcode) - 1; break;
+        }
+        if (depth > maxdepth) maxdepth = depth;
+    }
+    return maxdepth;
+}
+
+/* threaded code (vm.c): the address of the instruction's handler and its
+   operand, constants inlined from the pool */
+typedef struct {
+    const void *handler;
+    union {
+        double value; // constant loads
+        int arg; // everything else, as in Instruction
+    };
+} VMInstruction;
+
+// -- compiled program
+struct rp_program {
+    Instruction *code;
+    int ncode;
+    double *consts;
+    int nconsts;
+    int nvars; // one past the highest variable slot read
+    int maxdepth; // deepest operand stack reached during evaluation
+    int noutputs; // 1 for single expressions, which leave their result on the stack
+    int ntemps; // shared subexpressions of a multi-expression program
+    MonomialTable monomials;
+    rp_compile_stats stats;
+    // threaded code ending in a halt; NULL if translation ran out of memory
+    VMInstruction *threaded;
+    int *thread_start; // ncode + 1 offsets into threaded, one per instruction
+    // native code from rp_jit_compile(), NULL until compiled or if unsupported
+    void *jit_page;
+    size_t jit_size;
+    rp_jit_fn jit_scalar;
+    jit_batch_kernel jit_batch;
+    // shared object from rp_native_compile(), NULL until compiled
+    void *native_handle;
+    rp_native_fn native_many;
+    rp_jit_fn native_scalar; // single expressions only, as is native_batch
+    jit_batch_kernel native_batch;
+};
+
+/**
+ * @brief Simplify a postfix program in place (optimize.c)
+ *
+ * Folds constant subexpressions, removes identity operations and collapses
+ * double negation, then re-emits the program and its constant pool. The
+ * program can only get shorter, so the arrays are reused.
+ *
+ * @param nvars, maxdepth updated for the simplified program
+ * @param stats receives the simplification counters
+ * @return 0 on success, EXIT_FAILURE if out of memory (program unchanged)
+ */
+int optimize_code(Instruction *code, int *ncode, double *consts, int *nconsts,
+                  int *nvars, int *maxdepth, rp_compile_stats *stats);
+
+/**
+ * @brief Replace products of variables, constants and their powers by
+ *        OPC_MONOMIAL instructions (optimize.c)
+ *
+ * A product is fused when its operands are all variables, constants, or a
+ * variable raised to a constant exponent that is a positive multiple of 1/2
+ * up to MONOMIAL_MAX_POWER. Values stored for reuse with OPC_STORE are never
+ * absorbed into a larger product. The program gets shorter and maxdepth can
+ * only drop, so it is rewritten in place; on allocation failure it is left
+ * unfused, which is still correct.
+ *
+ * @param stats receives the number of fused monomials
+ */
+void fuse_monomials(rp_program *program, rp_compile_stats *stats);
+
+/**
+ * @brief Replace written-out standard rate laws by kernel opcodes (ratelaw.c)
+ *
+ * Runs before fuse_monomials(), which would otherwise take the products
+ * apart. The program only gets shorter and is rewritten in place; on
+ * allocation failure it is left as it was.
+ *
+ * @param stats receives the number of each law found
+ */
+void match_rate_laws(rp_program *program, rp_compile_stats *stats);
+
+/**
+ * @brief Translate a finished program into threaded code for vm_run() (vm.c)
+ *
+ * Call after the last pass that rewrites the code. On allocation failure
+ * the program is left without threaded code and keeps running on the
+ * switch loop, which is still correct.
+ *
+ * @param stats receives the number of superinstructions
+ * @return 0 on success, EXIT_FAILURE if out of memory
+ */
+int vm_translate(rp_program *program, rp_compile_stats *stats);
+
+/**
+ * @brief Run the instructions [begin, end) of a translated program (vm.c)
+ *
+ * begin and end must not split a superinstruction; the start of the program,
+ * its end and the instruction after any OPC_OUTPUT never do.
+ *
+ * @param numstack maxdepth values
+ * @param labels NULL; vm_translate() passes a NULL program to fetch the
+ *        handler addresses through it
+ * @return the value of a single expression
+ */
+double vm_run(const rp_program *program, int begin, int end, const double *vars, double *temps,
+              double *out, double *numstack, const void *const **labels);
+
+/**
+ * @brief Compile and simplify one expression without fusing monomials, for
+ *        passes that need to see every multiplication (parser.c)
+ */
+rp_program *compile_program(const char *expression, const rp_symtab *symbols, rp_error *error);
+
+/**
+ * @brief Evaluate every output of a program into out, with the caller's
+ *        temporaries (ntemps values) and operand stack (maxdepth values) (parser.c)
+ */
+void eval_outputs(const rp_program *program, const double *vars, double *temps, double *numstack, double *out);
+
+/**
+ * @brief Run the instructions [begin, end) of a program on the interpreter,
+ *        with the caller's temporaries and operand stack (parser.c)
+ * @return the value left at the bottom of the stack
+ */
+double eval_range(const rp_program *program, int begin, int end, const double *vars, double *temps,
+                  double *numstack, double *out);
+
+/**
+ * @brief Evaluate a program on dual numbers (autodiff.c)
+ *
+ * @param seed for each variable slot below nvars, the index of the
+ *        derivative it is seeded in, or -1
+ * @param nd number of derivatives carried
+ * @param work (1 + nd) * (maxdepth + ntemps) doubles
+ * @param values receives one value per output
+ * @param gradients receives nd derivatives per output
+ */
+void eval_dual(const rp_program *program, const double *vars, const int *seed, int nd,
+               double *work, double *values, double *gradients);
+
+/**
+ * @brief Species each rate of a network reads, as variables or monomial
+ *        factors (network.c)
+ *
+ * @param species_slots variable slot of each species
+ * @param dep_start receives nreactions + 1 offsets into dep_species
+ * @param dep_species receives the species of each reaction, each once
+ * @return RP_OK, or RP_ERR_NO_MEMORY with both arrays NULL; the caller
+ *         frees them
+ */
+rp_status network_dependencies(const rp_network *network, const int *species_slots, int **dep_start,
+                               int **dep_species);
+
+/**
+ * @brief A network's rate of one reaction compiled on its own (network.c)
+ */
+const rp_program *network_reaction_program(const rp_network *network, int reaction);
+
+/**
+ * @brief A network's stoichiometry matrix in compressed sparse row form, one
+ *        row per species (network.c)
+ */
+void network_stoichiometry(const rp_network *network, const int **row_start, const int **reactions,
+                           const double **values);
+
+/**
+ * @brief Release the native code attached to a program, if any
+ */
+void jit_release(rp_program *program);
+
+/**
+ * @brief Unload the shared object attached to a program, if any (codegen.c)
+ */
+void native_release(rp_program *program);
+
+/**
+ * @brief Round w * 10^q to the nearest double (decimal.c)
+ *
+ * @param w significant digits of a literal, at most 19
+ * @param q power of ten applied to w
+ * @return 1 with *value set, or 0 when the fast path cannot decide and the
+ *         caller must convert the text with strtod()
+ */
+int decimal_to_double(uint64_t w, int q, double *value);
+
+#endif // REACTIONPARSER_PROGRAM_H
@@ -0,0 +1,232 @@
+/**
+ * @file ratelaw.c
+ * @brief Recognition of standard rate laws, evaluated by fused kernels.
+ *
+ * Model exports write the common rate laws out in full. After simplification
+ * the postfix program is scanned for three shapes, and each match becomes one
+ * kernel instruction popping the law's parameters:
+ *   - Michaelis-Menten   V*S/(K+S)                           V S K            OPC_MICHAELIS
+ *   - Hill               V*S^n/(K^n+S^n)                     V S K n          OPC_HILL
+ *   - reversible MM      (Vf*S/Ks - Vr*P/Kp)/(1+S/Ks+P/Kp)   Vf S Ks Vr P Kp  OPC_REVERSIBLE_MM
+ *
+ * Parameters may be any subexpressions, which must be written identically
+ * where the law repeats them; operands of + and * match in either order. A
+ * kernel does the written arithmetic in the same order, less the repeats: S
+ * and the other parameters are evaluated once and S^n is raised once, so the
+ * results do not change. A Hill coefficient that is a constant multiple of 1/2
+ * is raised by multiplication like a fused monomial's power.
+ *
+ * Programs from parser_compile_many() keep shared values with OPC_STORE;
+ * regions containing a store are left alone, as moving the parameters
+ * around could put a reload before it.
+ *
+ * @date 2025
+ */
+
+
+// --- library import --- //
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "program.h"
+
+typedef struct {
+    Instruction *code;
+    const double *consts;
+    int *begin; // first instruction of the subexpression ending at each instruction
+} Postfix;
+
+// record where the subexpressions ending in [from, to) begin
+static inline void fill_begin(Postfix *p, int from, int to) {
+    subexpression_begin(p->code, from, to, p->begin);
+}
+
+// subexpressions computing the operands of the instruction at root, in order
+static void operands(const Postfix *p, int root, int arity, int *roots) {
+    int end = root - 1;
+    for (int k = arity - 1; k >= 0; --k) {
+        roots[k] = end;
+        end = p->begin[end] - 1;
+    }
+}
+
+static inline int is_op(const Postfix *p, int root, int opcode) {
+    return p->code[root].opcode == opcode;
+}
+
+// whether two subexpressions are written identically
+static int same(const Postfix *p, int a, int b) {
+    int length = a - p->begin[a];
+    if (length != b - p->begin[b]) return 0;
+    for (int k = 0; k <= length; ++k) {
+        const Instruction *x = &p->code[a-k], *y = &p->code[b-k];
+        if (x->opcode != y->opcode) return 0;
+        if (x->opcode == OPC_CONST) {
+            if (memcmp(&p->consts[x->arg], &p->consts[y->arg], sizeof(double)) != 0) return 0;
+        } else if (x->arg != y->arg) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// V*S^n/(K^n+S^n): fills V S K n
+static int match_hill(const Postfix *p, const int *fraction, int *params) {
+    if (!is_op(p, fraction[0], OPC_MUL) || !is_op(p, fraction[1], OPC_ADD)) return 0;
+    int product[2], sum[2];
+    operands(p, fraction[0], 2, product);
+    operands(p, fraction[1], 2, sum);
+    for (int x = 0; x < 2; ++x) {
+        if (!is_op(p, product[x], OPC_POW)) continue;
+        int power[2];
+        operands(p, product[x], 2, power);
+        for (int y = 0; y < 2; ++y) {
+            if (!is_op(p, sum[y], OPC_POW) || !is_op(p, sum[1-y], OPC_POW)) continue;
+            int kpower[2], spower[2];
+            operands(p, sum[1-y], 2, kpower);
+            operands(p, sum[y], 2, spower);
+            if (!same(p, spower[0], power[0]) || !same(p, spower[1], power[1])
+                || !same(p, kpower[1], power[1])) {
+                continue;
+            }
+            params[0] = product[1-x];
+            params[1] = power[0];
+            params[2] = kpower[0];
+            params[3] = power[1];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// V*S/(K+S): fills V S K
+static int match_michaelis(const Postfix *p, const int *fraction, int *params) {
+    if (!is_op(p, fraction[0], OPC_MUL) || !is_op(p, fraction[1], OPC_ADD)) return 0;
+    int product[2], sum[2];
+    operands(p, fraction[0], 2, product);
+    operands(p, fraction[1], 2, sum);
+    for (int x = 0; x < 2; ++x) {
+        for (int y = 0; y < 2; ++y) {
+            if (!same(p, product[x], sum[y])) continue;
+            params[0] = product[1-x];
+            params[1] = product[x];
+            params[2] = sum[1-y];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// V*S/K with S/K given: fills V
+static int match_scaled(const Postfix *p, int root, const int *ratio, int *v) {
+    if (!is_op(p, root, OPC_DIV)) return 0;
+    int quotient[2], product[2];
+    operands(p, root, 2, quotient);
+    if (!is_op(p, quotient[0], OPC_MUL) || !same(p, quotient[1], ratio[1])) return 0;
+    operands(p, quotient[0], 2, product);
+    for (int x = 0; x < 2; ++x) {
+        if (!same(p, product[x], ratio[0])) continue;
+        *v = product[1-x];
+        return 1;
+    }
+    return 0;
+}
+
+// (Vf*S/Ks - Vr*P/Kp)/(1 + S/Ks + P/Kp): fills Vf S Ks Vr P Kp
+static int match_reversible(const Postfix *p, const int *fraction, int *params) {
+    if (!is_op(p, fraction[0], OPC_SUB) || !is_op(p, fraction[1], OPC_ADD)) return 0;
+    int difference[2], outer[2], inner[2];
+    operands(p, fraction[0], 2, difference);
+    operands(p, fraction[1], 2, outer);
+    // (1 + S/Ks) + P/Kp, each sum in either order
+    int x = is_op(p, outer[0], OPC_ADD) ? 0 : 1;
+    if (!is_op(p, outer[x], OPC_ADD) || !is_op(p, outer[1-x], OPC_DIV)) return 0;
+    operands(p, outer[x], 2, inner);
+    int y = is_op(p, inner[0], OPC_CONST) ? 0 : 1;
+    if (!is_op(p, inner[y], OPC_CONST) || p->consts[p->code[inner[y]].arg] != 1.0
+        || !is_op(p, inner[1-y], OPC_DIV)) {
+        return 0;
+    }
+    int forward[2], reverse[2];
+    operands(p, inner[1-y], 2, forward);
+    operands(p, outer[1-x], 2, reverse);
+    if (!match_scaled(p, difference[0], forward, &params[0])
+        || !match_scaled(p, difference[1], reverse, &params[3])) {
+        return 0;
+    }
+    params[1] = forward[0];
+    params[2] = forward[1];
+    params[4] = reverse[0];
+    params[5] = reverse[1];
+    return 1;
+}
+
+/**
+ * @brief Replace the division at root by a kernel if it is a rate law
+ * @return end of the rewritten program
+ */
+static int rewrite(Postfix *p, int root, Instruction *scratch, rp_compile_stats *stats) {
+    int fraction[2], params[6], arg = 0, opcode;
+    operands(p, root, 2, fraction);
+    if (match_hill(p, fraction, params)) {
+        opcode = OPC_HILL;
+        if (params[3] == p->begin[params[3]] && is_op(p, params[3], OPC_CONST)) {
+            double n = p->consts[p->code[params[3]].arg];
+            if (fusable_exponent(n)) arg = (int)(2 * n);
+        }
+    } else if (match_michaelis(p, fraction, params)) {
+        opcode = OPC_MICHAELIS;
+    } else if (match_reversible(p, fraction, params)) {
+        opcode = OPC_REVERSIBLE_MM;
+    } else {
+        return root + 1;
+    }
+
+    int start = p->begin[root];
+    for (int i = start; i < root; ++i) {
+        if (p->code[i].opcode == OPC_STORE) return root + 1;
+    }
+
+    int length = 0;
+    for (int k = 0; k < opcode_arity(opcode); ++k) {
+        int begin = p->begin[params[k]];
+        memcpy(scratch + length, p->code + begin, (params[k] + 1 - begin) * sizeof *scratch);
+        length += params[k] + 1 - begin;
+    }
+    scratch[length].opcode = opcode;
+    scratch[length++].arg = arg;
+    memcpy(p->code + start, scratch, length * sizeof *scratch);
+    fill_begin(p, start, start + length);
+
+    switch (opcode) {
+        case OPC_MICHAELIS: stats->michaelis_menten++; break;
+        case OPC_HILL: stats->hill++; break;
+        case OPC_REVERSIBLE_MM: stats->reversible_mm++; break;
+    }
+    return start + length;
+}
+
+void match_rate_laws(rp_program *program, rp_compile_stats *stats) {
+    int n = program->ncode;
+    Postfix p = { program->code, program->consts, malloc(n * sizeof *p.begin) };
+    Instruction *scratch = malloc(n * sizeof *scratch);
+    if (!p.begin || !scratch) {
+        free(p.begin);
+        free(scratch);
+        return;
+    }
+
+    // rewrites only shrink the program, so it is copied down in place as it is scanned
+    int ncode = 0;
+    for (int i = 0; i < n; ++i) {
+        p.code[ncode] = p.code[i];
+        fill_begin(&p, ncode, ncode + 1);
+        ncode = p.code[ncode].opcode == OPC_DIV ? rewrite(&p, ncode, scratch, stats) : ncode + 1;
+    }
+    free(p.begin);
+    free(scratch);
+
+    program->ncode = ncode;
+    program->maxdepth = program_depth(program->code, ncode);
+}
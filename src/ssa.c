@@ -0,0 +1,390 @@
+/**
+ * @file ssa.c
+ * @brief Gillespie's stochastic simulation algorithm over a reaction network.
+ *
+ * Each reaction's rate expression is its propensity, evaluated from the
+ * network's per-reaction programs on the caller's state vector. Firing a
+ * reaction adds its stoichiometry column to the species, so only the
+ * propensities that read one of those species can change. A dependency
+ * graph built once at creation lists them for every reaction, and a step
+ * re-evaluates just those instead of all of them.
+ *
+ * Two selection methods share the graph:
+ *   - direct method: propensities sit in the leaves of a binary sum tree,
+ *     so both picking the firing reaction and updating a propensity cost
+ *     O(log reactions)
+ *   - next reaction method (Gibson and Bruck): each reaction keeps an
+ *     absolute firing time in an indexed binary min-heap. Times of affected
+ *     reactions are rescaled by old/new propensity rather than redrawn, so a
+ *     step draws one random number
+ *
+ * Random numbers come from xoshiro256**, seeded through splitmix64, so a
+ * run is reproducible from its seed.
+ *
+ * @date 2025
+ */
+
+
+// --- library import --- //
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "program.h"
+
+struct rp_ssa {
+    const rp_network *network;
+    rp_ssa_method method;
+    int nreactions;
+    double *vars; // the caller's state, bound by rp_ssa_init()
+    double time;
+    uint64_t rng[4];
+
+    // firing reaction r adds change_value[k] to vars[change_slot[k]], k in [change_start[r], change_start[r+1])
+    int *change_start;
+    int *change_slot;
+    double *change_value;
+    // propensities to recompute after firing r, r itself first: graph[graph_start[r] .. graph_start[r+1])
+    int *graph_start;
+    int *graph;
+
+    double *propensity;
+    // direct method: sum tree over leaves; tree[1] is the total, leaf r is tree[leaves + r]
+    double *tree;
+    int leaves;
+    // next reaction method: absolute firing times, and a min-heap of reactions ordered by them
+    double *firing;
+    int *heap;
+    int *heap_index; // position of each reaction in heap
+};
+
+// --- random numbers
+
+static inline uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15u);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9u;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBu;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t next_random(uint64_t *s) {
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+// uniform in (0, 1], so its logarithm is finite
+static inline double uniform(uint64_t *s) {
+    return ((next_random(s) >> 11) + 1) * 0x1.0p-53;
+}
+
+// exponentially distributed waiting time at the given total rate
+static inline double waiting_time(uint64_t *s, double rate) {
+    return -log(uniform(s)) / rate;
+}
+
+// --- propensities
+
+// negative or NaN propensities, from expressions that do not guard against empty species, never fire
+static inline double propensity(const rp_ssa *ssa, int r) {
+    double a = rp_eval(network_reaction_program(ssa->network, r), ssa->vars);
+    return a > 0 ? a : 0.0;
+}
+
+static void tree_update(rp_ssa *ssa, int r, double a) {
+    int node = ssa->leaves + r;
+    ssa->tree[node] = a;
+    // parents are re-summed from their children, so rounding never accumulates
+    for (node >>= 1; node; node >>= 1) ssa->tree[node] = ssa->tree[2*node] + ssa->tree[2*node+1];
+}
+
+// the leaf whose share of the total contains target, skipping empty subtrees
+static int tree_select(const rp_ssa *ssa, double target) {
+    int node = 1;
+    while (node < ssa->leaves) {
+        double left = ssa->tree[2*node];
+        if ((target < left || ssa->tree[2*node+1] <= 0) && left > 0) {
+            node = 2 * node;
+        } else {
+            target -= left;
+            node = 2 * node + 1;
+        }
+    }
+    return node - ssa->leaves;
+}
+
+static inline void heap_place(rp_ssa *ssa, int position, int r) {
+    ssa->heap[position] = r;
+    ssa->heap_index[r] = position;
+}
+
+// move the reaction at position down past children that fire earlier
+static void heap_sift_down(rp_ssa *ssa, int position) {
+    int r = ssa->heap[position], n = ssa->nreactions;
+    double time = ssa->firing[r];
+    for (;;) {
+        int child = 2 * position + 1;
+        if (child >= n) break;
+        if (child + 1 < n && ssa->firing[ssa->heap[child+1]] < ssa->firing[ssa->heap[child]]) child++;
+        if (ssa->firing[ssa->heap[child]] >= time) break;
+        heap_place(ssa, position, ssa->heap[child]);
+        position = child;
+    }
+    heap_place(ssa, position, r);
+}
+
+// restore the heap order around reaction r after its firing time changed
+static void heap_update(rp_ssa *ssa, int r) {
+    int position = ssa->heap_index[r];
+    double time = ssa->firing[r];
+    while (position > 0 && ssa->firing[ssa->heap[(position - 1) / 2]] > time) {
+        heap_place(ssa, position, ssa->heap[(position - 1) / 2]);
+        position = (position - 1) / 2;
+    }
+    heap_place(ssa, position, r);
+    heap_sift_down(ssa, position);
+}
+
+/**
+ * @brief Build the per-reaction species changes and the dependency graph
+ * @return 0, or -1 if out of memory
+ */
+static int build_graph(rp_ssa *ssa, const int *species_slots) {
+    const rp_network *network = ssa->network;
+    int nreactions = ssa->nreactions, nspecies = rp_network_species(network);
+    const int *row_start, *reactions;
+    const double *values;
+    network_stoichiometry(network, &row_start, &reactions, &values);
+    int nnz = row_start[nspecies];
+
+    int *dep_start = NULL, *dep_species = NULL;
+    int *change_species = malloc((nnz + 1) * sizeof *change_species);
+    int *reader_start = calloc(nspecies + 1, sizeof *reader_start);
+    int *mark = malloc((nreactions + 1) * sizeof *mark);
+    ssa->change_start = calloc(nreactions + 1, sizeof *ssa->change_start);
+    ssa->change_slot = malloc((nnz + 1) * sizeof *ssa->change_slot);
+    ssa->change_value = malloc((nnz + 1) * sizeof *ssa->change_value);
+    ssa->graph_start = malloc((nreactions + 1) * sizeof *ssa->graph_start);
+    int ok = change_species && reader_start && mark && ssa->change_start && ssa->change_slot
+          && ssa->change_value && ssa->graph_start
+          && network_dependencies(network, species_slots, &dep_start, &dep_species) == RP_OK;
+    int *readers = ok ? malloc((dep_start[nreactions] + 1) * sizeof *readers) : NULL;
+    ok = ok && readers;
+
+    // stoichiometry columns: the species each reaction changes
+    for (int i = 0; ok && i < nspecies; ++i) {
+        for (int k = row_start[i]; k < row_start[i+1]; ++k) {
+            if (values[k] != 0) ssa->change_start[reactions[k] + 1]++;
+        }
+    }
+    for (int r = 0; ok && r < nreactions; ++r) ssa->change_start[r+1] += ssa->change_start[r];
+    for (int i = 0; ok && i < nspecies; ++i) {
+        for (int k = row_start[i]; k < row_start[i+1]; ++k) {
+            if (values[k] == 0) continue;
+            int position = ssa->change_start[reactions[k]]++;
+            change_species[position] = i;
+            ssa->change_slot[position] = species_slots[i];
+            ssa->change_value[position] = values[k];
+        }
+    }
+    for (int r = nreactions; ok && r > 0; --r) ssa->change_start[r] = ssa->change_start[r-1];
+    if (ok) ssa->change_start[0] = 0;
+
+    // the reactions reading each species
+    for (int j = 0; ok && j < dep_start[nreactions]; ++j) reader_start[dep_species[j] + 1]++;
+    for (int i = 0; ok && i < nspecies; ++i) reader_start[i+1] += reader_start[i];
+    for (int r = 0; ok && r < nreactions; ++r) {
+        for (int j = dep_start[r]; j < dep_start[r+1]; ++j) readers[reader_start[dep_species[j]]++] = r;
+    }
+    for (int i = nspecies; ok && i > 0; --i) reader_start[i] = reader_start[i-1];
+    if (ok) reader_start[0] = 0;
+
+    // the graph: a reaction, then every other reaction reading a species it changes; counted, then filled
+    for (int pass = 0; ok && pass < 2; ++pass) {
+        int count = 0;
+        for (int r = 0; r < nreactions; ++r) mark[r] = -1;
+        for (int r = 0; r < nreactions; ++r) {
+            ssa->graph_start[r] = count;
+            mark[r] = r;
+            if (pass) ssa->graph[count] = r;
+            count++;
+            for (int k = ssa->change_start[r]; k < ssa->change_start[r+1]; ++k) {
+                int i = change_species[k];
+                for (int j = reader_start[i]; j < reader_start[i+1]; ++j) {
+                    if (mark[readers[j]] == r) continue;
+                    mark[readers[j]] = r;
+                    if (pass) ssa->graph[count] = readers[j];
+                    count++;
+                }
+            }
+        }
+        ssa->graph_start[nreactions] = count;
+        if (!pass) {
+            ssa->graph = malloc((count + 1) * sizeof *ssa->graph);
+            ok = ssa->graph != NULL;
+        }
+    }
+
+    free(dep_start);
+    free(dep_species);
+    free(change_species);
+    free(reader_start);
+    free(readers);
+    free(mark);
+    return ok ? 0 : -1;
+}
+
+rp_ssa *rp_ssa_create(const rp_network *network, const int *species_slots, rp_ssa_method method,
+                      uint64_t seed) {
+    // firing adds to every species' slot, so each species needs one
+    for (int i = 0; i < rp_network_species(network); ++i) {
+        if (species_slots[i] < 0) return NULL;
+    }
+    rp_ssa *ssa = calloc(1, sizeof *ssa);
+    if (!ssa) return NULL;
+    ssa->network = network;
+    ssa->method = method;
+    ssa->nreactions = rp_network_reactions(network);
+    ssa->time = 0.0;
+    for (int k = 0; k < 4; ++k) ssa->rng[k] = splitmix64(&seed);
+
+    int n = ssa->nreactions;
+    ssa->propensity = calloc(n + 1, sizeof *ssa->propensity);
+    int ok = ssa->propensity && build_graph(ssa, species_slots) == 0;
+    if (ok && method == RP_SSA_DIRECT) {
+        for (ssa->leaves = 1; ssa->leaves < n; ssa->leaves *= 2) {}
+        ssa->tree = calloc(2 * ssa->leaves, sizeof *ssa->tree);
+        ok = ssa->tree != NULL;
+    } else if (ok) {
+        ssa->firing = malloc((n + 1) * sizeof *ssa->firing);
+        ssa->heap = malloc((n + 1) * sizeof *ssa->heap);
+        ssa->heap_index = malloc((n + 1) * sizeof *ssa->heap_index);
+        ok = ssa->firing && ssa->heap && ssa->heap_index;
+    }
+    if (!ok) {
+        rp_ssa_free(ssa);
+        return NULL;
+    }
+    return ssa;
+}
+
+void rp_ssa_init(rp_ssa *ssa, double *vars, double time) {
+    ssa->vars = vars;
+    ssa->time = time;
+    for (int r = 0; r < ssa->nreactions; ++r) ssa->propensity[r] = propensity(ssa, r);
+
+    if (ssa->method == RP_SSA_DIRECT) {
+        memset(ssa->tree, 0, 2 * ssa->leaves * sizeof *ssa->tree);
+        memcpy(ssa->tree + ssa->leaves, ssa->propensity, ssa->nreactions * sizeof *ssa->tree);
+        for (int node = ssa->leaves - 1; node > 0; --node) {
+            ssa->tree[node] = ssa->tree[2*node] + ssa->tree[2*node+1];
+        }
+        return;
+    }
+    for (int r = 0; r < ssa->nreactions; ++r) {
+        double a = ssa->propensity[r];
+        ssa->firing[r] = a > 0 ? time + waiting_time(ssa->rng, a) : INFINITY;
+        heap_place(ssa, r, r);
+    }
+    for (int position = ssa->nreactions / 2 - 1; position >= 0; --position) heap_sift_down(ssa, position);
+}
+
+// apply reaction r's stoichiometry to the state
+static inline void fire(rp_ssa *ssa, int r) {
+    for (int k = ssa->change_start[r]; k < ssa->change_start[r+1]; ++k) {
+        ssa->vars[ssa->change_slot[k]] += ssa->change_value[k];
+    }
+}
+
+/**
+ * @brief Fire the next reaction if it happens no later than until
+ * @return the reaction, or -1 with the clock left for the caller to set
+ */
+static int step_until(rp_ssa *ssa, double until) {
+    if (ssa->method == RP_SSA_DIRECT) {
+        double total = ssa->tree[1];
+        if (!(total > 0)) return -1;
+        // waiting times are memoryless, so one drawn past until is simply discarded
+        double time = ssa->time + waiting_time(ssa->rng, total);
+        if (time > until) return -1;
+        int r = tree_select(ssa, uniform(ssa->rng) * total);
+        ssa->time = time;
+        fire(ssa, r);
+        for (int k = ssa->graph_start[r]; k < ssa->graph_start[r+1]; ++k) {
+            int j = ssa->graph[k];
+            ssa->propensity[j] = propensity(ssa, j);
+            tree_update(ssa, j, ssa->propensity[j]);
+        }
+        return r;
+    }
+
+    /* a reaction that cannot fire waits forever; its propensity is tested
+       rather than its time, as -ffinite-math-only may fold comparisons with
+       INFINITY */
+    int r = ssa->nreactions ? ssa->heap[0] : -1;
+    if (r < 0 || !(ssa->propensity[r] > 0) || ssa->firing[r] > until) return -1;
+    double time = ssa->time = ssa->firing[r];
+    fire(ssa, r);
+    for (int k = ssa->graph_start[r]; k < ssa->graph_start[r+1]; ++k) {
+        int j = ssa->graph[k];
+        double old = ssa->propensity[j], a = propensity(ssa, j);
+        ssa->propensity[j] = a;
+        if (!(a > 0)) {
+            ssa->firing[j] = INFINITY;
+        } else if (j != r && old > 0) {
+            // the remaining waiting time, rescaled to the new propensity
+            ssa->firing[j] = time + old / a * (ssa->firing[j] - time);
+        } else {
+            ssa->firing[j] = time + waiting_time(ssa->rng, a);
+        }
+        heap_update(ssa, j);
+    }
+    return r;
+}
+
+int rp_ssa_step(rp_ssa *ssa) {
+    int r = step_until(ssa, INFINITY);
+    if (r < 0) ssa->time = INFINITY;
+    return r;
+}
+
+long rp_ssa_advance(rp_ssa *ssa, double until) {
+    long fired = 0;
+    while (step_until(ssa, until) >= 0) fired++;
+    if (ssa->time < until) ssa->time = until;
+    return fired;
+}
+
+double rp_ssa_time(const rp_ssa *ssa) {
+    return ssa->time;
+}
+
+const double *rp_ssa_propensities(const rp_ssa *ssa) {
+    return ssa->propensity;
+}
+
+void rp_ssa_free(rp_ssa *ssa) {
+    if (!ssa) return;
+    free(ssa->change_start);
+    free(ssa->change_slot);
+    free(ssa->change_value);
+    free(ssa->graph_start);
+    free(ssa->graph);
+    free(ssa->propensity);
+    free(ssa->tree);
+    free(ssa->firing);
+    free(ssa->heap);
+    free(ssa->heap_index);
+    free(ssa);
+}
@@ -0,0 +1,187 @@
+/**
+ * @file vm.c
+ * @brief Direct-threaded interpreter for compiled programs.
+ *
+ * A finished program is translated once into threaded code: each
+ * instruction holds the address of its handler and its operand, with
+ * constants copied in from the pool. Every handler ends by jumping straight
+ * to the next instruction's handler (GCC's computed goto), so there is no
+ * central switch and each handler has its own indirect branch to predict.
+ *
+ * The top of the operand stack lives in a register, the accumulator, and
+ * only the values below it are kept in memory: a load spills the
+ * accumulator and a binary operator combines it with one value popped from
+ * memory. The most frequent instruction pairs are fused into
+ * superinstructions. Opcode histograms over the benchmark corpus and
+ * network models show a variable or constant load feeding straight into
+ * + - * / as the common pair; products of loads are mostly monomials by
+ * then. Such a pair becomes one instruction that applies the operator to
+ * the accumulator and its operand without touching the memory stack.
+ *
+ * Handlers evaluate with the same eval functions as the switch loop in
+ * parser.c, in the same order, so results are identical.
+ *
+ * @date 2025
+ */
+
+
+// --- library import --- //
+#include <stdlib.h>
+
+#include "parser.h"
+#include "program.h"
+
+// handlers past the opcodes: superinstructions, and the end of the code
+enum {
+    VM_ADD_VAR = OPC_NONE + 1, // VAR, ADD
+    VM_SUB_VAR,
+    VM_MUL_VAR,
+    VM_DIV_VAR,
+    VM_ADD_CONST, // CONST, ADD
+    VM_SUB_CONST,
+    VM_MUL_CONST,
+    VM_DIV_CONST,
+    VM_HALT,
+    VM_NHANDLERS
+};
+
+/* called with a NULL program, only stores the handler table in *labels:
+   label addresses are only available inside the function, which also keeps
+   GCC from inlining it, so it is the entry point itself */
+double vm_run(const rp_program *program, int begin, int end_at, const double *vars, double *temps,
+              double *out, double *stack, const void *const **labels) {
+    static const void *const handlers[VM_NHANDLERS] = {
+        [OPC_CONST] = &&op_const, [OPC_VAR] = &&op_var, [OPC_NEG] = &&op_neg, [OPC_POW] = &&op_pow,
+        [OPC_MUL] = &&op_mul, [OPC_DIV] = &&op_div, [OPC_MOD] = &&op_mod, [OPC_ADD] = &&op_add,
+        [OPC_SUB] = &&op_sub, [OPC_MIN] = &&op_min, [OPC_MAX] = &&op_max, [OPC_EXP] = &&op_exp,
+        [OPC_LOG] = &&op_log, [OPC_SQRT] = &&op_sqrt, [OPC_ABS] = &&op_abs, [OPC_TANH] = &&op_tanh,
+        [OPC_MONOMIAL] = &&op_monomial, [OPC_MICHAELIS] = &&op_michaelis, [OPC_HILL] = &&op_hill,
+        [OPC_REVERSIBLE_MM] = &&op_reversible_mm, [OPC_STORE] = &&op_store, [OPC_LOAD] = &&op_load,
+        [OPC_OUTPUT] = &&op_output,
+        [VM_ADD_VAR] = &&op_add_var, [VM_SUB_VAR] = &&op_sub_var, [VM_MUL_VAR] = &&op_mul_var,
+        [VM_DIV_VAR] = &&op_div_var, [VM_ADD_CONST] = &&op_add_const, [VM_SUB_CONST] = &&op_sub_const,
+        [VM_MUL_CONST] = &&op_mul_const, [VM_DIV_CONST] = &&op_div_const, [VM_HALT] = &&op_halt,
+    };
+    if (!program) {
+        *labels = handlers;
+        return 0;
+    }
+    const VMInstruction *ip = program->threaded + program->thread_start[begin];
+    const VMInstruction *end = program->threaded + program->thread_start[end_at];
+    const double *consts = program->consts;
+    const MonomialTable *monomials = &program->monomials;
+
+    /* the first load spills the initial accumulator into stack[0], so popping
+       the last value of a segment reads it back instead of below the stack */
+    double acc = 0;
+    double *sp = stack;
+#define DISPATCH() goto *ip->handler
+#define NEXT() goto *(++ip)->handler
+#define BINARY(eval) --sp; acc = eval(*sp, acc); NEXT()
+#define UNARY(eval) acc = eval(acc, 0); NEXT()
+
+    DISPATCH();
+op_const: *sp++ = acc; acc = ip->value; NEXT();
+op_var: *sp++ = acc; acc = vars[ip->arg]; NEXT();
+op_load: *sp++ = acc; acc = temps[ip->arg]; NEXT();
+op_monomial: *sp++ = acc; acc = eval_monomial(monomials, ip->arg, consts, vars); NEXT();
+op_neg: UNARY(eval_uminus);
+op_pow: BINARY(eval_exponent);
+op_mul: BINARY(eval_multiply);
+op_div: BINARY(eval_divide);
+op_mod: BINARY(eval_modulo);
+op_add: BINARY(eval_add);
+op_sub: BINARY(eval_subtract);
+op_min: BINARY(eval_min);
+op_max: BINARY(eval_max);
+op_exp: UNARY(eval_exp);
+op_log: UNARY(eval_log);
+op_sqrt: UNARY(eval_sqrt);
+op_abs: UNARY(eval_abs);
+op_tanh: UNARY(eval_tanh);
+op_michaelis:
+    sp -= 2;
+    acc = eval_michaelis(sp[0], sp[1], acc);
+    NEXT();
+op_hill:
+    sp -= 3;
+    acc = eval_hill(sp[0], sp[1], sp[2], acc, ip->arg);
+    NEXT();
+op_reversible_mm:
+    sp -= 5;
+    acc = eval_reversible_mm(sp[0], sp[1], sp[2], sp[3], sp[4], acc);
+    NEXT();
+op_add_var: acc = eval_add(acc, vars[ip->arg]); NEXT();
+op_sub_var: acc = eval_subtract(acc, vars[ip->arg]); NEXT();
+op_mul_var: acc = eval_multiply(acc, vars[ip->arg]); NEXT();
+op_div_var: acc = eval_divide(acc, vars[ip->arg]); NEXT();
+op_add_const: acc = eval_add(acc, ip->value); NEXT();
+op_sub_const: acc = eval_subtract(acc, ip->value); NEXT();
+op_mul_const: acc = eval_multiply(acc, ip->value); NEXT();
+op_div_const: acc = eval_divide(acc, ip->value); NEXT();
+op_store: temps[ip->arg] = acc; NEXT();
+op_output:
+    // segments end after an output, so only here can a range stop early
+    out[ip->arg] = acc;
+    acc = *--sp;
+    if (++ip == end) return acc;
+    DISPATCH();
+op_halt:
+    return acc;
+#undef DISPATCH
+#undef NEXT
+#undef BINARY
+#undef UNARY
+}
+
+// the superinstruction for a load followed by opcode, or -1
+static inline int superinstruction(int load, int opcode) {
+    int base = load == OPC_VAR ? VM_ADD_VAR : VM_ADD_CONST;
+    switch (opcode) {
+        case OPC_ADD: return base;
+        case OPC_SUB: return base + 1;
+        case OPC_MUL: return base + 2;
+        case OPC_DIV: return base + 3;
+    }
+    return -1;
+}
+
+int vm_translate(rp_program *program, rp_compile_stats *stats) {
+    const void *const *labels;
+    vm_run(NULL, 0, 0, NULL, NULL, NULL, NULL, &labels);
+
+    const Instruction *code = program->code;
+    int ncode = program->ncode;
+    VMInstruction *threaded = malloc((ncode + 1) * sizeof *threaded);
+    int *start = malloc((ncode + 1) * sizeof *start);
+    if (!threaded || !start) {
+        free(threaded);
+        free(start);
+        return EXIT_FAILURE;
+    }
+
+    int n = 0;
+    for (int i = 0; i < ncode; ++i) {
+        const Instruction *in = &code[i];
+        VMInstruction *out = &threaded[n];
+        start[i] = n++;
+        int handler = in->opcode;
+        if ((in->opcode == OPC_VAR || in->opcode == OPC_CONST) && i + 1 < ncode) {
+            int fused = superinstruction(in->opcode, code[i+1].opcode);
+            if (fused >= 0) {
+                handler = fused;
+                start[++i] = n - 1; // never the bound of a range: ranges end after outputs
+                stats->superinstructions++;
+            }
+        }
+        out->handler = labels[handler];
+        if (in->opcode == OPC_CONST) out->value = program->consts[in->arg];
+        else out->arg = in->arg;
+    }
+    threaded[n].handler = labels[VM_HALT];
+    start[ncode] = n;
+
+    program->threaded = threaded;
+    program->thread_start = start;
+    return 0;
+}
@@ -0,0 +1,338 @@
+/**
+ * @file bench.c
+ * @brief Benchmark suite over a corpus of expression shapes, reported as JSON.
+ *
+ * For every expression in the corpus the suite times:
+ *   - parse:        parser_compile_symbols() + rp_program_free()
+ *   - parse_eval:   one-shot parser_eval() on the same text with literals only
+ *   - cached_eval:  rp_cache_eval() of the text, always a cache hit
+ *   - eval:         rp_eval() of the compiled program
+ *   - batch:        rp_eval_batch() over BATCH_ROWS rows, per row
+ *   - jit_eval:     rp_eval() once the program has native code
+ *   - jit_batch:    rp_eval_batch() with native code, per row
+ * Single operations are shorter than the clock's resolution, so each sample
+ * times a run of operations sized to take at least SAMPLE_NS; p50 and p99
+ * are taken over the per-operation time of the samples.
+ *
+ * Usage: bench [output.json]  (stdout by default)
+ *
+ * @date 2025
+ */
+
+
+// --- library import --- //
+#define _POSIX_C_SOURCE 199309L
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "parser.h"
+
+#define SAMPLES 301
+#define SAMPLE_NS 20000.0 // minimum duration of one timed sample
+#define BATCH_ROWS 4096
+#define MAX_EXPRESSION 2048
+#define SUM_TERMS 100
+#define NEST_DEPTH 24
+
+typedef struct {
+    const char *name;
+    char expression[MAX_EXPRESSION];
+    char literal[MAX_EXPRESSION]; // variables replaced by numbers, for parse_eval
+} Case;
+
+typedef struct {
+    rp_program *program;
+    rp_cache *cache;
+    const rp_symtab *symbols;
+    const char *expression;
+    const char *literal;
+    const double *vars;
+    const double *const *columns;
+    double *out;
+} Context;
+
+typedef struct {
+    double ns_per_op;
+    double p50_ns;
+    double p99_ns;
+} Timing;
+
+static volatile double sink;
+
+static inline double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// -- measured operations; each returns the number of operations it performed
+static long op_parse(const Context *ctx, long reps) {
+    for (long i = 0; i < reps; ++i) {
+        rp_program *program = parser_compile_symbols(ctx->expression, ctx->symbols, NULL);
+        rp_program_free(program);
+    }
+    return reps;
+}
+
+static long op_parse_eval(const Context *ctx, long reps) {
+    double value, total = 0;
+    for (long i = 0; i < reps; ++i) {
+        parser_eval(ctx->literal, &value, NULL);
+        total += value;
+    }
+    sink = total;
+    return reps;
+}
+
+static long op_cached_eval(const Context *ctx, long reps) {
+    double value, total = 0;
+    for (long i = 0; i < reps; ++i) {
+        rp_cache_eval(ctx->cache, ctx->expression, ctx->vars, &value, NULL);
+        total += value;
+    }
+    sink = total;
+    return reps;
+}
+
+static long op_eval(const Context *ctx, long reps) {
+    double total = 0;
+    for (long i = 0; i < reps; ++i) total += rp_eval(ctx->program, ctx->vars);
+    sink = total;
+    return reps;
+}
+
+static long op_batch(const Context *ctx, long reps) {
+    for (long i = 0; i < reps; ++i) rp_eval_batch(ctx->program, ctx->columns, BATCH_ROWS, ctx->out);
+    sink = ctx->out[BATCH_ROWS - 1];
+    return reps * BATCH_ROWS;
+}
+
+/**
+ * @brief Time op: calibrate a run length, then collect SAMPLES runs
+ */
+static Timing measure(long (*op)(const Context *, long), const Context *ctx) {
+    static double per_op[SAMPLES];
+    long reps = 1;
+    for (;;) {
+        double start = now_ns();
+        op(ctx, reps);
+        if (now_ns() - start >= SAMPLE_NS) break;
+        reps *= 2;
+    }
+
+    double total_ns = 0, total_ops = 0;
+    for (int s = 0; s < SAMPLES; ++s) {
+        double start = now_ns();
+        long ops = op(ctx, reps);
+        double elapsed = now_ns() - start;
+        per_op[s] = elapsed / ops;
+        total_ns += elapsed;
+        total_ops += ops;
+    }
+    qsort(per_op, SAMPLES, sizeof *per_op, compare_double);
+
+    Timing t = { total_ns / total_ops, per_op[SAMPLES / 2], per_op[SAMPLES * 99 / 100] };
+    return t;
+}
+
+static void print_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+static void print_timing(FILE *f, const char *name, Timing t, int last) {
+    fprintf(f, "      \"%s\": {\"ns_per_op\": %.3f, \"ops_per_s\": %.0f, \"p50_ns\": %.3f, \"p99_ns\": %.3f}%s\n",
+            name, t.ns_per_op, 1e9 / t.ns_per_op, t.p50_ns, t.p99_ns, last ? "" : ",");
+}
+
+/**
+ * @brief Append printf output to a fixed-size expression buffer
+ */
+static void append(char *buffer, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void append(char *buffer, const char *format, ...) {
+    size_t len = strlen(buffer);
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer + len, MAX_EXPRESSION - len, format, args);
+    va_end(args);
+}
+
+/**
+ * @brief Fill the corpus; generated shapes are written out term by term
+ * @return number of cases
+ */
+static int build_corpus(Case *cases) {
+    int n = 0;
+
+    cases[n].name = "short";
+    strcpy(cases[n++].expression, "x+y*2");
+
+    cases[n].name = "constant";
+    strcpy(cases[n++].expression, "3+4*2-7/5^2+(-3)^2");
+
+    cases[n].name = "deep_nested";
+    for (int d = 0; d < NEST_DEPTH; ++d) append(cases[n].expression, "(");
+    append(cases[n].expression, "x");
+    for (int d = 0; d < NEST_DEPTH; ++d) append(cases[n].expression, "%c%d.5)", "+*-/"[d % 4], d + 1);
+    n++;
+
+    cases[n].name = "long_sum";
+    for (int k = 0; k < SUM_TERMS; ++k) append(cases[n].expression, "%sx%d", k ? "+" : "", k);
+    n++;
+
+    cases[n].name = "power_heavy";
+    strcpy(cases[n++].expression, "x^2.5 + y^3 - (x*y)^0.5 + 2^x - (x^2+y^2)^(1/3)");
+
+    cases[n].name = "mass_action";
+    strcpy(cases[n++].expression, "k1*A*B - k2*C");
+
+    cases[n].name = "michaelis_menten";
+    strcpy(cases[n++].expression, "Vmax*S/(Km+S)");
+
+    cases[n].name = "hill";
+    strcpy(cases[n++].expression, "Vmax*S^h/(Km^h+S^h)");
+
+    cases[n].name = "functions";
+    strcpy(cases[n++].expression, "A*B*exp(-Ea/(R*T)) - C*tanh(x/Km) + log(S)*max(y, h)");
+
+    // a generated rate law of the kind model exporters write: a sum of
+    // forward/backward mass-action terms with modifiers
+    cases[n].name = "generated_kinetic";
+    for (int r = 0; r < 8; ++r) {
+        append(cases[n].expression, "%sk%d*x%d*x%d - k%d*x%d/(1+x%d/Km)", r ? " + " : "",
+               2 * r, r, r + 1, 2 * r + 1, r + 2, r + 3);
+    }
+    n++;
+    return n;
+}
+
+/**
+ * @brief Replace every identifier in c->expression by its value for parse_eval
+ */
+static void make_literal(Case *c, const rp_symtab *symbols, const double *vars) {
+    const char *s = c->expression;
+    c->literal[0] = '\0';
+    while (*s) {
+        if (*s == '_' || (*s >= 'A' && *s <= 'Z') || (*s >= 'a' && *s <= 'z')) {
+            char name[64];
+            size_t len = 0;
+            while ((*s == '_' || (*s >= '0' && *s <= '9') || (*s >= 'A' && *s <= 'Z') || (*s >= 'a' && *s <= 'z'))
+                   && len < sizeof name - 1) {
+                name[len++] = *s++;
+            }
+            name[len] = '\0';
+            int slot = rp_symtab_find(symbols, name);
+            // function names stay as they are
+            if (slot >= 0) append(c->literal, "%.6g", vars[slot]);
+            else append(c->literal, "%s", name);
+        } else {
+            append(c->literal, "%c", *s++);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    FILE *out = argc > 1 ? fopen(argv[1], "w") : stdout;
+    if (!out) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    static Case cases[16];
+    int ncases = build_corpus(cases);
+
+    // every name any case uses, all bound to values that keep powers finite
+    const char *names[] = { "x", "y", "A", "B", "C", "S", "Km", "Vmax", "h", "Ea", "R", "T" };
+    rp_symtab *symbols = rp_symtab_create();
+    for (size_t i = 0; i < sizeof names / sizeof *names; ++i) rp_symtab_add(symbols, names[i]);
+    for (int k = 0; k < SUM_TERMS; ++k) {
+        char name[16];
+        snprintf(name, sizeof name, "x%d", k);
+        rp_symtab_add(symbols, name);
+        snprintf(name, sizeof name, "k%d", k);
+        rp_symtab_add(symbols, name);
+    }
+    int nvars = rp_symtab_size(symbols);
+    double *vars = malloc(nvars * sizeof *vars);
+    double **columns = malloc(nvars * sizeof *columns);
+    double *results = malloc(BATCH_ROWS * sizeof *results);
+    for (int v = 0; v < nvars; ++v) {
+        vars[v] = 0.5 + 0.01 * (v % 50);
+        columns[v] = malloc(BATCH_ROWS * sizeof *columns[v]);
+        for (int r = 0; r < BATCH_ROWS; ++r) columns[v][r] = vars[v] + 1e-4 * r;
+    }
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    fprintf(out, "{\n  \"suite\": \"reactionparser\",\n");
+#ifdef __VERSION__
+    fprintf(out, "  \"compiler\": ");
+    print_json_string(out, __VERSION__);
+    fprintf(out, ",\n");
+#endif
+    fprintf(out, "  \"threads\": %d,\n  \"batch_rows\": %d,\n  \"samples\": %d,\n  \"cases\": [\n",
+            threads, BATCH_ROWS, SAMPLES);
+
+    for (int i = 0; i < ncases; ++i) {
+        Case *c = &cases[i];
+        rp_error error;
+        rp_program *program = parser_compile_symbols(c->expression, symbols, &error);
+        if (!program) {
+            fprintf(stderr, "ERROR: %s: %s at position %d\n", c->name, rp_strerror(error.status), error.position);
+            return EXIT_FAILURE;
+        }
+        make_literal(c, symbols, vars);
+        rp_compile_stats stats;
+        rp_program_stats(program, &stats);
+
+        rp_cache *cache = rp_cache_create(symbols, 1 << 20);
+        Context ctx = { program, cache, symbols, c->expression, c->literal, vars,
+                        (const double *const *)columns, results };
+        Timing parse = measure(op_parse, &ctx);
+        Timing parse_eval = measure(op_parse_eval, &ctx);
+        Timing cached_eval = measure(op_cached_eval, &ctx);
+        Timing eval = measure(op_eval, &ctx);
+        Timing batch = measure(op_batch, &ctx);
+        int native = rp_jit_compile(program) != NULL;
+        Timing jit_eval = measure(op_eval, &ctx);
+        Timing jit_batch = measure(op_batch, &ctx);
+
+        fprintf(out, "    {\n      \"name\": \"%s\",\n      \"expression\": ", c->name);
+        print_json_string(out, c->expression);
+        fprintf(out, ",\n      \"length\": %zu,\n      \"instructions\": %d,\n      \"native\": %s,\n",
+                strlen(c->expression), stats.instructions, native ? "true" : "false");
+        print_timing(out, "parse", parse, 0);
+        print_timing(out, "parse_eval", parse_eval, 0);
+        print_timing(out, "cached_eval", cached_eval, 0);
+        print_timing(out, "eval", eval, 0);
+        print_timing(out, "batch", batch, 0);
+        print_timing(out, "jit_eval", jit_eval, 0);
+        print_timing(out, "jit_batch", jit_batch, 1);
+        fprintf(out, "    }%s\n", i + 1 < ncases ? "," : "");
+        rp_program_free(program);
+        rp_cache_free(cache);
+    }
+    fprintf(out, "  ]\n}\n");
+
+    for (int v = 0; v < nvars; ++v) free(columns[v]);
+    free(columns);
+    free(vars);
+    free(results);
+    rp_symtab_free(symbols);
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -2,23 +2,42 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
+
+#include "parser.h"
+
+// the executable under test; CMake passes its path
+#ifndef REACTIONPARSER_BIN
+#define REACTIONPARSER_BIN "./ReactionParser"
+#endif
 
 /**
  * @brief Execute ReactionParser and capture its stdout
  */
 int run_parser(const char *expr, char *output, size_t len) {
-    char cmd[256];
-    snprintf(cmd, sizeof(cmd), "./ReactionParser \"%s\" > tmp_output.txt 2>&1", expr);
+    char cmd[1024];
+    snprintf(cmd, sizeof(cmd), "\"%s\" \"%s\" > tmp_output.txt 2>&1", REACTIONPARSER_BIN, expr);
     int ret = system(cmd);
     FILE *f = fopen("tmp_output.txt", "r");
     if (!f) return -1;
+    output[0] = 0;
     fgets(output, len, f);
     fclose(f);
+    remove("tmp_output.txt");
     // remove trailing newline if present
     output[strcspn(output, "\n")] = 0;
     return WEXITSTATUS(ret);
 }
 
+/**
+ * @brief Whether a value is NaN, read from its bits; -ffast-math folds isnan() to 0
+ */
+int is_nan_bits(double x) {
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof bits);
+    return (bits & 0x7fffffffffffffffULL) > 0x7ff0000000000000ULL;
+}
+
 /**
  * @brief Compare doubles within a small epsilon
  */
@@ -57,6 +76,323 @@ void assert_fail(const char *expr) {
     }
 }
 
+/**
+ * @brief Assert --file mode writes one result line per input line, in order
+ */
+void assert_file_mode(int lines) {
+    FILE *f = fopen("tmp_exprs.txt", "w");
+    for (int i = 0; i < lines; ++i) {
+        if (i % 1000 == 7) fprintf(f, "\n"); // blank lines are passed through
+        else fprintf(f, "%d.5*2+(%d-1)^2\n", i, i % 13);
+    }
+    fclose(f);
+    int ret = system("\"" REACTIONPARSER_BIN "\" --file tmp_exprs.txt > tmp_output.txt 2>&1");
+    remove("tmp_exprs.txt");
+
+    f = fopen("tmp_output.txt", "r");
+    char out[128];
+    int i = 0;
+    while (f && fgets(out, sizeof out, f)) {
+        double expected = (i + 0.5) * 2 + ((i % 13) - 1) * ((i % 13) - 1);
+        int ok = i % 1000 == 7 ? strcmp(out, "\n") == 0 : double_eq(atof(out), expected, 1e-9);
+        if (!ok) {
+            printf("[FAIL] --file line %d → got \"%s\", expected %.6f\n", i + 1, out, expected);
+            fclose(f);
+            remove("tmp_output.txt");
+            exit(EXIT_FAILURE);
+        }
+        i++;
+    }
+    if (f) fclose(f);
+    remove("tmp_output.txt");
+    if (WEXITSTATUS(ret) != 0 || i != lines) {
+        printf("[FAIL] --file wrote %d of %d lines (exit %d)\n", i, lines, WEXITSTATUS(ret));
+        exit(EXIT_FAILURE);
+    }
+    printf("[PASS] --file over %d lines\n", lines);
+}
+
+/**
+ * @brief Assert a compiled program evaluates to the expected value, twice
+ */
+void assert_compiled(const char *expr, double expected) {
+    rp_program *program = parser_compile(expr);
+    if (!program) {
+        printf("[FAIL] compile %s returned NULL\n", expr);
+        exit(EXIT_FAILURE);
+    }
+    double first = rp_eval(program, NULL);
+    double second = rp_eval(program, NULL);
+    rp_program_free(program);
+
+    if (double_eq(first, expected, 1e-6) && first == second) {
+        printf("[PASS] compiled %s = %.6f\n", expr, first);
+    } else {
+        printf("[FAIL] compiled %s → got %.6f then %.6f, expected %.6f\n",
+               expr, first, second, expected);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Assert an expression over named variables evaluates as expected
+ */
+void assert_variables(const char *expr, const rp_symtab *symbols, const double *vars, double expected) {
+    rp_program *program = parser_compile_symbols(expr, symbols, NULL);
+    double val = program ? rp_eval(program, vars) : NAN;
+    rp_program_free(program);
+
+    if (program && double_eq(val, expected, 1e-6)) {
+        printf("[PASS] %s = %.6f\n", expr, val);
+    } else {
+        printf("[FAIL] %s → got %.6f, expected %.6f\n", expr, val, expected);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Assert batched evaluation matches rp_eval row by row
+ */
+void assert_batch(const char *expr, const rp_symtab *symbols, const double *const *columns, size_t n) {
+    rp_program *program = parser_compile_symbols(expr, symbols, NULL);
+    double *out = malloc(n * sizeof *out);
+    double row[8];
+
+    rp_eval_batch(program, columns, n, out);
+    for (size_t r = 0; r < n; ++r) {
+        for (int i = 0; i < rp_symtab_size(symbols); ++i) row[i] = columns[i][r];
+        double expected = rp_eval(program, row);
+        if (!double_eq(out[r], expected, 1e-9 * (1 + fabs(expected)))) {
+            printf("[FAIL] batch %s row %zu → got %.9f, expected %.9f\n", expr, r, out[r], expected);
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("[PASS] batch %s over %zu rows\n", expr, n);
+    free(out);
+    rp_program_free(program);
+}
+
+/**
+ * @brief Assert native code matches the interpreter, scalar and batched
+ */
+void assert_jit(const char *expr, const rp_symtab *symbols, const double *const *columns, size_t n) {
+    rp_program *program = parser_compile_symbols(expr, symbols, NULL);
+    double *expected = malloc(n * sizeof *expected);
+    double *out = malloc(n * sizeof *out);
+    double row[8];
+
+    rp_eval_batch(program, columns, n, expected);
+    rp_jit_fn fn = rp_jit_compile(program);
+    if (!fn) {
+        printf("[FAIL] jit %s not compiled\n", expr);
+        exit(EXIT_FAILURE);
+    }
+    rp_eval_batch(program, columns, n, out);
+    for (size_t r = 0; r < n; ++r) {
+        for (int i = 0; i < rp_symtab_size(symbols); ++i) row[i] = columns[i][r];
+        double tol = 1e-9 * (1 + fabs(expected[r]));
+        if (!double_eq(fn(row), expected[r], tol) || !double_eq(out[r], expected[r], tol)) {
+            printf("[FAIL] jit %s row %zu → got %.9f / %.9f, expected %.9f\n",
+                   expr, r, fn(row), out[r], expected[r]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("[PASS] jit %s over %zu rows\n", expr, n);
+    free(expected);
+    free(out);
+    rp_program_free(program);
+}
+
+/**
+ * @brief Assert a program built by the system compiler gives the
+ *        interpreter's results, scalar and batched; the reference is a
+ *        second copy that is never compiled, since rp_eval() on the
+ *        compiled one runs the native code
+ */
+void assert_native(const char *expr, const rp_symtab *symbols, const double *const *columns, size_t n) {
+    rp_program *program = parser_compile_symbols(expr, symbols, NULL);
+    rp_program *reference = parser_compile_symbols(expr, symbols, NULL);
+    double *expected = malloc(n * sizeof *expected);
+    double *out = malloc(n * sizeof *out);
+    double row[8];
+
+    rp_eval_batch(reference, columns, n, expected);
+    rp_native_fn fn = rp_native_compile(program, NULL);
+    if (!fn) {
+        printf("[SKIP] native %s: no C compiler\n", expr);
+        free(expected);
+        free(out);
+        rp_program_free(program);
+        rp_program_free(reference);
+        return;
+    }
+    rp_eval_batch(program, columns, n, out);
+    for (size_t r = 0; r < n; ++r) {
+        for (int i = 0; i < rp_symtab_size(symbols); ++i) row[i] = columns[i][r];
+        double scalar, interpreted = rp_eval(reference, row);
+        fn(row, &scalar);
+        double tol = 1e-12 * (1 + fabs(interpreted));
+        if (!double_eq(scalar, interpreted, tol) || !double_eq(rp_eval(program, row), interpreted, tol)
+            || !double_eq(out[r], expected[r], tol)) {
+            printf("[FAIL] native %s row %zu → got %.17g / %.17g, expected %.17g\n",
+                   expr, r, scalar, out[r], interpreted);
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("[PASS] native %s over %zu rows\n", expr, n);
+    free(expected);
+    free(out);
+    rp_program_free(program);
+    rp_program_free(reference);
+}
+
+/**
+ * @brief Assert the threaded batch matches the serial one exactly,
+ *        interpreted and native
+ */
+void assert_parallel(const char *expr, const rp_symtab *symbols, const double *const *columns, size_t n) {
+    rp_program *program = parser_compile_symbols(expr, symbols, NULL);
+    double *expected = malloc(n * sizeof *expected);
+    double *out = malloc(n * sizeof *out);
+
+    for (int pass = 0; pass < 2; ++pass) {
+        rp_eval_batch(program, columns, n, expected);
+        rp_eval_batch_parallel(program, columns, n, out);
+        for (size_t r = 0; r < n; ++r) {
+            if (out[r] != expected[r]) {
+                printf("[FAIL] parallel %s row %zu → got %.9f, expected %.9f\n", expr, r, out[r], expected[r]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        rp_jit_compile(program);
+    }
+    printf("[PASS] parallel %s over %zu rows\n", expr, n);
+    free(expected);
+    free(out);
+    rp_program_free(program);
+}
+
+/**
+ * @brief Assert the forward-mode gradient matches central differences, the
+ *        reverse-mode one matches it, and both values rp_eval()
+ */
+void assert_gradient(const char *expr, const rp_symtab *symbols, const double *vars, rp_tape *tape) {
+    rp_program *program = parser_compile_symbols(expr, symbols, NULL);
+    int n = rp_symtab_size(symbols);
+    int slots[8];
+    double gradient[8], adjoint[8], shifted[8];
+    for (int k = 0; k < n; ++k) slots[k] = k;
+
+    double value = rp_eval_gradient(program, vars, slots, n, gradient);
+    double reverse_value = rp_eval_adjoint(tape, program, vars, n, adjoint);
+    if (value != rp_eval(program, vars) || reverse_value != value) {
+        printf("[FAIL] gradient %s value %.17g / %.17g, expected %.17g\n",
+               expr, value, reverse_value, rp_eval(program, vars));
+        exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k < n; ++k) {
+        memcpy(shifted, vars, n * sizeof *vars);
+        double h = 1e-6 * (1 + fabs(vars[k]));
+        shifted[k] = vars[k] + h;
+        double up = rp_eval(program, shifted);
+        shifted[k] = vars[k] - h;
+        double central = (up - rp_eval(program, shifted)) / (2 * h);
+        if (!double_eq(gradient[k], central, 1e-6 * (1 + fabs(central)))
+            || !double_eq(adjoint[k], gradient[k], 1e-12 * (1 + fabs(gradient[k])))) {
+            printf("[FAIL] gradient %s slot %d → got %.9f / %.9f, expected %.9f\n",
+                   expr, k, gradient[k], adjoint[k], central);
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("[PASS] gradient %s\n", expr);
+    rp_program_free(program);
+}
+
+/**
+ * @brief Assert simplification shrinks a program to the expected length
+ *        without changing its value
+ */
+void assert_simplified(const char *expr, const rp_symtab *symbols, const double *vars,
+                       double expected, int instructions) {
+    rp_program *program = parser_compile_symbols(expr, symbols, NULL);
+    rp_compile_stats stats;
+    rp_program_stats(program, &stats);
+    double val = rp_eval(program, vars);
+    rp_program_free(program);
+
+    if (double_eq(val, expected, 1e-9) && stats.instructions == instructions) {
+        printf("[PASS] simplified %s to %d instructions (%d eliminated)\n",
+               expr, stats.instructions, stats.eliminated);
+    } else {
+        printf("[FAIL] simplified %s → %.6f in %d instructions, expected %.6f in %d\n",
+               expr, val, stats.instructions, expected, instructions);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Assert an expression is rejected in-process with the expected status and position
+ */
+void assert_error(const char *expr, const rp_symtab *symbols, rp_status status, int position) {
+    rp_error error;
+    rp_status got = parser_check(expr, symbols, &error);
+
+    if (got == status && error.status == status && error.position == position) {
+        printf("[PASS] (expected error) %s → %s at %d\n", expr, rp_strerror(got), error.position);
+    } else {
+        printf("[FAIL] %s → %s at %d, expected %s at %d\n",
+               expr, rp_strerror(got), error.position, rp_strerror(status), position);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Assert a one-variable function stays within bound ulp of a long
+ *        double reference over n arguments drawn from [lo, hi]
+ */
+void assert_ulp(const char *expr, long double (*reference)(long double), double lo, double hi,
+                double bound) {
+    enum { SAMPLES = 200000 };
+    rp_symtab *symbols = rp_symtab_create();
+    rp_symtab_add(symbols, "x");
+    rp_program *program = parser_compile_symbols(expr, symbols, NULL);
+    double worst = 0, worst_x = 0;
+
+    for (int i = 0; i < SAMPLES; ++i) {
+        double x = lo + (hi - lo) * (rand() / (double)RAND_MAX);
+        long double want = reference(x);
+        int e;
+        frexp((double)want, &e);
+        // ulp of the correctly rounded result, in long double so it never flushes to zero
+        double err = (double)(fabsl(rp_eval(program, &x) - want) / ldexpl(1.0L, e - 53));
+        if (err > worst) {
+            worst = err;
+            worst_x = x;
+        }
+    }
+    rp_program_free(program);
+    rp_symtab_free(symbols);
+
+    if (worst < bound) {
+        printf("[PASS] %s on [%g, %g] within %.2f ulp\n", expr, lo, hi, worst);
+    } else {
+        printf("[FAIL] %s → %.2f ulp at x = %.17g, bound %.1f\n", expr, worst, worst_x, bound);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Assert a literal parses to exactly the double strtod() gives
+ */
+void assert_literal(const char *literal, int verbose) {
+    double got = 0, expected = strtod(literal, NULL);
+    if (parser_eval(literal, &got, NULL) != RP_OK || memcmp(&got, &expected, sizeof got) != 0) {
+        printf("[FAIL] literal %s → got %.17g, expected %.17g\n", literal, got, expected);
+        exit(EXIT_FAILURE);
+    }
+    if (verbose) printf("[PASS] literal %s = %.17g\n", literal, got);
+}
+
 int main(void) {
     printf("=== ReactionParser Unit Tests (double support) ===\n");
 
@@ -117,6 +453,644 @@ int main(void) {
     assert_fail("/5+2");
     assert_fail("2^");
 
+    // --- Whole files of expressions
+    assert_file_mode(5);
+    assert_file_mode(50000);
+
+    // --- In-process error reporting
+    assert_error("3++4", NULL, RP_ERR_BINARY_OPERATOR, 2);
+    assert_error("5*/2", NULL, RP_ERR_BINARY_OPERATOR, 2);
+    assert_error("((2+3)", NULL, RP_ERR_UNMATCHED_OPEN, 0);
+    assert_error("2+3)", NULL, RP_ERR_UNMATCHED_CLOSE, 3);
+    assert_error("/5+2", NULL, RP_ERR_BINARY_OPERATOR, 0);
+    assert_error("2^", NULL, RP_ERR_MISSING_OPERAND, 1);
+    assert_error("2 3", NULL, RP_ERR_MISSING_OPERATOR, 2);
+    assert_error("(2)3", NULL, RP_ERR_MISSING_OPERATOR, 3);
+    assert_error("3$4", NULL, RP_ERR_SYNTAX, 1);
+    assert_error("  ", NULL, RP_ERR_EMPTY, 2);
+    assert_error("2*x", NULL, RP_ERR_UNKNOWN_IDENTIFIER, 2);
+    assert_error("1+2", NULL, RP_OK, 0);
+    double value;
+    if (parser_eval("3++4", &value, NULL) != RP_ERR_BINARY_OPERATOR
+        || parser_eval("3+4", &value, NULL) != RP_OK || value != 7.0 || parser("3+4") != 7.0) {
+        printf("[FAIL] parser_eval() status\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // --- Number literals, rounded exactly like strtod()
+    const char *literals[] = {
+        "0.1", "1e-3", "2.5E+2", ".5", "5.", "6.02214076e23", "1.7976931348623157e308",
+        "2.2250738585072014e-308", "4.9e-324", "9007199254740993", "0.30000000000000004",
+        "123456789012345678901234567890", "0.000000000000000000000000000001234", "7e-400", "1e400",
+    };
+    for (size_t i = 0; i < sizeof literals / sizeof *literals; ++i) assert_literal(literals[i], 1);
+    srand(12345);
+    for (int i = 0; i < 100000; ++i) {
+        char literal[64];
+        unsigned long long mantissa = (unsigned long long)rand() << 31 ^ (unsigned long long)rand();
+        int exponent = rand() % 660 - 340;
+        snprintf(literal, sizeof literal, "%llu.%de%d", mantissa >> (rand() % 60), rand() % 1000, exponent);
+        assert_literal(literal, 0);
+    }
+    printf("[PASS] 100000 random literals\n");
+    assert_error("1.2.3", NULL, RP_ERR_SYNTAX, 3);
+    assert_error("2e", NULL, RP_ERR_SYNTAX, 1);
+    assert_error("2*.", NULL, RP_ERR_SYNTAX, 2);
+
+    // --- Built-in functions
+    assert_eq("sqrt(16)+abs(-2)", 6.0);
+    assert_eq("-max(1, 2^3, 3) * 2", -16.0);
+    assert_compiled("min(3, 1, 2) + max(-1, -4)", 0.0);
+    assert_compiled("exp(0) + log(1) + exp (1)", 1 + exp(1));
+    assert_compiled("log(exp(2.5))^2", 6.25);
+    assert_compiled("tanh(0.5) - -tanh(-0.5)", 0.0);
+    assert_compiled("2^sqrt(min(9, 16))", 8.0);
+    assert_error("exp(1, 2)", NULL, RP_ERR_ARGUMENT_COUNT, 0);
+    assert_error("2*min(1)", NULL, RP_ERR_ARGUMENT_COUNT, 2);
+    assert_error("(1, 2)", NULL, RP_ERR_SYNTAX, 2);
+    assert_error("1, 2", NULL, RP_ERR_SYNTAX, 1);
+    assert_error("max(1, (2, 3))", NULL, RP_ERR_SYNTAX, 9);
+    assert_error("exp()", NULL, RP_ERR_BINARY_OPERATOR, 4);
+    assert_error("min(1,)", NULL, RP_ERR_BINARY_OPERATOR, 6);
+    assert_error("exp(2", NULL, RP_ERR_UNMATCHED_OPEN, 3);
+    assert_error("exp", NULL, RP_ERR_UNKNOWN_IDENTIFIER, 0);
+    assert_error("cosh(2)", NULL, RP_ERR_UNKNOWN_IDENTIFIER, 0);
+    assert_error("2 sqrt(4)", NULL, RP_ERR_MISSING_OPERATOR, 2);
+
+    // vectorizable exp, log and tanh keep to their documented error bounds
+    srand(2025);
+    assert_ulp("exp(x)", expl, -1, 1, 1.5);
+    assert_ulp("exp(x)", expl, -708, 709, 1.5);
+    assert_ulp("log(x)", logl, 0.5, 2, 2.5);
+    assert_ulp("log(x)", logl, 1e-300, 1e300, 2.5);
+    assert_ulp("tanh(x)", tanhl, -1e-6, 1e-6, 3);
+    assert_ulp("tanh(x)", tanhl, -1, 1, 3);
+    assert_ulp("tanh(x)", tanhl, -25, 25, 3);
+
+    // --- Compiled programs
+    assert_compiled("3+4*2", 11.0);
+    assert_compiled("2^3^2", 512.0);
+    assert_compiled("-(-3)", 3.0);
+    assert_compiled("(5.5+3)*2^2", 34.0);
+    assert_compiled("1 + 2 - 3 * 4 / 2^2", 0.0);
+    assert_compiled("3+4*2-7/5^2+(-3)^2", 3+4*2-7/25.0+9);
+
+    // --- Named variables
+    rp_symtab *symbols = rp_symtab_create();
+    int k1 = rp_symtab_add(symbols, "k1");
+    int a = rp_symtab_add(symbols, "A");
+    int b = rp_symtab_add(symbols, "B");
+    int c = rp_symtab_add(symbols, "_C2");
+    double vars[4];
+    vars[k1] = 0.5; vars[a] = 4.0; vars[b] = 3.0; vars[c] = 2.0;
+
+    if (rp_symtab_add(symbols, "A") != a || rp_symtab_find(symbols, "B") != b
+        || rp_symtab_find(symbols, "k") != -1 || rp_symtab_add(symbols, "2x") != -1) {
+        printf("[FAIL] symbol table slot resolution\n");
+        exit(EXIT_FAILURE);
+    }
+    assert_variables("k1*A*B", symbols, vars, 6.0);
+    assert_variables("k1 * A * B - _C2^2", symbols, vars, 2.0);
+    assert_variables("-A+(B-k1)*_C2", symbols, vars, 1.0);
+
+    // --- Simplification
+    assert_simplified("(2*3.5)", symbols, vars, 7.0, 1);
+    assert_simplified("A*1 + 0", symbols, vars, 4.0, 1);
+    assert_simplified("0+B^1", symbols, vars, 3.0, 1);
+    assert_simplified("-(-A)", symbols, vars, 4.0, 1);
+    assert_simplified("-(-3)", symbols, vars, 3.0, 1);
+    assert_simplified("k1*(2*3.5)/1 - 0", symbols, vars, 3.5, 1);
+    assert_simplified("0-A*-1", symbols, vars, 4.0, 1);
+    assert_simplified("k1*A*B^0", symbols, vars, 2.0, 1);
+    assert_simplified("(A+B)*(A-B)", symbols, vars, 7.0, 7);
+    assert_simplified("sqrt(4)*A + max(0, B)*1", symbols, vars, 11.0, 5);
+
+    // --- Mass-action monomials fuse into one instruction
+    assert_simplified("k1*A^2*B^0.5", symbols, vars, 8.0 * sqrt(3.0), 1);
+    assert_simplified("A^3", symbols, vars, 64.0, 1);
+    assert_simplified("k1*A*B - 2*_C2^1.5", symbols, vars, 6.0 - 2 * pow(2.0, 1.5), 3);
+    assert_simplified("A^17 + A^-1 + A^1.25", symbols, vars, pow(4, 17) + 0.25 + pow(4, 1.25), 11);
+    rp_program *fused = parser_compile_symbols("k1*A*B^2 - k1*_C2^3.5/(A*B)", symbols, NULL);
+    rp_compile_stats fused_stats;
+    rp_program_stats(fused, &fused_stats);
+    if (fused_stats.monomials != 3 || !double_eq(rp_eval(fused, vars), 18.0 - 0.5 * pow(2.0, 3.5) / 12.0, 1e-12)) {
+        printf("[FAIL] fused %d monomials, got %.17g\n", fused_stats.monomials, rp_eval(fused, vars));
+        exit(EXIT_FAILURE);
+    }
+    printf("[PASS] fused %d monomials\n", fused_stats.monomials);
+    rp_program_free(fused);
+
+    // --- Standard rate laws become kernels
+    assert_simplified("k1*A/(B+A)", symbols, vars, 2.0 / 7.0, 4);
+    assert_simplified("A*k1/(A+B)", symbols, vars, 2.0 / 7.0, 4);
+    assert_simplified("k1*A^_C2/(B^_C2 + A^_C2)", symbols, vars, 8.0 / 25.0, 5);
+    assert_simplified("k1*A^2/(A^2 + B^2)", symbols, vars, 8.0 / 25.0, 5);
+    assert_simplified("(k1*A/B - _C2*A/k1)/(1 + A/B + A/k1)", symbols, vars,
+                      (0.5 * 4 / 3 - 2.0 * 4 / 0.5) / (1 + 4.0 / 3 + 4 / 0.5), 7);
+    assert_simplified("k1*A/(B+_C2)", symbols, vars, 0.4, 5);
+    rp_program *laws = parser_compile_symbols("k1*A/(B+A) + (k1+1)*A^2.5/(B^2.5+A^2.5)"
+                                              " - (k1*A/B - _C2*A/k1)/(1 + A/B + A/k1)", symbols, NULL);
+    rp_compile_stats law_stats;
+    rp_program_stats(laws, &law_stats);
+    double law_value = 2.0 / 7.0 + 1.5 * pow(4, 2.5) / (pow(3, 2.5) + pow(4, 2.5))
+                     - (0.5 * 4 / 3 - 2.0 * 4 / 0.5) / (1 + 4.0 / 3 + 4 / 0.5);
+    if (law_stats.michaelis_menten != 1 || law_stats.hill != 1 || law_stats.reversible_mm != 1
+        || !double_eq(rp_eval(laws, vars), law_value, 1e-12)) {
+        printf("[FAIL] rate laws %d/%d/%d, got %.17g\n", law_stats.michaelis_menten, law_stats.hill,
+               law_stats.reversible_mm, rp_eval(laws, vars));
+        exit(EXIT_FAILURE);
+    }
+    printf("[PASS] rate laws: %d Michaelis-Menten, %d Hill, %d reversible\n",
+           law_stats.michaelis_menten, law_stats.hill, law_stats.reversible_mm);
+    rp_program_free(laws);
+
+    // --- Loads feeding an operator run as one threaded superinstruction
+    rp_program *threaded = parser_compile_symbols("(A - 2)/B*k1 + (A + B)*(_C2 - 0.5) - A/_C2 + 3", symbols, NULL);
+    rp_compile_stats threaded_stats;
+    rp_program_stats(threaded, &threaded_stats);
+    double threaded_value = (4.0 - 2) / 3 * 0.5 + (4.0 + 3) * (2 - 0.5) - 4.0 / 2 + 3;
+    if (threaded_stats.superinstructions < 6 || !double_eq(rp_eval(threaded, vars), threaded_value, 1e-14)) {
+        printf("[FAIL] %d superinstructions, got %.17g\n", threaded_stats.superinstructions, rp_eval(threaded, vars));
+        exit(EXIT_FAILURE);
+    }
+    printf("[PASS] %d superinstructions in %d instructions\n", threaded_stats.superinstructions,
+           threaded_stats.instructions);
+    rp_program_free(threaded);
+
+
+    // --- Gradients, forward and reverse mode; the tape is reused throughout
+    rp_tape *tape = rp_tape_create();
+    assert_gradient("k1*A^2*B^0.5 - _C2/(A+B)", symbols, vars, tape);
+    assert_gradient("exp(-k1*A)*min(A, B, _C2) + log(A)*tanh(B - 1)", symbols, vars, tape);
+    assert_gradient("sqrt(A) - abs(k1 - B)^0.5 + max(k1, B) - (A - B)^2 + 2^A", symbols, vars, tape);
+    assert_gradient("k1*A/(B+A) + A*B^_C2/(k1^_C2 + B^_C2) - (k1*A/B - _C2*A/k1)/(1 + A/B + A/k1)",
+                    symbols, vars, tape);
+    assert_gradient("B*A^1.5/(_C2^1.5 + A^1.5)", symbols, vars, tape);
+    assert_gradient("k1*A*B*A", symbols, vars, tape);
+
+    // shared subexpressions go through temporaries, whose adjoints add up
+    const char *objective[] = { "(k1*A - B)^2 + (k1*A - B)*_C2 + exp(k1*A - B)" };
+    rp_program *shared = parser_compile_many(objective, 1, symbols, NULL);
+    int all_slots[] = { k1, a, b, c };
+    double forward[4], reverse[4];
+    rp_compile_stats shared_stats;
+    rp_program_stats(shared, &shared_stats);
+    double forward_value = rp_eval_gradient(shared, vars, all_slots, 4, forward);
+    double reverse_value = rp_eval_adjoint(tape, shared, vars, 4, reverse);
+    for (int k = 0; k < 4; ++k) {
+        if (shared_stats.shared == 0 || reverse_value != forward_value
+            || !double_eq(reverse[k], forward[k], 1e-12 * (1 + fabs(forward[k])))) {
+            printf("[FAIL] adjoint through temporaries, slot %d → got %.9f, expected %.9f\n",
+                   k, reverse[k], forward[k]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("[PASS] adjoint through %d shared uses\n", shared_stats.shared);
+    rp_program_free(shared);
+    rp_tape_free(tape);
+
+    // --- Common subexpressions across expressions
+    const char *rates[] = {
+        "k1*A*B/(_C2+A*B)",
+        "B*A + k1",
+        "-(k1*A*B) + A*B",
+        "_C2",
+    };
+    rp_program *many = parser_compile_many(rates, 4, symbols, NULL);
+    double results[4];
+    rp_compile_stats many_stats;
+    rp_eval_many(many, vars, results);
+    rp_program_stats(many, &many_stats);
+    for (int k = 0; k < 4; ++k) {
+        rp_program *single = parser_compile_symbols(rates[k], symbols, NULL);
+        double expected = rp_eval(single, vars);
+        rp_program_free(single);
+        if (!double_eq(results[k], expected, 1e-12)) {
+            printf("[FAIL] shared %s → got %.6f, expected %.6f\n", rates[k], results[k], expected);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (rp_program_outputs(many) != 4 || many_stats.shared < 3) {
+        printf("[FAIL] shared program has %d outputs, %d shared uses\n",
+               rp_program_outputs(many), many_stats.shared);
+        exit(EXIT_FAILURE);
+    }
+    printf("[PASS] %d expressions in %d instructions (%d shared uses)\n",
+           rp_program_outputs(many), many_stats.instructions, many_stats.shared);
+    rp_program_free(many);
+
+    // rp_eval() has one result to give; several outputs, shared or not, get NAN
+    const char *repeated[] = { "A*B+1", "A*B+2", "A*B+3" };
+    const char *distinct[] = { "A+1", "B*2" };
+    rp_program *triple = parser_compile_many(repeated, 3, symbols, NULL);
+    rp_program *pair = parser_compile_many(distinct, 2, symbols, NULL);
+    if (!is_nan_bits(rp_eval(triple, vars)) || !is_nan_bits(rp_eval(pair, vars))) {
+        printf("[FAIL] rp_eval on a program with several outputs did not return NAN\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("[PASS] rp_eval refuses programs with several outputs\n");
+    rp_program_free(triple);
+    rp_program_free(pair);
+
+    rp_error error;
+    const char *bad_rates[] = { "k1*A", "k1*(A", "B" };
+    if (parser_compile_many(bad_rates, 3, symbols, &error)
+        || error.status != RP_ERR_UNMATCHED_OPEN || error.expression != 1 || error.position != 3) {
+        printf("[FAIL] error in second of three expressions not reported\n");
+        exit(EXIT_FAILURE);
+    }
+    assert_error("k1*D", symbols, RP_ERR_UNKNOWN_IDENTIFIER, 3);
+
+    if (parser_compile_symbols("k1*D", symbols, NULL) || parser_compile("k1*A")) {
+        printf("[FAIL] unknown identifier compiled\n");
+        exit(EXIT_FAILURE);
+    }
+
+    rp_program *single_many = parser_compile_many(rates, 1, symbols, NULL);
+    if (!double_eq(rp_eval(single_many, vars), 0.5 * 4 * 3 / (2 + 4 * 3), 1e-12)) {
+        printf("[FAIL] one expression through parser_compile_many\n");
+        exit(EXIT_FAILURE);
+    }
+    rp_program_free(single_many);
+
+    // one expression sharing a subterm keeps it in a temporary, which every single-output path must honour
+    const char *squared[] = { "(A+B)*(A+B) + (A+B)" };
+    rp_program *shared_single = parser_compile_many(squared, 1, symbols, NULL);
+    rp_compile_stats shared_single_stats;
+    rp_program_stats(shared_single, &shared_single_stats);
+    const double *shared_columns[] = { &vars[0], &vars[1], &vars[2], &vars[3] };
+    double shared_row = NAN, shared_out = NAN;
+    double shared_expected = (4.0 + 3.0) * (4.0 + 3.0) + (4.0 + 3.0);
+    rp_eval_batch(shared_single, shared_columns, 1, &shared_row);
+    rp_eval_many(shared_single, vars, &shared_out);
+    if (shared_single_stats.shared == 0 || rp_eval(shared_single, vars) != shared_expected
+        || shared_row != shared_expected || shared_out != shared_expected
+        || rp_jit_compile(shared_single) || rp_eval(shared_single, vars) != shared_expected) {
+        printf("[FAIL] one expression with a shared subterm → got %.6f, batch %.6f, expected %.6f\n",
+               rp_eval(shared_single, vars), shared_row, shared_expected);
+        exit(EXIT_FAILURE);
+    }
+    printf("[PASS] one expression with %d shared uses\n", shared_single_stats.shared);
+    rp_program_free(shared_single);
+
+    // --- Incremental updates: only outputs reading a changed slot are recomputed
+    const char *sparse[] = { "k1*A*B", "k1*A*B + _C2", "exp(_C2)*B", "_C2 + 1", "A*B*2", "3*k1" };
+    rp_program *coupled_outputs = parser_compile_many(sparse, 6, symbols, NULL);
+    rp_incremental *incremental = rp_incremental_create(coupled_outputs);
+    double state[4], full[6];
+    memcpy(state, vars, sizeof state);
+    rp_update(incremental, state, NULL, 0);
+    const int changes[][2] = { { c, -1 }, { k1, -1 }, { a, -1 }, { b, c }, { k1, a } };
+    const int recomputed[] = { 3, 3, 3, 5, 4 };
+    for (int round = 0; round < 50; ++round) {
+        const int *slots = changes[round % 5];
+        int nslots = slots[1] < 0 ? 1 : 2;
+        for (int k = 0; k < nslots; ++k) state[slots[k]] += 0.25 * (round + 1);
+        int count = rp_update(incremental, state, slots, nslots);
+        rp_eval_many(coupled_outputs, state, full);
+        if (count != recomputed[round % 5]
+            || memcmp(rp_incremental_outputs(incremental), full, sizeof full) != 0) {
+            printf("[FAIL] incremental round %d → %d outputs recomputed, expected %d\n",
+                   round, count, recomputed[round % 5]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    rp_compile_stats coupled_stats;
+    rp_program_stats(coupled_outputs, &coupled_stats);
+    printf("[PASS] incremental updates with %d shared uses\n", coupled_stats.shared);
+    rp_incremental_free(incremental);
+    rp_program_free(coupled_outputs);
+
+    // --- Reaction network: dX/dt = S v in one call
+    // A + B -> _C2 at k1*A*B, _C2 -> A + B at B*_C2/(k1+_C2), 2 A -> B at k1*A^2
+    const char *network_rates[] = { "k1*A*B", "B*_C2/(k1+_C2)", "k1*A^2" };
+    const int row_start[] = { 0, 3, 6, 8 }; // rows A, B, _C2
+    const int row_reactions[] = { 0, 1, 2, 0, 1, 2, 0, 1 };
+    const double coefficients[] = { -1, 1, -2, -1, 1, 1, 1, -1 };
+    rp_network *network = rp_network_create(network_rates, 3, symbols, 3, row_start, row_reactions,
+                                            coefficients, NULL);
+    double v0 = 6.0, v1 = 3.0 * 2 / 2.5, v2 = 8.0;
+    const double expected_rhs[] = { -v0 + v1 - 2 * v2, -v0 + v1 + v2, v0 - v1 };
+    double rhs[3];
+    rp_network_rhs(network, vars, rhs);
+    for (int k = 0; k < 3; ++k) {
+        if (!double_eq(rhs[k], expected_rhs[k], 1e-12)) {
+            printf("[FAIL] network dX%d/dt → got %.6f, expected %.6f\n", k, rhs[k], expected_rhs[k]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (rp_network_species(network) != 3 || rp_network_reactions(network) != 3
+        || !double_eq(rp_network_rates(network)[1], v1, 1e-12)) {
+        printf("[FAIL] network dimensions or rates\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("[PASS] network of %d reactions and %d species\n", rp_network_reactions(network), rp_network_species(network));
+
+    // Jacobian against central differences of the right-hand side
+    const int species_slots[] = { a, b, c };
+    const int *jac_rows, *jac_columns;
+    double jacobian[9], shifted_vars[4], rhs_up[3], rhs_down[3];
+    if (rp_network_jacobian_pattern(network, &jac_rows, &jac_columns) != -1
+        || rp_network_jacobian_init(network, species_slots) != RP_OK
+        || rp_network_jacobian_pattern(network, &jac_rows, &jac_columns) != 9) {
+        printf("[FAIL] network Jacobian pattern\n");
+        exit(EXIT_FAILURE);
+    }
+    rp_network_jacobian(network, vars, jacobian);
+    for (int i = 0; i < 3; ++i) {
+        for (int k = jac_rows[i]; k < jac_rows[i+1]; ++k) {
+            int slot = species_slots[jac_columns[k]];
+            memcpy(shifted_vars, vars, sizeof shifted_vars);
+            shifted_vars[slot] = vars[slot] + 1e-6;
+            rp_network_rhs(network, shifted_vars, rhs_up);
+            shifted_vars[slot] = vars[slot] - 1e-6;
+            rp_network_rhs(network, shifted_vars, rhs_down);
+            double central = (rhs_up[i] - rhs_down[i]) / 2e-6;
+            if (!double_eq(jacobian[k], central, 1e-6 * (1 + fabs(central)))) {
+                printf("[FAIL] network Jacobian (%d, %d) → got %.9f, expected %.9f\n",
+                       i, jac_columns[k], jacobian[k], central);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    printf("[PASS] network Jacobian with %d nonzeros\n", jac_rows[3]);
+    double native_rhs[3];
+    if (rp_network_native_compile(network, NULL) == 0) {
+        rp_network_rhs(network, vars, native_rhs);
+        if (memcmp(native_rhs, rhs, sizeof native_rhs) != 0) {
+            printf("[FAIL] native network rhs\n");
+            exit(EXIT_FAILURE);
+        }
+        printf("[PASS] native network rhs\n");
+    }
+    rp_network_free(network);
+
+    const int bad_reactions[] = { 0, 1, 3, 0, 1, 2, 0, 1 };
+    if (rp_network_create(network_rates, 3, symbols, 3, row_start, bad_reactions, coefficients, &error)
+        || error.status != RP_ERR_STOICHIOMETRY || error.position != 0) {
+        printf("[FAIL] reaction index out of range accepted\n");
+        exit(EXIT_FAILURE);
+    }
+    const char *bad_network_rates[] = { "k1*A*B", "B*(_C2", "k1*A^2" };
+    if (rp_network_create(bad_network_rates, 3, symbols, 3, row_start, row_reactions, coefficients, &error)
+        || error.status != RP_ERR_UNMATCHED_OPEN || error.expression != 1) {
+        printf("[FAIL] network rate error not reported\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("[PASS] malformed networks rejected\n");
+
+    // --- Stochastic simulation, direct and next reaction method
+    const int ssa_slots[] = { a, b, c };
+    const int decay_row[] = { 0, 1, 1, 1 };
+    const int decay_reaction[] = { 0 };
+    const double decay_coefficient[] = { -1 };
+    const char *decay_rate[] = { "k1*A" };
+    rp_network *decay = rp_network_create(decay_rate, 1, symbols, 3, decay_row, decay_reaction,
+                                          decay_coefficient, NULL);
+    // 0 -> A at 20*k1, A -> 0 at k1*A: A is Poisson distributed with mean 20
+    const char *birth_death_rates[] = { "20*k1", "k1*A" };
+    const int birth_death_row[] = { 0, 2, 2, 2 };
+    const int birth_death_reactions[] = { 0, 1 };
+    const double birth_death_coefficients[] = { 1, -1 };
+    rp_network *birth_death = rp_network_create(birth_death_rates, 2, symbols, 3, birth_death_row,
+                                                birth_death_reactions, birth_death_coefficients, NULL);
+    // A + B <-> _C2, 2 A -> B, with propensities that vanish with their reactants
+    const char *coupled_rates[] = { "k1*A*B", "0.5*_C2", "k1*A*(A-1)/2", "3*k1" };
+    const int coupled_row[] = { 0, 4, 7, 9 };
+    const int coupled_reactions[] = { 0, 1, 2, 3, 0, 1, 2, 0, 1 };
+    const double coupled_coefficients[] = { -1, 1, -2, 1, -1, 1, 1, 1, -1 };
+    rp_network *coupled = rp_network_create(coupled_rates, 4, symbols, 3, coupled_row, coupled_reactions,
+                                            coupled_coefficients, NULL);
+    rp_program *coupled_programs[4];
+    for (int r = 0; r < 4; ++r) coupled_programs[r] = parser_compile_symbols(coupled_rates[r], symbols, NULL);
+
+    const int unslotted[] = { a, -1, c };
+    if (rp_ssa_create(decay, unslotted, RP_SSA_DIRECT, 42)) {
+        printf("[FAIL] ssa created for a species without a slot\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int method = RP_SSA_DIRECT; method <= RP_SSA_NEXT_REACTION; ++method) {
+        double state[4];
+        state[k1] = 0.5; state[a] = 200; state[b] = 0; state[c] = 0;
+        rp_ssa *ssa = rp_ssa_create(decay, ssa_slots, method, 42);
+        rp_ssa_init(ssa, state, 0.0);
+        int steps = 0;
+        while (rp_ssa_step(ssa) == 0) steps++;
+        if (steps != 200 || state[a] != 0) {
+            printf("[FAIL] ssa %d decay → %d steps, A = %g\n", method, steps, state[a]);
+            exit(EXIT_FAILURE);
+        }
+        rp_ssa_free(ssa);
+
+        state[a] = 0;
+        ssa = rp_ssa_create(birth_death, ssa_slots, method, 7);
+        rp_ssa_init(ssa, state, 0.0);
+        double mean = 0;
+        enum { SAMPLES = 20000 };
+        rp_ssa_advance(ssa, 50.0);
+        for (int k = 1; k <= SAMPLES; ++k) {
+            rp_ssa_advance(ssa, 50.0 + k);
+            mean += state[a] / SAMPLES;
+        }
+        if (!double_eq(mean, 20.0, 0.5) || rp_ssa_time(ssa) != 50.0 + SAMPLES) {
+            printf("[FAIL] ssa %d birth-death mean → %.3f, expected 20\n", method, mean);
+            exit(EXIT_FAILURE);
+        }
+        rp_ssa_free(ssa);
+
+        // only dependent propensities are re-evaluated, yet all stay current
+        double trajectory[2][4];
+        for (int run = 0; run < 2; ++run) {
+            double *s = trajectory[run];
+            s[k1] = 0.5; s[a] = 40; s[b] = 30; s[c] = 20;
+            ssa = rp_ssa_create(coupled, ssa_slots, method, 2025);
+            rp_ssa_init(ssa, s, 0.0);
+            for (int k = 0; k < 2000 && rp_ssa_step(ssa) >= 0; ++k) {
+                const double *propensities = rp_ssa_propensities(ssa);
+                for (int r = 0; r < 4; ++r) {
+                    double fresh = rp_eval(coupled_programs[r], s);
+                    if (propensities[r] != (fresh > 0 ? fresh : 0)) {
+                        printf("[FAIL] ssa %d stale propensity %d after %d steps\n", method, r, k);
+                        exit(EXIT_FAILURE);
+                    }
+                }
+            }
+            rp_ssa_free(ssa);
+        }
+        if (memcmp(trajectory[0], trajectory[1], sizeof trajectory[0]) != 0 || trajectory[0][a] < 0) {
+            printf("[FAIL] ssa %d not reproducible from its seed\n", method);
+            exit(EXIT_FAILURE);
+        }
+        printf("[PASS] ssa %s\n", method == RP_SSA_DIRECT ? "direct method" : "next reaction method");
+    }
+    for (int r = 0; r < 4; ++r) rp_program_free(coupled_programs[r]);
+    rp_network_free(decay);
+    rp_network_free(birth_death);
+    rp_network_free(coupled);
+
+    // --- Program cache: repeated strings skip parsing, the cap evicts the coldest
+    rp_cache *cache = rp_cache_create(symbols, 1024);
+    const char *requests[] = { "k1*A*B", "2^3+1", "k1*A*B", "-A+(B-k1)*_C2", "k1*A*B", "2^3+1" };
+    const double expected_results[] = { 6.0, 9.0, 6.0, 1.0, 6.0, 9.0 };
+    for (int k = 0; k < 6; ++k) {
+        double value;
+        if (rp_cache_eval(cache, requests[k], vars, &value, NULL) != RP_OK || !double_eq(value, expected_results[k], 1e-12)) {
+            printf("[FAIL] cache %s → got %.6f, expected %.6f\n", requests[k], value, expected_results[k]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    rp_cache_stats cache_stats;
+    rp_cache_statistics(cache, &cache_stats);
+    if (cache_stats.hits != 3 || cache_stats.misses != 3 || cache_stats.bytes > 1024) {
+        printf("[FAIL] cache counters: %zu hits, %zu misses, %zu bytes\n",
+               cache_stats.hits, cache_stats.misses, cache_stats.bytes);
+        exit(EXIT_FAILURE);
+    }
+    double cached;
+    if (rp_cache_eval(cache, "k1*(A", vars, &cached, &error) != RP_ERR_UNMATCHED_OPEN || error.position != 3) {
+        printf("[FAIL] cache error status\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k < 50; ++k) {
+        char expression[32];
+        snprintf(expression, sizeof expression, "A*%d+B", k);
+        rp_cache_eval(cache, expression, vars, &cached, NULL);
+    }
+    rp_cache_statistics(cache, &cache_stats);
+    if (cache_stats.evictions == 0 || cache_stats.bytes > 1024 || cache_stats.entries == 0) {
+        printf("[FAIL] cache cap: %zu evictions, %zu bytes\n", cache_stats.evictions, cache_stats.bytes);
+        exit(EXIT_FAILURE);
+    }
+    printf("[PASS] cache: %zu hits, %zu misses, %zu evictions, %zu entries in %zu bytes\n",
+           cache_stats.hits, cache_stats.misses, cache_stats.evictions, cache_stats.entries, cache_stats.bytes);
+    rp_cache_free(cache);
+
+    // --- Batched evaluation (row count not a multiple of the block size)
+    enum { ROWS = 1003 };
+    static double col_k1[ROWS], col_a[ROWS], col_b[ROWS], col_c[ROWS];
+    const double *columns[4];
+    columns[k1] = col_k1; columns[a] = col_a; columns[b] = col_b; columns[c] = col_c;
+    for (int r = 0; r < ROWS; ++r) {
+        col_k1[r] = 0.001 * r;
+        col_a[r] = 1.0 + r % 17;
+        col_b[r] = 2.5 - 0.01 * r;
+        col_c[r] = 0.5 + (r % 5);
+    }
+    assert_batch("k1*A*B", symbols, columns, ROWS);
+    assert_batch("-A+(B-k1)*_C2^2/3", symbols, columns, ROWS);
+    assert_batch("A%_C2 - -k1", symbols, columns, ROWS);
+    assert_batch("2^3*k1", symbols, columns, 7);
+    assert_batch("exp(-k1*A)*min(A, B, _C2) + log(A)*tanh(B - 1)", symbols, columns, ROWS);
+    assert_batch("sqrt(A) - abs(B)^0.5 + max(k1, B)", symbols, columns, ROWS);
+    assert_batch("k1*A^2*B - 2*_C2^0.5*A^3 + A^16*_C2^7.5", symbols, columns, ROWS);
+    assert_batch("k1*A/(B+A) - A*B^_C2/(k1^_C2 + B^_C2) + B*A^1.5/(_C2^1.5 + A^1.5)", symbols, columns, ROWS);
+    assert_batch("(k1*A/B - _C2*A/k1)/(1 + A/B + A/k1)", symbols, columns, ROWS);
+
+    // --- Native code
+    assert_jit("k1*A*B", symbols, columns, ROWS);
+    assert_jit("-A+(B-k1)*_C2^2/3", symbols, columns, ROWS);
+    assert_jit("A%_C2 - -k1", symbols, columns, ROWS);
+    assert_jit("k1+(A+(B+(_C2+A^B%3)))", symbols, columns, ROWS);
+    assert_jit("((A+B)*(A-B))^2 / -(k1+1) + 2.5^A", symbols, columns, 3);
+    assert_jit("exp(-k1*A)*min(A, B, _C2) + log(A)*tanh(B - 1)", symbols, columns, ROWS);
+    assert_jit("k1 + (A + max(B, sqrt(abs(_C2 - log(A)))))", symbols, columns, ROWS);
+    assert_jit("k1*A^2*B - 2*_C2^0.5*A^3 + A^16*_C2^7.5", symbols, columns, ROWS);
+    assert_jit("k1*A/(B+A) - A*B^_C2/(k1^_C2 + B^_C2) + B*A^1.5/(_C2^1.5 + A^1.5)", symbols, columns, ROWS);
+    assert_jit("_C2 + (B + (k1*A/B - _C2*A/k1)/(1 + A/B + A/k1))", symbols, columns, ROWS);
+
+    // --- Generated C, built by the system compiler
+    assert_native("k1*A*B", symbols, columns, ROWS);
+    assert_native("-A+(B-k1)*_C2^2/3 + A%_C2 - 1e308*1e10", symbols, columns, ROWS);
+    assert_native("exp(-k1*A)*min(A, B, _C2) + log(A)*tanh(B - 1) + sqrt(abs(B)) - max(k1, B)^A",
+                  symbols, columns, ROWS);
+    assert_native("k1*A^2*B - 2*_C2^0.5*A^3 + A^16*_C2^7.5 + 0.1*A", symbols, columns, ROWS);
+    assert_native("k1*A/(B+A) - A*B^_C2/(k1^_C2 + B^_C2) + B*A^1.5/(_C2^1.5 + A^1.5)", symbols, columns, ROWS);
+    assert_native("_C2 + (B + (k1*A/B - _C2*A/k1)/(1 + A/B + A/k1))", symbols, columns, ROWS);
+
+    const char *model[] = { "k1*A*B/(1 + A*B)", "exp(-A*B) + k1", "A*B" };
+    rp_program *native_many = parser_compile_many(model, 3, symbols, NULL);
+    double interpreted[3], generated[3];
+    rp_eval_many(native_many, vars, interpreted);
+    if (rp_native_compile(native_many, "/nonexistent/cc") != NULL) {
+        printf("[FAIL] native build without a compiler\n");
+        exit(EXIT_FAILURE);
+    }
+    if (rp_native_compile(native_many, NULL)) {
+        rp_eval_many(native_many, vars, generated);
+        if (memcmp(generated, interpreted, sizeof generated) != 0) {
+            printf("[FAIL] native outputs → got %.17g %.17g %.17g\n", generated[0], generated[1], generated[2]);
+            exit(EXIT_FAILURE);
+        }
+        printf("[PASS] native model with 3 outputs\n");
+    }
+    rp_program_free(native_many);
+
+    // --- Machine-sized expressions: stacks grow past their inline size
+    enum { TERMS = 20000, NESTING = 3000 };
+    char *huge = malloc(16 * TERMS + 1);
+    char *p = huge;
+    for (int k = 0; k < TERMS; ++k) p += sprintf(p, k ? "+k1*A%s" : "k1*A%s", k % 2 ? "" : "-B");
+    rp_program *big = parser_compile_symbols(huge, symbols, NULL);
+    double expected_sum = TERMS * 0.5 * 4.0 - TERMS / 2 * 3.0;
+    if (!big || !double_eq(rp_eval(big, vars), expected_sum, 1e-6)) {
+        printf("[FAIL] %d-term sum\n", TERMS);
+        exit(EXIT_FAILURE);
+    }
+    rp_program_free(big);
+    printf("[PASS] %d-term sum = %.1f\n", TERMS, expected_sum);
+
+    // non-commutative nesting keeps every level on the operand stack
+    p = huge;
+    for (int k = 0; k < NESTING; ++k) p += sprintf(p, "1-(");
+    p += sprintf(p, "A");
+    for (int k = 0; k < NESTING; ++k) *p++ = ')';
+    *p = '\0';
+    big = parser_compile_symbols(huge, symbols, NULL);
+    double nested = NESTING % 2 ? 1 - 4.0 : 4.0;
+    if (!big || !double_eq(rp_eval(big, vars), nested, 1e-12)) {
+        printf("[FAIL] %d-deep nesting\n", NESTING);
+        exit(EXIT_FAILURE);
+    }
+    double nested_rows[ROWS];
+    rp_eval_batch(big, columns, ROWS, nested_rows);
+    for (int r = 0; r < ROWS; ++r) {
+        if (!double_eq(nested_rows[r], NESTING % 2 ? 1 - col_a[r] : col_a[r], 1e-12)) {
+            printf("[FAIL] %d-deep nesting batched, row %d\n", NESTING, r);
+            exit(EXIT_FAILURE);
+        }
+    }
+    rp_program_free(big);
+    memset(huge, '(', NESTING);
+    sprintf(huge + NESTING, "2");
+    memset(huge + NESTING + 1, ')', NESTING);
+    huge[2 * NESTING + 1] = '\0';
+    if (parser_eval(huge, &value, NULL) != RP_OK || value != 2.0) {
+        printf("[FAIL] %d nested parentheses\n", NESTING);
+        exit(EXIT_FAILURE);
+    }
+    printf("[PASS] %d-deep nesting\n", NESTING);
+    free(huge);
+
+    // --- Threaded batches, large enough to actually split
+    enum { BIG_ROWS = 20011 };
+    static double big_k1[BIG_ROWS], big_a[BIG_ROWS], big_b[BIG_ROWS], big_c[BIG_ROWS];
+    const double *big_columns[4];
+    big_columns[k1] = big_k1; big_columns[a] = big_a; big_columns[b] = big_b; big_columns[c] = big_c;
+    for (int r = 0; r < BIG_ROWS; ++r) {
+        big_k1[r] = 0.001 * r;
+        big_a[r] = 1.0 + r % 17;
+        big_b[r] = 2.5 - 0.0001 * r;
+        big_c[r] = 0.5 + (r % 5);
+    }
+#ifdef _OPENMP
+    omp_set_num_threads(4);
+#endif
+    assert_parallel("k1*A*B", symbols, big_columns, BIG_ROWS);
+    assert_parallel("-A+(B-k1)*_C2^2/3 + A%_C2", symbols, big_columns, BIG_ROWS);
+    assert_parallel("k1*A*B", symbols, big_columns, 37);
+    rp_symtab_free(symbols);
+
     printf("All tests passed successfully.\n");
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,260 @@
+/**
+ * @file test_reactionparser_hpp.cpp
+ * @brief Tests of the C++ layer: the templated evaluator against the C
+ *        library for each scalar type, and the compile-time parser against
+ *        the runtime one on a shared corpus.
+ *
+ * @date 2025
+ */
+
+// --- library import --- //
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "reactionparser.hpp"
+#include "reactionparser_expr.hpp"
+
+/* expressions both front ends must read alike: each is compiled at run time
+   and, through rp::expr, at compile time */
+#define CORPUS(X) \
+    X("k1*A*B") \
+    X("-A+(B-k1)*_C2^2/3") \
+    X("A%_C2 - -k1") \
+    X("-A^2 + A^-B^_C2 - 2^3^2") \
+    X("A-B-k1 + A/B/_C2*k1 - -(-A) + --B") \
+    X("exp(-k1*A)*min(A, B, _C2) + log(A)*tanh(B - 1)") \
+    X("max(A, min(B, k1, _C2), 0.5) - exp (A)^2") \
+    X("sqrt(A) - abs(k1 - B)^0.5 + max(k1, B)") \
+    X("k1*A^2*B - 2*_C2^0.5*A^3 + A^16*_C2^7.5") \
+    X("k1*A/(B+A) - A*B^_C2/(k1^_C2 + B^_C2) + B*A^1.5/(_C2^1.5 + A^1.5)") \
+    X("_C2 + (B + (k1*A/B - _C2*A/k1)/(1 + A/B + A/k1))") \
+    X("2*exp(-1.5/(8.314e-3*298)) + max(0.1, 1, 0.5)*A") \
+    X("  A\t*\n(B + .5e1) - 5. ") \
+    X("A^(1/2) + B^(3/2)*k1 - _C2^(2^-1)") \
+    X("(A*B)*(k1*_C2) + A*(B*k1) + B^0.5*(k1*A) - (A+B)*(k1*(A+_C2))") \
+    X("A+0 - (0-B) + 1*k1*_C2^1 + A^0 + exp(0)*A + 2^0.5*B - -1*A/1") \
+    X("k1*(A+1)/(B+(A+1)) + (A+0)*B^2/(k1^2 + B^2)") \
+    X("exp(log(A)*B) + tanh(-exp(-A*_C2)) + log(1 + exp(B)) + exp(700)*1e-300")
+
+// literals both front ends must round to the same double
+#define LITERALS(X) \
+    X("0.1") X("1e23") X("9007199254740993") X("2.2250738585072011e-308") \
+    X("4.9e-324") X("2.4703282292062328e-324") X("2.4703282292062327e-324") \
+    X("1.7976931348623157e308") X("1.7976931348623159e308") X("1e-400") X("1e400") \
+    X("123456789012345678901234567890") X("3.14159265358979323846264338327950288419716939937510") \
+    X("0.000000000000000000000000000001234567890123456789012345") X("7.e-3") X(".5E+2")
+
+// inputs both front ends must reject with the same status at the same byte
+static const char *const malformed[] = {
+    "", "   ", "k1*(A+B", "k1*A+B)", "A B", "A*", "*A", "(A,B)", "min(A)", "exp(A,B)",
+    "min()", "A..5", "1.5e", "2A", "A $ B", "max(A,,B)", "A+-*B", "exp A", "(", ")",
+    "1.2.3", ".", "A^", "sqrt(A))", "max(A, B", "A + (B, k1)", "-", "A*(-)",
+};
+
+#define STRING(e) e,
+static const char *const corpus[] = { CORPUS(STRING) };
+
+static bool same_bits(double got, double expected) {
+    return std::memcmp(&got, &expected, sizeof got) == 0;
+}
+
+static bool close(double got, double expected, double relative) {
+    if (got == expected || (std::isnan(got) && std::isnan(expected))) return true;
+    return std::fabs(got - expected) <= relative * (1 + std::fabs(expected));
+}
+
+static void fail(const char *what, const char *expr, double got, double expected) {
+    printf("[FAIL] %s %s → got %.17g, expected %.17g\n", what, expr, got, expected);
+    exit(EXIT_FAILURE);
+}
+
+// rows of test values, one column per slot
+static void row(int r, double *vars) {
+    vars[0] = 0.25 + 0.125 * r;
+    vars[1] = 1.0 + r % 5;
+    vars[2] = 2.5 - 0.25 * r;
+    vars[3] = 0.5 + r % 3;
+}
+
+/**
+ * @brief rp::expr<S> against the program compiled from S at run time, for
+ *        double values and dual derivatives
+ */
+template <rp::fixed_string S>
+static void check_expr(const rp_symtab *symbols) {
+    rp::expr<S> compiled(symbols);
+    rp::program program(S.chars, symbols);
+    const int slots[] = { 0, 1, 2, 3 };
+    for (int r = 0; r < 8; ++r) {
+        double vars[4], gradient[4];
+        row(r, vars);
+        double expected = rp_eval(program.get(), vars);
+        double got = compiled(vars);
+        if (!same_bits(got, expected)) fail("expr", S.chars, got, expected);
+
+        rp::dual<double, 4> seeded[4];
+        for (int k = 0; k < 4; ++k) seeded[k] = rp::dual<double, 4>::variable(vars[k], k);
+        rp::dual<double, 4> derivatives = compiled(seeded);
+        rp_eval_gradient(program.get(), vars, slots, 4, gradient);
+        for (int k = 0; k < 4; ++k) {
+            if (!close(derivatives.d[k], gradient[k], 1e-10)) fail("expr derivative", S.chars, derivatives.d[k], gradient[k]);
+        }
+    }
+    printf("[PASS] compile-time expr %s\n", S.chars);
+}
+
+// a literal on its own is a constant, bit for bit what the runtime parser makes of it
+template <rp::fixed_string S>
+static void check_literal() {
+    double got = rp::expr<S>::template eval<double>(nullptr);
+    double expected = parser(S.chars);
+    if (!same_bits(got, expected)) fail("literal", S.chars, got, expected);
+}
+
+int main(void) {
+    rp_symtab *symbols = rp_symtab_create();
+    rp_symtab_add(symbols, "k1");
+    rp_symtab_add(symbols, "A");
+    rp_symtab_add(symbols, "B");
+    rp_symtab_add(symbols, "_C2");
+
+    for (const char *expr : corpus) {
+        rp::program program(expr, symbols);
+        enum { ROWS = 8 };
+        double vars[ROWS][4], expected[ROWS];
+        for (int r = 0; r < ROWS; ++r) {
+            row(r, vars[r]);
+            expected[r] = rp_eval(program.get(), vars[r]);
+        }
+
+        // double, and float at its own precision
+        for (int r = 0; r < ROWS; ++r) {
+            double got = program.eval<double>(vars[r]);
+            if (!same_bits(got, expected[r])) fail("double", expr, got, expected[r]);
+            float narrow[4];
+            for (int k = 0; k < 4; ++k) narrow[k] = static_cast<float>(vars[r][k]);
+            double reference = program.eval<double>(std::vector<double>(narrow, narrow + 4).data());
+            float single = program.eval<float>(narrow);
+            if (!close(single, reference, 1e-4)) fail("float", expr, single, reference);
+        }
+
+        // four rows in one vector
+        for (int base = 0; base < ROWS; base += 4) {
+            rp::vec4d lanes[4];
+            for (int k = 0; k < 4; ++k) {
+                for (int i = 0; i < 4; ++i) lanes[k][i] = vars[base + i][k];
+            }
+            rp::vec4d got = program.eval<rp::vec4d>(lanes);
+            for (int i = 0; i < 4; ++i) {
+                if (!close(got[i], expected[base + i], 1e-13)) fail("vec4d", expr, got[i], expected[base + i]);
+            }
+        }
+
+        // derivatives with respect to every slot at once
+        const int slots[] = { 0, 1, 2, 3 };
+        for (int r = 0; r < ROWS; ++r) {
+            rp::dual<double, 4> seeded[4];
+            for (int k = 0; k < 4; ++k) seeded[k] = rp::dual<double, 4>::variable(vars[r][k], k);
+            rp::dual<double, 4> got = program.eval<rp::dual<double, 4>>(seeded);
+            double gradient[4];
+            rp_eval_gradient(program.get(), vars[r], slots, 4, gradient);
+            if (!close(got.v, expected[r], 1e-13)) fail("dual value", expr, got.v, expected[r]);
+            for (int k = 0; k < 4; ++k) {
+                if (!close(got.d[k], gradient[k], 1e-10)) fail("dual derivative", expr, got.d[k], gradient[k]);
+            }
+        }
+        printf("[PASS] templated eval %s\n", expr);
+    }
+
+    // eight float lanes; -Ofast divides packed floats by a refined reciprocal
+    rp::program rate("k1*A/(B+A) + exp(-_C2)", symbols);
+    rp::vec8f lanes[4];
+    float rows[8][4];
+    for (int i = 0; i < 8; ++i) {
+        double vars[4];
+        row(i, vars);
+        for (int k = 0; k < 4; ++k) lanes[k][i] = rows[i][k] = static_cast<float>(vars[k]);
+    }
+    rp::vec8f wide = rate.eval<rp::vec8f>(lanes);
+    for (int i = 0; i < 8; ++i) {
+        float expected = rate.eval<float>(rows[i]);
+        if (!close(wide[i], expected, 1e-6)) fail("vec8f", "k1*A/(B+A) + exp(-_C2)", wide[i], expected);
+    }
+    printf("[PASS] templated eval over 8 float lanes\n");
+
+    // several outputs sharing subexpressions
+    rp::program model({ "k1*A*B/(1 + A*B)", "exp(-A*B) + k1", "A*B" }, symbols);
+    double vars[4], expected[3], got[3];
+    row(3, vars);
+    rp_eval_many(model.get(), vars, expected);
+    model.eval_many<double>(vars, got);
+    for (int k = 0; k < 3; ++k) {
+        if (!close(got[k], expected[k], 1e-13)) fail("eval_many", "model", got[k], expected[k]);
+    }
+    if (!std::isnan(model.eval<double>(vars)) || !std::isnan(model.eval<rp::dual<double, 4>>(nullptr).v)) {
+        printf("[FAIL] templated eval of a program with several outputs did not return NAN\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("[PASS] templated eval of %d outputs\n", model.outputs());
+
+    try {
+        rp::program broken("k1*(A+B", symbols);
+        printf("[FAIL] malformed expression compiled\n");
+        exit(EXIT_FAILURE);
+    } catch (const rp::error &e) {
+        if (e.detail().status != RP_ERR_UNMATCHED_OPEN || e.detail().position != 3) {
+            printf("[FAIL] error %s\n", e.what());
+            exit(EXIT_FAILURE);
+        }
+        printf("[PASS] parse errors thrown: %s\n", e.what());
+    }
+
+    // the compile-time front end, on the same corpus
+#define CHECK_EXPR(e) check_expr<e>(symbols);
+    CORPUS(CHECK_EXPR)
+#define CHECK_LITERAL(e) check_literal<e>();
+    LITERALS(CHECK_LITERAL)
+    printf("[PASS] compile-time literals round like the runtime parser\n");
+
+    static_assert(rp::expr<"k1*A*B - k2*C">::nvars == 5 && rp::expr<"k1*A*B - k2*C">::names[3] == "k2");
+    static_assert(rp::detail::parse<8>("k1*(A+B").status == RP_ERR_UNMATCHED_OPEN);
+    rp_symtab *names = rp_symtab_create();
+    for (const char *name : { "k1", "A", "B", "_C2", "exp" }) rp_symtab_add(names, name);
+    for (const char *expr : malformed) {
+        rp_error expected;
+        parser_check(expr, names, &expected);
+        auto tree = rp::detail::parse<64>(expr);
+        if (expected.status == RP_OK || tree.status != expected.status || tree.position != expected.position) {
+            printf("[FAIL] malformed \"%s\" → status %d at %d, expected %d at %d\n", expr, tree.status,
+                   tree.position, expected.status, expected.position);
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("[PASS] compile-time parse errors match parser_check()\n");
+
+    // random literals through both scanners, up to 25 digits around every binade
+    std::mt19937_64 random(2025);
+    char literal[64];
+    for (int k = 0; k < 20000; ++k) {
+        int ndigits = 1 + random() % 25, point = random() % (ndigits + 1);
+        int n = 0;
+        for (int d = 0; d < ndigits; ++d) {
+            if (d == point) literal[n++] = '.';
+            literal[n++] = static_cast<char>('0' + random() % 10);
+        }
+        snprintf(literal + n, sizeof literal - n, "e%d", static_cast<int>(random() % 680) - 345);
+        double expected = parser(literal);
+        auto tree = rp::detail::parse<64>(literal);
+        if (tree.status != RP_OK || std::memcmp(&tree.nodes[tree.root].value, &expected, sizeof expected)) {
+            fail("literal", literal, tree.nodes[tree.root].value, expected);
+        }
+    }
+    printf("[PASS] 20000 random literals round like the runtime parser\n");
+
+    rp_symtab_free(names);
+    rp_symtab_free(symbols);
+    return 0;
+}